@@ -0,0 +1,241 @@
+/*  Copyright 2021 Philippe Even and Phuc Ngo,
+      authors of paper:
+      Even, P., and Ngo, P., 2021,
+      Automatic forest road extraction fromLiDAR data of mountainous areas.
+      In the First International Joint Conference of Discrete Geometry
+      and Mathematical Morphology (Springer LNCS 12708), pp. 93-106.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <cmath>
+#include "gtbatchtest.h"
+#include "gtperftest.h"
+#include "asparallel.h"
+#include "terrainmap.h"
+#include "ipttile.h"
+
+#define NVM_DIR "../Data/nvm/"
+#define TIL_DIR "../Data/til/"
+#define TILE_SET_DIR "../Data/tilesets/"
+#define JSON_SUFFIX ".json"
+
+
+GTBatchTest::GTBatchTest ()
+{
+  nb_threads = 0;
+}
+
+
+bool GTBatchTest::loadJobs (const std::string &name)
+{
+  std::ifstream input (name.c_str (), std::ios::in);
+  if (! input)
+  {
+    std::cout << "Cannot open " << name << std::endl;
+    return false;
+  }
+  std::string line;
+  int num = 0;
+  while (std::getline (input, line))
+  {
+    num ++;
+    std::istringstream tokens (line);
+    std::vector<std::string> fields;
+    std::string field;
+    while (tokens >> field) fields.push_back (field);
+    if (fields.empty () || fields[0].at (0) == '#') continue;
+    if (fields.size () < 3 || fields.size () > 4)
+    {
+      std::cout << name << " line " << num << " ignored" << std::endl;
+      continue;
+    }
+    Job job;
+    job.sector = fields[0];
+    job.detection = fields[1];
+    job.roadset = fields[2];
+    job.area = (fields.size () == 4 && fields[3] != "-" ? fields[3] : "");
+    job.status = "not run";
+    job.recall = NAN;
+    job.precision = NAN;
+    job.fmeasure = NAN;
+    job.time = 0.;
+    jobs.push_back (job);
+  }
+  input.close ();
+  return true;
+}
+
+
+void GTBatchTest::setThreads (int n)
+{
+  nb_threads = (n < 0 ? 0 : n);
+}
+
+
+void GTBatchTest::run ()
+{
+  std::chrono::steady_clock::time_point start
+    = std::chrono::steady_clock::now ();
+
+  // Tile files are listed once for each sector
+  std::vector<Job>::iterator it = jobs.begin ();
+  while (it != jobs.end ())
+  {
+    if (sectors.find (it->sector) == sectors.end ())
+    {
+      TileFiles files;
+      if (! readTileSet (it->sector, files))
+        std::cout << "No tile set for sector " << it->sector << std::endl;
+      sectors[it->sector] = files;
+    }
+    it ++;
+  }
+
+  ASParallel::forTasks ((int) jobs.size (), nb_threads,
+                        [this] (int k) { evaluate (jobs[k]); });
+
+  int nbok = 0;
+  for (it = jobs.begin (); it != jobs.end (); it++)
+    if (it->status == "ok") nbok ++;
+  std::cout << nbok << " / " << jobs.size () << " jobs evaluated in "
+            << std::chrono::duration<double> (
+                 std::chrono::steady_clock::now () - start).count ()
+            << " s" << std::endl;
+}
+
+
+bool GTBatchTest::save (const std::string &name) const
+{
+  std::ofstream output (name.c_str (), std::ios::out);
+  if (! output)
+  {
+    std::cout << "Cannot write " << name << std::endl;
+    return false;
+  }
+  std::string suffix (JSON_SUFFIX);
+  bool json = (name.size () >= suffix.size ()
+               && name.compare (name.size () - suffix.size (),
+                                suffix.size (), suffix) == 0);
+  if (json) output << "[" << std::endl;
+  else output << "sector,detection,roadset,area,status,"
+              << "recall,precision,fmeasure,time_ms" << std::endl;
+  std::vector<Job>::const_iterator it = jobs.begin ();
+  while (it != jobs.end ())
+  {
+    if (json)
+      output << "  {\"sector\": " << quote (it->sector, json)
+             << ", \"detection\": " << quote (it->detection, json)
+             << ", \"roadset\": " << quote (it->roadset, json)
+             << ", \"area\": " << quote (it->area, json)
+             << ", \"status\": " << quote (it->status, json)
+             << ", \"recall\": " << measure (it->recall, true)
+             << ", \"precision\": " << measure (it->precision, true)
+             << ", \"fmeasure\": " << measure (it->fmeasure, true)
+             << ", \"time_ms\": " << (int64_t) (it->time + 0.5) << "}"
+             << (it + 1 != jobs.end () ? "," : "") << std::endl;
+    else
+      output << quote (it->sector, json) << ","
+             << quote (it->detection, json) << ","
+             << quote (it->roadset, json) << ","
+             << quote (it->area, json) << ","
+             << quote (it->status, json) << ","
+             << measure (it->recall, false) << ","
+             << measure (it->precision, false) << ","
+             << measure (it->fmeasure, false) << ","
+             << (int64_t) (it->time + 0.5) << std::endl;
+    it ++;
+  }
+  if (json) output << "]" << std::endl;
+  output.close ();
+  return (bool) output;
+}
+
+
+bool GTBatchTest::readTileSet (const std::string &sector, TileFiles &files)
+{
+  std::string tsname (TILE_SET_DIR);
+  tsname += sector + ".txt";
+  std::ifstream input (tsname.c_str (), std::ios::in);
+  if (! input) return false;
+  std::string tile;
+  while (input >> tile)
+  {
+    files.nvm.push_back (std::string (NVM_DIR) + tile
+                         + TerrainMap::NVM_SUFFIX);
+    files.til.push_back (std::string (TIL_DIR) + IPtTile::ECO_DIR
+                         + IPtTile::ECO_PREFIX + tile + IPtTile::TIL_SUFFIX);
+  }
+  input.close ();
+  return (! files.nvm.empty ());
+}
+
+
+void GTBatchTest::evaluate (Job &job) const
+{
+  std::chrono::steady_clock::time_point start
+    = std::chrono::steady_clock::now ();
+  const TileFiles &files = sectors.find (job.sector)->second;
+  GTPerfTest ptest;
+  ptest.setVerbose (false);
+  ptest.loadSectorName (job.sector);
+  if (files.nvm.empty () || ! ptest.setTiles (files.nvm, files.til))
+    job.status = "no tiles";
+  else if (! ptest.loadDetectionMap (job.detection))
+    job.status = "no detection map";
+  else if (! ptest.loadRoadSet (job.roadset))
+    job.status = "no road set";
+  else if (! job.area.empty () && ! ptest.loadDiscardedAreas (job.area))
+    job.status = "no area file";
+  else
+  {
+    ptest.getRecall ();
+    ptest.getPrecision ();
+    ptest.getFMeasure ();
+    job.recall = ptest.recallValue ();
+    job.precision = ptest.precisionValue ();
+    job.fmeasure = ptest.fMeasureValue ();
+    job.status = "ok";
+  }
+  job.time = std::chrono::duration<double, std::milli> (
+               std::chrono::steady_clock::now () - start).count ();
+}
+
+
+std::string GTBatchTest::quote (const std::string &str, bool json)
+{
+  std::string res ("\"");
+  for (std::string::const_iterator it = str.begin (); it != str.end (); it++)
+  {
+    if (*it == '"') res += (json ? "\\\"" : "\"\"");
+    else if (*it == '\\' && json) res += "\\\\";
+    else res += *it;
+  }
+  return (res + "\"");
+}
+
+
+std::string GTBatchTest::measure (float val, bool json)
+{
+  if (std::isnan (val) || std::isinf (val))
+    return (json ? std::string ("null") : std::string (""));
+  std::ostringstream out;
+  out.precision (6);
+  out << val;
+  return out.str ();
+}
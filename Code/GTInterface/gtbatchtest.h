@@ -0,0 +1,148 @@
+/*  Copyright 2021 Philippe Even and Phuc Ngo,
+      authors of paper:
+      Even, P., and Ngo, P., 2021,
+      Automatic forest road extraction fromLiDAR data of mountainous areas.
+      In the First International Joint Conference of Discrete Geometry
+      and Mathematical Morphology (Springer LNCS 12708), pp. 93-106.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef GT_BATCH_TEST_H
+#define GT_BATCH_TEST_H
+
+#include <string>
+#include <vector>
+#include <map>
+
+
+/** 
+ * @class GTBatchTest gtbatchtest.h
+ * \brief Batch of road detector performance tests.
+ * Each job compares a detection map with a ground truth road set on a
+ *   sector, possibly discarding some areas.
+ * Jobs are run concurrently on a bounded count of threads, each thread
+ *   holding a single test at once, and all measures are saved in a
+ *   single CSV or JSON file.
+ */
+class GTBatchTest
+{
+public:
+
+  /**
+   * \brief Creates an empty batch.
+   */
+  GTBatchTest ();
+
+  /**
+   * \brief Loads a job list.
+   * Each line gives a sector name, a detection map file, a road set file
+   *   and optionally an area file ('-' for none).
+   * Empty lines and lines starting with '#' are ignored.
+   * Returns false if the file can not be read.
+   * @param name Job list file name.
+   */
+  bool loadJobs (const std::string &name);
+
+  /**
+   * \brief Sets the maximal count of threads.
+   * @param n Count of threads (hardware thread count if 0).
+   */
+  void setThreads (int n);
+
+  /**
+   * \brief Runs all jobs.
+   */
+  void run ();
+
+  /**
+   * \brief Saves job measures.
+   * JSON format is used if the file name ends with .json, CSV otherwise.
+   * Returns false if the file can not be written.
+   * @param name Result file name.
+   */
+  bool save (const std::string &name) const;
+
+
+private:
+
+  /** Test job. */
+  struct Job
+  {
+    /** Sector name. */
+    std::string sector;
+    /** Detection map file name. */
+    std::string detection;
+    /** Road set file name. */
+    std::string roadset;
+    /** Discarded area file name (empty if none). */
+    std::string area;
+    /** Job status. */
+    std::string status;
+    /** Recall (in percent). */
+    float recall;
+    /** Precision (in percent). */
+    float precision;
+    /** F-measure (in percent). */
+    float fmeasure;
+    /** Processing time (in milliseconds). */
+    double time;
+  };
+
+  /** Tile files of a sector. */
+  struct TileFiles
+  {
+    /** Normal map file names. */
+    std::vector<std::string> nvm;
+    /** Point tile file names. */
+    std::vector<std::string> til;
+  };
+
+  /** Test jobs. */
+  std::vector<Job> jobs;
+  /** Tile files of each sector. */
+  std::map<std::string, TileFiles> sectors;
+  /** Maximal count of threads. */
+  int nb_threads;
+
+
+  /**
+   * \brief Reads the tile files of a sector.
+   * Returns false if the tile set file can not be read.
+   * @param sector Sector name.
+   * @param files Tile files to fill in.
+   */
+  static bool readTileSet (const std::string &sector, TileFiles &files);
+
+  /**
+   * \brief Runs a job.
+   * @param job Job to run.
+   */
+  void evaluate (Job &job) const;
+
+  /**
+   * \brief Returns a string quoted for CSV or JSON output.
+   * @param str Input string.
+   * @param json JSON output modality.
+   */
+  static std::string quote (const std::string &str, bool json);
+
+  /**
+   * \brief Returns a measure value for CSV or JSON output.
+   * @param val Measure value.
+   * @param json JSON output modality.
+   */
+  static std::string measure (float val, bool json);
+};
+#endif
@@ -23,18 +23,19 @@
 #include <iostream>
 #include <fstream>
 #include <cstdlib>
+#include <cmath>
+#include <algorithm>
 #include "gtcreator.h"
-#include "gtperftest.h"
+#include "asparallel.h"
 
 #define TXT_SUFF ".txt"
 #define IM_SUFF ".png"
 #define LASTAREA_NAME "../Data/areas/last.txt"
 #define LASTROAD_NAME "../Data/roads/last.txt"
-#define DETECT_PREF "../Data/detections/roads_"
+#define LABELS_DIR "../Data/labels/"
 #define ROADSET_PREF "../Data/roadsets/rgt_"
 #define ROADS_PREF "../Data/roads/track_"
 #define ROADS_SUFF ".txt"
-#define AREA_PREF "../Data/areas/area_"
 #define CAPT_PREF "../Data/outputs/capture_"
 
 const std::string GTCreator::VERSION = "1.1.7";
@@ -46,6 +47,12 @@ const int GTCreator::BACK_IMAGE = 2;
 const int GTCreator::DEFAULT_PEN_WIDTH = 1;
 const int GTCreator::LARGE_ROAD_WIDTH = 16;
 const int GTCreator::SELECT_TOL = 5;
+const int GTCreator::TILE_STEP = 1000;
+const int GTCreator::LOAD_THREADS = 4;
+const int GTCreator::HOVER_TOL = 10;
+const float GTCreator::PROFILE_HALF_LENGTH = 15.0f;
+const float GTCreator::PROFILE_THICKNESS = 1.0f;
+const int GTCreator::SNAP_RADIUS = 6;
 
 
 
@@ -60,7 +67,6 @@ GTCreator::GTCreator (QWidget *parent)
   udef = false;
   nodrag = true;
   tile_disp = true;
-  mask_disp = false;
 
   // Initializes the maps and the auxiliary views
   iratio = 1.0f;
@@ -71,6 +77,7 @@ GTCreator::GTCreator (QWidget *parent)
   statsOn = false;
   background = BACK_IMAGE;
   blevel = 0;
+  derived = -1;
   dispPub = false;
 
   // Sets display parameters
@@ -91,11 +98,24 @@ GTCreator::GTCreator (QWidget *parent)
   sector_name = std::string ("");
   area_mode = false;
   area = NULL;
+
+  load_cancel = false;
+  loading = false;
+  load_generation = 0;
+  load_total = 0;
+  load_count = 0;
+  points_mode = GTPointOverlay::MODE_OFF;
+  cursor = QPoint (-1, -1);
+  profile_view = NULL;
+  setMouseTracking (true);
 }
 
 
 GTCreator::~GTCreator ()
 {
+  stopLoading ();
+  if (renderer.joinable ()) renderer.join ();
+  if (fetcher.joinable ()) fetcher.join ();
 }
 
 
@@ -103,7 +123,7 @@ bool GTCreator::addBinaryFiles (const std::string &nmap,
                                         const std::string &pts)
 {
   dtm_map.addNormalMapFile (nmap);
-  return (ptset.addTile (pts));
+  return (ptset.addTile (pts, false));
 }
 
 
@@ -124,10 +144,13 @@ bool GTCreator::addFiles (const std::string &dtm,
 QSize GTCreator::createMap (bool binary)
 {
   if (! ptset.create ()) return QSize (0, 0);
+  stopLoading ();
+  if (renderer.joinable ()) renderer.join ();
+  if (fetcher.joinable ()) fetcher.join ();
   if (binary)
   {
-    if (! dtm_map.assembleMap (ptset.columnsOfTiles (), ptset.rowsOfTiles (),
-                               ptset.xref (), ptset.yref ()))
+    if (! dtm_map.prepareMap (ptset.columnsOfTiles (), ptset.rowsOfTiles (),
+                              ptset.xref (), ptset.yref ()))
       return QSize (0, 0);
   }
   else if (! dtm_map.createMapFromDtm ()) return QSize (0, 0);
@@ -136,16 +159,26 @@ QSize GTCreator::createMap (bool binary)
   cellsize = dtm_map.cellSize ();
 
   iratio = width / ptset.xmSpread ();
+  if (! binary) ptset.loadLabels (LABELS_DIR);
+  points_overlay.setPoints (&ptset, iratio, height);
+  points_view = GTPointOverlay::View ();
+  derivatives.setMap (&dtm_map);
+  derived = -1;
 
   loadedImage = QImage (width, height, QImage::Format_RGB32);
-  for (int j = 0; j < height; j++)
-    for (int i = 0; i < width; i++)
-    {
-      int val = dtm_map.get (i, j);
-      loadedImage.setPixel (i, j, val + val * 256 + val * 256 * 256);
-    }
+  shade_cache.clear ();
+  if (binary) loadedImage.fill (Qt::black);
+  else
+  {
+    dtm_map.render ((uint32_t *) loadedImage.bits (),
+                    loadedImage.bytesPerLine () / 4, 0, 0, width, height);
+    shade_cache.insert (shadingKey (0), loadedImage);
+  }
+  backImage = loadedImage;
   augmentedImage = loadedImage;
+  if (! binary && blevel != 0) rebuildImage ();
 
+  pyramid.updateAll ();
   update ();
 
   xMaxShift = (width > maxWidth ? maxWidth - width : 0);
@@ -154,19 +187,135 @@ QSize GTCreator::createMap (bool binary)
   if (xShift > 0) xShift = 0;
   yShift = yMaxShift / 2;
   if (yShift > 0) yShift = 0;
+  if (binary) startLoading ();
   return QSize (width, height).boundedTo (QSize (maxWidth, maxHeight));
 }
 
 
-void GTCreator::setSectorName (std::string name)
+void GTCreator::startLoading ()
 {
-  sector_name = name;
+  // Tiles sorted by distance to the window center
+  int tw = dtm_map.tileWidth (), th = dtm_map.tileHeight ();
+  Pt2i center ((maxWidth / 2 - xShift) * dezoom / zoom,
+               (maxHeight / 2 - yShift) * dezoom / zoom);
+  std::vector<std::pair<int64_t, int> > order;
+  for (int k = 0; k < dtm_map.countOfTiles (); k++)
+  {
+    int imin = 0, jmin = 0;
+    if (dtm_map.tileRegion (k, imin, jmin))
+    {
+      int64_t dx = imin + tw / 2 - center.x ();
+      int64_t dy = jmin + th / 2 - center.y ();
+      order.push_back (std::pair<int64_t, int> (dx * dx + dy * dy, k));
+    }
+  }
+  std::sort (order.begin (), order.end ());
+
+  load_key = shadingKey (0);
+  load_total = (int) order.size ();
+  load_count = 0;
+  load_cancel = false;
+  loading = true;
+  int generation = ++ load_generation;
+  emit loadingProgress (0, load_total);
+  int shading = dtm_map.shadingType ();
+  float angle = dtm_map.lightAngle ();
+  int slp = dtm_map.slopinessFactor ();
+  loader = std::thread ([=] ()
+  {
+    ASParallel::forTasks ((int) order.size (), LOAD_THREADS, [&] (int n)
+    {
+      if (load_cancel) return;
+      int k = order[n].second;
+      int imin = 0, jmin = 0;
+      if (! dtm_map.loadTile (k) || ! dtm_map.tileRegion (k, imin, jmin))
+        return;
+      QImage im (tw, th, QImage::Format_RGB32);
+      dtm_map.render ((uint32_t *) im.bits (), im.bytesPerLine () / 4,
+                      imin, jmin, tw, th, shading, angle, slp);
+      load_mutex.lock ();
+      load_images.push_back (im);
+      load_places.push_back (Pt2i (imin, jmin));
+      load_mutex.unlock ();
+      QMetaObject::invokeMethod (this, "tilesLoaded", Qt::QueuedConnection,
+                                 Q_ARG (int, generation));
+    });
+    if (! load_cancel && ptset.loadPoints ()) ptset.loadLabels (LABELS_DIR);
+    QMetaObject::invokeMethod (this, "loadingDone", Qt::QueuedConnection,
+                               Q_ARG (int, generation));
+  });
+}
+
+
+void GTCreator::stopLoading ()
+{
+  load_cancel = true;
+  if (loader.joinable ()) loader.join ();
+  load_images.clear ();
+  load_places.clear ();
+  loading = false;
 }
 
 
-void GTCreator::setMaskDisplay (bool opt)
+void GTCreator::tilesLoaded (int generation)
 {
-  mask_disp = opt;
+  if (generation != load_generation) return;  // stale call from older load
+  std::vector<QImage> images;
+  std::vector<Pt2i> places;
+  load_mutex.lock ();
+  images.swap (load_images);
+  places.swap (load_places);
+  load_mutex.unlock ();
+  if (images.empty ()) return;
+
+  QRect dirty;
+  QPainter raw (&loadedImage);
+  QPainter back (&backImage);
+  for (int k = 0; k < (int) images.size (); k++)
+  {
+    QPoint pos (places[k].x (), places[k].y ());
+    raw.drawImage (pos, images[k]);
+    if (blevel != 0) lighten (images[k], blevel);
+    back.drawImage (pos, images[k]);
+    dirty |= QRect (pos, images[k].size ());
+  }
+  raw.end ();
+  back.end ();
+  load_count += (int) images.size ();
+  displayArea (dirty);
+  emit loadingProgress (load_count, load_total);
+}
+
+
+void GTCreator::loadingDone (int generation)
+{
+  if (generation != load_generation || ! loader.joinable ())
+    return;  // stale call from older load or loading already stopped
+  loader.join ();
+  tilesLoaded (generation);
+  loading = false;
+  if (load_cancel)
+    std::cout << "Loading cancelled : " << load_count << " tiles out of "
+              << load_total << " loaded" << std::endl;
+  else
+  {
+    shade_cache.insert (load_key, loadedImage);
+    if (shadingKey (blevel) != load_key) rebuildImage ();
+  }
+  emit loadingProgress (load_total, load_total);
+  displaySelectionResult ();
+}
+
+
+void GTCreator::setProfileView (GTProfileView *view)
+{
+  profile_view = view;
+}
+
+
+void GTCreator::setSectorName (std::string name)
+{
+  sector_name = name;
 }
 
 
@@ -189,19 +338,128 @@ bool GTCreator::loadRoadSet (const std::string &fname)
     ifile >> name;
   }
   ifile.close ();
+  road_index.clear ();
+  for (int k = 0; k < (int) old_roads.size (); k++)
+    road_index.setTrack (k, old_roads[k].points ());
   return true;
 }
 
 
 void GTCreator::rebuildImage ()
 {
-  for (int j = 0; j < height; j++)
-    for (int i = 0; i < width; i++)
+  if (loading) return;  // applied when loading ends
+  GTImageCache::Key key = shadingKey (blevel);
+  QImage raw, im;
+  if (shade_cache.find (shadingKey (0), raw) && shade_cache.find (key, im))
+  {
+    loadedImage = raw;
+    backImage = im;
+  }
+  else if (! renderer.joinable ()) startRendering (key);
+  // else the last settings are processed when the running rendering ends
+}
+
+
+GTPointOverlay::View GTCreator::pointsView () const
+{
+  GTPointOverlay::View view;
+  view.mode = points_mode;
+  view.width = size().width ();
+  view.height = size().height ();
+  view.xshift = xShift;
+  view.yshift = yShift;
+  view.zoom = zoom;
+  view.dezoom = dezoom;
+  if (cursor.x () >= 0 && cursor.y () >= 0)
+  {
+    // Quantized to avoid rebuilding the overlay for tiny moves
+    int q = GTPointOverlay::CURSOR_STEP;
+    view.cursor = QPoint ((cursor.x () / q) * q + q / 2,
+                          (cursor.y () / q) * q + q / 2);
+  }
+  return view;
+}
+
+
+void GTCreator::requestPoints ()
+{
+  if (points_mode == GTPointOverlay::MODE_OFF) return;
+  if (loading || fetcher.joinable ()) return;  // requested again when done
+  GTPointOverlay::View view = pointsView ();
+  if (view == points_view) return;
+  fetch_view = view;
+  fetcher = std::thread ([=] ()
+  {
+    fetch_result = points_overlay.build (view);
+    QMetaObject::invokeMethod (this, "pointsFetched", Qt::QueuedConnection);
+  });
+}
+
+
+void GTCreator::pointsFetched ()
+{
+  fetcher.join ();
+  points_view = fetch_view;
+  points_image = fetch_result;
+  fetch_result = QImage ();
+  update ();  // the view may have changed during the build
+}
+
+
+GTImageCache::Key GTCreator::shadingKey (int black) const
+{
+  return (GTImageCache::Key (dtm_map.shadingType (), dtm_map.lightAngle (),
+                             dtm_map.slopinessFactor (), black, derived));
+}
+
+
+void GTCreator::startRendering (const GTImageCache::Key &key)
+{
+  QImage raw;
+  shade_cache.find (shadingKey (0), raw);
+  int shading = dtm_map.shadingType ();
+  float angle = dtm_map.lightAngle ();
+  int slp = dtm_map.slopinessFactor ();
+  int dtype = derived;
+  int w = width, h = height;
+  render_key = key;
+  renderer = std::thread ([=] ()
+  {
+    QImage im = raw;
+    if (im.isNull ())
     {
-      int val = dtm_map.get (i, j);
-      loadedImage.setPixel (i, j, val + val * 256 + val * 256 * 256);
+      im = QImage (w, h, QImage::Format_RGB32);
+      if (dtype == -1)
+        dtm_map.render ((uint32_t *) im.bits (), im.bytesPerLine () / 4,
+                        0, 0, w, h, shading, angle, slp);
+      else if (! derivatives.render (dtype, (uint32_t *) im.bits (),
+                                     im.bytesPerLine () / 4))
+        im.fill (Qt::black);
     }
-  augmentedImage = loadedImage;
+    render_raw = im;
+    if (key.blevel != 0) lighten (im, key.blevel);
+    render_result = im;
+    QMetaObject::invokeMethod (this, "renderingDone", Qt::QueuedConnection);
+  });
+}
+
+
+void GTCreator::renderingDone ()
+{
+  renderer.join ();
+  GTImageCache::Key raw_key (render_key);
+  raw_key.blevel = 0;
+  shade_cache.insert (raw_key, render_raw);
+  shade_cache.insert (render_key, render_result);
+  if (render_key == shadingKey (blevel))
+  {
+    loadedImage = render_raw;
+    backImage = render_result;
+  }
+  else rebuildImage ();  // settings changed during the rendering
+  render_raw = QImage ();
+  render_result = QImage ();
+  displaySelectionResult ();
 }
 
 
@@ -241,24 +499,54 @@ bool GTCreator::saveAugmentedImage (const QString &fileName,
 void GTCreator::clearImage ()
 {
   augmentedImage.fill (qRgb (255, 255, 255));
+  pyramid.updateAll ();
   update ();
 }
 
 
-void GTCreator::paintEvent (QPaintEvent *)
+void GTCreator::paintEvent (QPaintEvent *event)
 {
   QPainter painter (this);
+  QRect vis = event->rect ();
   if (dezoom > 1)
   {
-    QImage zoomImage = augmentedImage.scaled (width / dezoom, height / dezoom);
-    painter.drawImage (QPoint (xShift, yShift), zoomImage);
+    // Visible part of the pyramid level
+    int k = 0;
+    while ((1 << k) < dezoom) k++;
+    const QImage &zoomImage = pyramid.level (augmentedImage, k);
+    QRect src = vis.translated (- xShift, - yShift) & zoomImage.rect ();
+    if (! src.isEmpty ())
+      painter.drawImage (src.translated (xShift, yShift), zoomImage, src);
   }
   else if (zoom > 1)
   {
-    QImage zoomImage = augmentedImage.scaled (width * zoom, height * zoom);
-    painter.drawImage (QPoint (xShift, yShift), zoomImage);
+    // Visible pixels enlarged
+    QRect vsrc = vis.translated (- xShift, - yShift);
+    QRect src = QRect (QPoint (vsrc.left () / zoom, vsrc.top () / zoom),
+                       QPoint (vsrc.right () / zoom, vsrc.bottom () / zoom))
+                & augmentedImage.rect ();
+    if (! src.isEmpty ())
+      painter.drawImage (QRect (xShift + src.x () * zoom,
+                                yShift + src.y () * zoom,
+                                src.width () * zoom, src.height () * zoom),
+                         augmentedImage, src);
+  }
+  else
+  {
+    QRect src = vis.translated (- xShift, - yShift) & augmentedImage.rect ();
+    if (! src.isEmpty ())
+      painter.drawImage (src.translated (xShift, yShift),
+                         augmentedImage, src);
+  }
+
+  if (points_mode != GTPointOverlay::MODE_OFF)
+  {
+    // Last built point overlay, shifted to the present view
+    requestPoints ();
+    if (pointsView().sameScale (points_view))
+      painter.drawImage (QPoint (xShift - points_view.xshift,
+                                 yShift - points_view.yshift), points_image);
   }
-  else painter.drawImage (QPoint (xShift, yShift), augmentedImage);
 }
 
 
@@ -290,7 +578,11 @@ void GTCreator::mousePressEvent (QMouseEvent *event)
       if (yc >= height) yc = height - 1;
       area->addCorner (xc, yc);
     }
-    else if (! trac->selectPoint (ex, ey)) trac->addPoint (ex, ey);
+    else
+    {
+      if (! trac->selectPoint (ex, ey)) trac->addPoint (ex, ey);
+      trackEdited ();
+    }
     displaySelectionResult ();
   }
 }
@@ -302,19 +594,32 @@ void GTCreator::mouseReleaseEvent (QMouseEvent *event)
   {
     int ex = (dezoom * (event->pos().x () - xShift)) / zoom;
     int ey = height - 1 - (dezoom * (event->pos().y () - yShift)) / zoom;
+    QRect before = activeArea ();
     trac->movePoint (ex, ey);
-    displaySelectionResult ();
+    trackEdited ();
+    displayArea (before | activeArea ());
   }
 }
 
 
 void GTCreator::mouseMoveEvent (QMouseEvent *event)
 {
+  if (event->buttons () == Qt::NoButton)
+  {
+    // Cursor tracked for the point overlay and the profiles
+    cursor = event->pos ();
+    requestPoints ();
+    updateProfile ((dezoom * (cursor.x () - xShift)) / zoom,
+                   height - 1 - (dezoom * (cursor.y () - yShift)) / zoom);
+    return;
+  }
   int ex = (dezoom * (event->pos().x () - xShift)) / zoom;
   int ey = height - 1 - (dezoom * (event->pos().y () - yShift)) / zoom;
   udef = false;
+  QRect before = activeArea ();
   trac->movePoint (ex, ey);
-  displaySelectionResult ();
+  trackEdited ();
+  displayArea (before | activeArea ());
 }
 
 
@@ -336,6 +641,7 @@ void GTCreator::keyPressEvent (QKeyEvent *event)
         incBlackLevel ((event->modifiers () & Qt::ShiftModifier) ? -1 : 1);
         std::cout << "Background black level = " << getBlackLevel ()
                   << std::endl;
+        rebuildImage ();
         displaySelectionResult ();
       }
       break;
@@ -345,6 +651,16 @@ void GTCreator::keyPressEvent (QKeyEvent *event)
       displaySelectionResult ();
       break;
 
+    case Qt::Key_D :
+      // Cycles derived terrain rasters as background
+      do derived = (derived + 2) % (TerrainDerivatives::NB_TYPES + 1) - 1;
+      while (derived != -1 && ! derivatives.available (derived));
+      std::cout << "Background : " << (derived == -1 ? std::string ("DTM")
+                   : TerrainDerivatives::name (derived)) << std::endl;
+      rebuildImage ();
+      displaySelectionResult ();
+      break;
+
     case Qt::Key_F :
       switchArea ();
       std::cout << "Area mode " << (area_mode ? "on" : "off") << std::endl;
@@ -354,6 +670,7 @@ void GTCreator::keyPressEvent (QKeyEvent *event)
       if (! trac->load (std::string (LASTROAD_NAME),
                        ptset.xref (), ptset.yref (), 500))
         std::cout << "No " << LASTROAD_NAME << " file found" << std::endl;
+      trackEdited ();
       displaySelectionResult ();
       break;
 
@@ -411,9 +728,25 @@ void GTCreator::keyPressEvent (QKeyEvent *event)
       displaySelectionResult ();
       break;
 
+    case Qt::Key_O :
+      // Cycles point cloud overlay modes
+      points_mode = (points_mode + 1) % GTPointOverlay::NB_MODES;
+      std::cout << "Overlay : " << GTPointOverlay::name (points_mode)
+                << std::endl;
+      update ();
+      break;
+
     case Qt::Key_P :
-      // Captures main window
+      if (event->modifiers () & Qt::ControlModifier)
       {
+        // Shows or hides the profile panel
+        if (profile_view != NULL && profile_view->parentWidget () != NULL)
+          profile_view->parentWidget()->setVisible (
+                                          ! profile_view->isVisible ());
+      }
+      else
+      {
+        // Captures main window
         std::string capname (CAPT_PREF);
         capname += sector_name + std::string (IM_SUFF);
         std::cout << "Saves main window in " << capname << std::endl;
@@ -421,6 +754,11 @@ void GTCreator::keyPressEvent (QKeyEvent *event)
       }
       break;
 
+    case Qt::Key_R :
+      // Snaps road points to flat areas
+      snapTrack ();
+      break;
+
     case Qt::Key_S :
       trac->save (std::string (LASTROAD_NAME),
                   ptset.xref (), ptset.yref (), 500);
@@ -452,6 +790,7 @@ void GTCreator::keyPressEvent (QKeyEvent *event)
       if (event->modifiers () & Qt::ControlModifier)
       {
         trac->withdrawActivePoint ();
+        trackEdited ();
         displaySelectionResult ();
       }
       break;
@@ -460,6 +799,7 @@ void GTCreator::keyPressEvent (QKeyEvent *event)
       if (event->modifiers () & Qt::ControlModifier)
       {
         trac->addMiddle ();
+        trackEdited ();
         displaySelectionResult ();
       }
       break;
@@ -547,19 +887,135 @@ void GTCreator::keyPressEvent (QKeyEvent *event)
         yShift = maxHeight - (height * zoom) / dezoom;
       displaySelectionResult ();
       break;
+
+    case Qt::Key_Escape :
+      // Cancels background tile loading
+      if (loading)
+      {
+        std::cout << "Cancelling tile loading" << std::endl;
+        load_cancel = true;
+      }
+      break;
   }
 }
 
 
 ASTrack *GTCreator::select (int x, int y)
 {
-  std::vector<ASTrack>::iterator trit = old_roads.begin ();
-  while (trit != old_roads.end ())
+  int tol = (SELECT_TOL * dezoom) / zoom;
+  if (tol < 1) tol = 1;
+  int t = -1, seg = -1, vertex = -1;
+  if (! road_index.nearest (x, y, tol, t, seg, vertex)) return NULL;
+  old_roads[t].activate (vertex);
+  return (&(old_roads[t]));
+}
+
+
+void GTCreator::trackEdited ()
+{
+  if (! old_roads.empty ()
+      && trac >= &(old_roads.front ()) && trac <= &(old_roads.back ()))
+    road_index.setTrack ((int) (trac - &(old_roads.front ())),
+                         trac->points ());
+}
+
+
+void GTCreator::snapTrack ()
+{
+  std::vector<Pt2i> pts = trac->points ();
+  if (pts.empty () || loading) return;
+  int frad = trac->getWidth () / 2;
+  if (frad < 1) frad = 1;
+  std::vector<Pt2i> res;
+  dtm_map.closestFlatAreas (pts, SNAP_RADIUS, frad,
+                            dtm_map.slopinessFactor (), res);
+  trac->movePoints (res);
+  trackEdited ();
+  std::cout << pts.size () << " road points snapped" << std::endl;
+  displaySelectionResult ();
+}
+
+
+void GTCreator::updateProfile (int x, int y)
+{
+  if (profile_view == NULL || ! profile_view->isVisible () || loading)
+    return;
+
+  // Hovered segment
+  int tol = (HOVER_TOL * dezoom) / zoom;
+  if (tol < 1) tol = 1;
+  std::vector<Pt2i> pts = trac->points ();
+  int seg = -1;
+  double best = (double) tol * tol;
+  for (int k = 0; k < (int) pts.size () - 1; k++)
   {
-    if (trit->selectPoint (x, y)) return (&(*trit));
-    trit ++;
+    double d2 = ASTrackIndex::distance2 (x, y, pts[k], pts[k + 1]);
+    if (d2 <= best)
+    {
+      best = d2;
+      seg = k;
+    }
   }
-  return NULL;
+  if (seg == -1)
+  {
+    int t = -1, vertex = -1;
+    if (! road_index.nearest (x, y, tol, t, seg, vertex)) return;
+    pts = old_roads[t].points ();
+  }
+  if (seg + 1 >= (int) pts.size ()) return;  // one point road
+
+  // Segment frame (in meters), cursor projected on the segment
+  float ax = (pts[seg].x () + 0.5f) / iratio;
+  float ay = (pts[seg].y () + 0.5f) / iratio;
+  float ux = (pts[seg + 1].x () + 0.5f) / iratio - ax;
+  float uy = (pts[seg + 1].y () + 0.5f) / iratio - ay;
+  float len = (float) sqrt (ux * ux + uy * uy);
+  if (len <= 0.0f) return;
+  ux /= len;
+  uy /= len;
+  float pos = ((x + 0.5f) / iratio - ax) * ux + ((y + 0.5f) / iratio - ay) * uy;
+  if (pos < 0.0f) pos = 0.0f;
+  else if (pos > len) pos = len;
+  float cx = ax + pos * ux, cy = ay + pos * uy;
+
+  // Corridors of point cells, as parallel scans across and along the road
+  float csize = (ptset.tileXSpread () * 0.001f) / ptset.tileWidth ();
+  int thick = (int) (PROFILE_THICKNESS / (2 * csize)) + 1;
+  float hl = PROFILE_HALF_LENGTH;
+  Pt2i c1 ((int) ((cx + uy * hl) / csize), (int) ((cy - ux * hl) / csize));
+  Pt2i c2 ((int) ((cx - uy * hl) / csize), (int) ((cy + ux * hl) / csize));
+  Pt2i s1 ((int) (ax / csize), (int) (ay / csize));
+  Pt2i s2 ((int) ((ax + len * ux) / csize), (int) ((ay + len * uy) / csize));
+  std::vector<std::vector<Pt2i> > scans;
+  std::vector<Pt3f> cross_pts, along_pts;
+  for (int k = - thick; k <= thick; k++) scans.push_back (c1.drawOrtho (c2, k));
+  ptset.collectCorridor (cross_pts, scans);
+  scans.clear ();
+  if (! s1.equals (s2))
+    for (int k = - thick; k <= thick; k++)
+      scans.push_back (s1.drawOrtho (s2, k));
+  ptset.collectCorridor (along_pts, scans);
+
+  // Points within the corridors projected on the profiles
+  float half = PROFILE_THICKNESS / 2;
+  std::vector<Pt2f> cross, along;
+  for (std::vector<Pt3f>::iterator it = cross_pts.begin ();
+       it != cross_pts.end (); it++)
+  {
+    float dx = it->x () - cx, dy = it->y () - cy;
+    float l = dx * ux + dy * uy, t = dy * ux - dx * uy;
+    if (l >= - half && l <= half && t >= - hl && t <= hl)
+      cross.push_back (Pt2f (t, it->z ()));
+  }
+  for (std::vector<Pt3f>::iterator it = along_pts.begin ();
+       it != along_pts.end (); it++)
+  {
+    float dx = it->x () - ax, dy = it->y () - ay;
+    float l = dx * ux + dy * uy, t = dy * ux - dx * uy;
+    if (t >= - half && t <= half && l >= 0.0f && l <= len)
+      along.push_back (Pt2f (l, it->z ()));
+  }
+  profile_view->setProfiles (cross, hl, along, len, pos);
 }
 
 
@@ -642,18 +1098,38 @@ void GTCreator::drawArea (QPainter &painter)
       painter.drawRect (c1.x (), height - 1 - c2.y (),
                         c2.x () - c1.x (), c2.y () - c1.y ());
     }
+    const std::vector<std::vector<Pt2i> > *polys = area->getPolygons ();
+    std::vector<std::vector<Pt2i> >::const_iterator pit = polys->begin ();
+    while (pit != polys->end ())
+    {
+      std::vector<QPoint> pts;
+      for (it = pit->begin (); it != pit->end (); it++)
+        pts.push_back (QPoint (it->x (), height - 1 - it->y ()));
+      painter.drawPolygon (pts.data (), (int) pts.size ());
+      pit ++;
+    }
     if (area->started ())
       painter.drawPoint (area->startX (), area->startY ());
   }
 }
 
 
-void GTCreator::drawTiles (QPainter &painter)
+void GTCreator::drawTiles (QPainter &painter, const QRect &area)
 {
-  for (int i = 1000; i < width - 50; i += 1000)
-    drawLine (painter, Pt2i (i, 0), Pt2i (i, height), Qt::green);
-  for (int i = 1000; i < height - 50; i += 1000)
-    drawLine (painter, Pt2i (0, i), Pt2i (width, i), Qt::green);
+  // Only the parts of the borders crossing the area are drawn
+  int m = overlayMargin ();
+  int xmin = (area.left () - m < 0 ? 0 : area.left () - m);
+  int xmax = (area.right () + m > width ? width : area.right () + m);
+  int ymin = height - 1 - area.bottom () - m;
+  if (ymin < 0) ymin = 0;
+  int ymax = height - 1 - area.top () + m;
+  if (ymax > height) ymax = height;
+  for (int i = TILE_STEP; i < width - 50; i += TILE_STEP)
+    if (i >= xmin && i <= xmax)
+      drawLine (painter, Pt2i (i, ymin), Pt2i (i, ymax), Qt::green);
+  for (int i = TILE_STEP; i < height - 50; i += TILE_STEP)
+    if (i >= ymin && i <= ymax)
+      drawLine (painter, Pt2i (xmin, i), Pt2i (xmax, i), Qt::green);
 }
 
 
@@ -677,17 +1153,28 @@ float GTCreator::getLightAngle () const
 }
 
 
-void GTCreator::lighten (QImage &im)
+void GTCreator::lighten (QImage &im, int level) const
 {
-  if (blevel != 0 && background != BACK_BLACK && background != BACK_WHITE)
+  if (level != 0)
   {
+    uint32_t lut[256];
+    for (int v = 0; v < 256; v++)
+    {
+      uint32_t col = level + (v * (255 - level)) / 255;
+      lut[v] = 0xff000000u | (col * 0x010101u);
+    }
     for (int i = 0; i < im.height (); i++)
-      for(int j = 0; j < im.width (); j++)
+    {
+      uint32_t *pix = (uint32_t *) im.scanLine (i);
+      for (int j = 0; j < im.width (); j++)
       {
-        int col = blevel + (QColor (im.pixel(j,i)).value ()
-                            * (255 - blevel)) / 255;
-        im.setPixel (j, i, col + col * 256 + col * 256 * 256);
+        // Grey level as returned by QColor::value ()
+        uint32_t r = (pix[j] >> 16) & 0xff, g = (pix[j] >> 8) & 0xff;
+        uint32_t b = pix[j] & 0xff;
+        uint32_t v = (r > g ? r : g);
+        pix[j] = lut[v > b ? v : b];
       }
+    }
   }
 }
 
@@ -712,6 +1199,7 @@ void GTCreator::displayBackground ()
   else if (background == BACK_WHITE) augmentedImage.fill (qRgb (255, 255, 255));
   else if (background == BACK_IMAGE) augmentedImage = loadedImage;
   QPainter painter (&augmentedImage);
+  pyramid.updateAll ();
   update (QRect (QPoint (0, 0), QPoint (width, height)));
 }
 
@@ -720,11 +1208,36 @@ void GTCreator::displaySelectionResult ()
 {
   if (background == BACK_BLACK) augmentedImage.fill (qRgb (0, 0, 0));
   else if (background == BACK_WHITE) augmentedImage.fill (qRgb (255, 255, 255));
-  else if (background == BACK_IMAGE) augmentedImage = loadedImage;
-  lighten (augmentedImage);
+  else if (background == BACK_IMAGE) augmentedImage = backImage;
+  QPainter painter (&augmentedImage);
+  drawOverlay (painter, augmentedImage.rect ());
+  pyramid.updateAll ();
+  update (QRect (QPoint (0, 0), QPoint (width, height)));
+}
+
+
+void GTCreator::displayArea (const QRect &area)
+{
+  QRect dirty = area & augmentedImage.rect ();
+  if (dirty.isEmpty ()) return;
   QPainter painter (&augmentedImage);
+  painter.setClipRect (dirty);
+  if (background == BACK_BLACK) painter.fillRect (dirty, Qt::black);
+  else if (background == BACK_WHITE) painter.fillRect (dirty, Qt::white);
+  else if (background == BACK_IMAGE)
+    painter.drawImage (dirty.topLeft (), backImage, dirty);
+  drawOverlay (painter, dirty);
+  painter.end ();
+  pyramid.update (dirty);
+  update (widgetArea (dirty));
+}
+
+
+void GTCreator::drawOverlay (QPainter &painter, const QRect &area)
+{
+  int margin = overlayMargin ();
   drawArea (painter);
-  if (tile_disp) drawTiles (painter);
+  if (tile_disp) drawTiles (painter, area);
   
   // draws saved roads
   painter.setPen (QPen (dispPub ? Qt::black : Qt::blue,
@@ -739,8 +1252,10 @@ void GTCreator::displaySelectionResult ()
       Pt2i pt (*it++);
       while (it != pts.end ())
       {
-        painter.drawLine (pt.x (), height - 1 - pt.y (),
-                          it->x (), height - 1 - it->y ());
+        if (crosses (area, pt.x (), height - 1 - pt.y (),
+                     it->x (), height - 1 - it->y (), margin))
+          painter.drawLine (pt.x (), height - 1 - pt.y (),
+                            it->x (), height - 1 - it->y ());
         pt.set (*it++);
       }
     }
@@ -757,7 +1272,9 @@ void GTCreator::displaySelectionResult ()
       std::vector<Pt2i>::iterator it = pts.begin ();
       while (it != pts.end ())
       {
-        painter.drawPoint (it->x (), height - 1 - it->y ());
+        if (crosses (area, it->x (), height - 1 - it->y (),
+                     it->x (), height - 1 - it->y (), margin))
+          painter.drawPoint (it->x (), height - 1 - it->y ());
         it++;
       }
       trit ++;
@@ -817,23 +1334,60 @@ void GTCreator::displaySelectionResult ()
       painter.drawPoint (QPoint (pt.x (), height - 1 - pt.y ()));
     }
   }
-  update (QRect (QPoint (0, 0), QPoint (width, height)));
 }
 
 
-void GTCreator::compare ()
+int GTCreator::overlayMargin () const
+{
+  return (2 * LARGE_ROAD_WIDTH + dezoom);
+}
+
+
+bool GTCreator::crosses (const QRect &area, int x1, int y1, int x2, int y2,
+                         int margin)
+{
+  return ((x1 < x2 ? x1 : x2) <= area.right () + margin
+          && (x1 < x2 ? x2 : x1) >= area.left () - margin
+          && (y1 < y2 ? y1 : y2) <= area.bottom () + margin
+          && (y1 < y2 ? y2 : y1) >= area.top () - margin);
+}
+
+
+QRect GTCreator::activeArea ()
+{
+  int k = trac->activeIndex ();
+  std::vector<Pt2i> pts = (trac->isCutMode () ? trac->cutPoints ()
+                                              : trac->points ());
+  if (k < 0 || k >= (int) pts.size ()) return QRect ();
+
+  // Active point with its neighbours on the polyline (cut points are single)
+  int kmin = k, kmax = k;
+  if (! trac->isCutMode ())
+  {
+    if (kmin > 0) kmin --;
+    if (kmax < (int) pts.size () - 1) kmax ++;
+  }
+  int xmin = pts[k].x (), xmax = xmin, ymin = pts[k].y (), ymax = ymin;
+  for (int i = kmin; i <= kmax; i++)
+  {
+    if (pts[i].x () < xmin) xmin = pts[i].x ();
+    else if (pts[i].x () > xmax) xmax = pts[i].x ();
+    if (pts[i].y () < ymin) ymin = pts[i].y ();
+    else if (pts[i].y () > ymax) ymax = pts[i].y ();
+  }
+  int margin = overlayMargin ();
+  return (QRect (QPoint (xmin - margin, height - 1 - ymax - margin),
+                 QPoint (xmax + margin, height - 1 - ymin + margin)));
+}
+
+
+QRect GTCreator::widgetArea (const QRect &area) const
 {
-  GTPerfTest ptest;
-  ptest.setSize (width, height, ptset.xref (), ptset.yref (), 500);
-  ptest.loadSectorName (sector_name);
-  ptest.loadDetectionMap (std::string (DETECT_PREF)
-                          + sector_name + std::string (IM_SUFF));
-  ptest.loadRoadSet (std::string (ROADSET_PREF)
-                     + sector_name + std::string (TXT_SUFF));
-  ptest.loadDiscardedAreas (std::string (AREA_PREF)
-                            + sector_name + std::string (TXT_SUFF));
-  if (mask_disp) ptest.getMask ();
-  ptest.getRecall ();
-  ptest.getPrecision ();
-  ptest.getFMeasure ();
+  if (dezoom > 1)
+    return (QRect (QPoint (xShift + area.left () / dezoom,
+                           yShift + area.top () / dezoom),
+                   QPoint (xShift + area.right () / dezoom + 1,
+                           yShift + area.bottom () / dezoom + 1)));
+  return (QRect (xShift + area.x () * zoom, yShift + area.y () * zoom,
+                 area.width () * zoom, area.height () * zoom));
 }
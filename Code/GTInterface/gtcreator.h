@@ -28,11 +28,20 @@
 #include <QWidget>
 #include <QVector>
 #include <fstream>
+#include <thread>
+#include <mutex>
+#include <atomic>
 #include "pt3f.h"
 #include "terrainmap.h"
+#include "terrainderivatives.h"
 #include "astrack.h"
+#include "astrackindex.h"
 #include "asarea.h"
 #include "ipttileset.h"
+#include "gtimagecache.h"
+#include "gtpyramid.h"
+#include "gtpointoverlay.h"
+#include "gtprofileview.h"
 
 
 /** 
@@ -79,6 +88,9 @@ public:
   /**
    * \brief Creates and distributes DTM images.
    * Returns the size of the DTM image.
+   * With binary files, only tile headers are read here: tile contents and
+   *   point clouds are then loaded in background and displayed as soon as
+   *   available.
    * @param binary Indicates whether binary files are loaded.
    */
   QSize createMap (bool binary);
@@ -90,15 +102,15 @@ public:
   void setSectorName (std::string name);
 
   /**
-   * Sets the mask output option.
-   * @param opt New option status.
+   * \brief Applies default options (read in defaults files).
    */
-  void setMaskDisplay (bool opt);
+  void setDefaults ();
 
   /**
-   * \brief Applies default options (read in defaults files).
+   * \brief Sets the view displaying profiles of the hovered road segment.
+   * @param view Profile view (NULL to stop profile display).
    */
-  void setDefaults ();
+  void setProfileView (GTProfileView *view);
 
   /**
    * \brief Builds and returns the image bitmap.
@@ -121,10 +133,14 @@ public:
    */
   bool saveAugmentedImage (const QString &fileName, const char *fileFormat);
 
+
+signals:
   /**
-   * Performs a comparison of the roads with detected roads from AMREL.
+   * \brief Notifies the progress of background tile loading.
+   * @param done Count of displayed tiles.
+   * @param total Count of tiles to load (done when reaching it).
    */
-  void compare ();
+  void loadingProgress (int done, int total);
 
 
 public slots:
@@ -134,6 +150,30 @@ public slots:
   void clearImage ();
 
 
+private slots:
+  /**
+   * \brief Collects a background image rendered in the rendering thread.
+   */
+  void renderingDone ();
+
+  /**
+   * \brief Displays the tiles delivered by the loading thread.
+   * @param generation Generation of the load that delivered the tiles.
+   */
+  void tilesLoaded (int generation);
+
+  /**
+   * \brief Terminates background loading.
+   * @param generation Generation of the terminated load.
+   */
+  void loadingDone (int generation);
+
+  /**
+   * \brief Collects a point overlay built in the fetching thread.
+   */
+  void pointsFetched ();
+
+
 protected:
   /**
    * \brief Updates the widget drawing.
@@ -180,8 +220,20 @@ private:
   static const int DEFAULT_PEN_WIDTH;
   /** Width of roads when displayed large. */
   static const int LARGE_ROAD_WIDTH;
-  /** Tolerence for segment picking (in count of naive lines) */
+  /** Tolerence for segment picking (in screen pixels). */
   static const int SELECT_TOL;
+  /** Tile grid spacing (in pixels). */
+  static const int TILE_STEP;
+  /** Maximal count of tiles loaded at once in background. */
+  static const int LOAD_THREADS;
+  /** Tolerence for segment hovering (in screen pixels). */
+  static const int HOVER_TOL;
+  /** Half length of the cross profile (in meters). */
+  static const float PROFILE_HALF_LENGTH;
+  /** Thickness of profile corridors (in meters). */
+  static const float PROFILE_THICKNESS;
+  /** Search radius for snapping road points to flat areas (in pixels). */
+  static const int SNAP_RADIUS;
 
 
   /** Initial scan start point. */
@@ -216,13 +268,63 @@ private:
   QColor selectionColor;
   /** Tile borders display modality. */
   bool tile_disp;
-  /** Mask output option. */
-  bool mask_disp;
 
   /** Presently loaded image. */
   QImage loadedImage;
+  /** Presently loaded image lightened with the black level. */
+  QImage backImage;
+  /** Already rendered background images. */
+  GTImageCache shade_cache;
+  /** Background image rendering thread. */
+  std::thread renderer;
+  /** Shading parameters of the image being rendered. */
+  GTImageCache::Key render_key;
+  /** Shaded image produced by the rendering thread. */
+  QImage render_raw;
+  /** Lightened image produced by the rendering thread. */
+  QImage render_result;
+  /** Background tile loading thread. */
+  std::thread loader;
+  /** Tile loading cancellation request. */
+  std::atomic<bool> load_cancel;
+  /** Indicates whether tiles are being loaded. */
+  bool loading;
+  /** Generation of the current load, to discard calls from older loads. */
+  int load_generation;
+  /** Count of tiles to load. */
+  int load_total;
+  /** Count of loaded tiles already displayed. */
+  int load_count;
+  /** Shading parameters of the loaded tiles. */
+  GTImageCache::Key load_key;
+  /** Protection of the delivered tiles. */
+  std::mutex load_mutex;
+  /** Shaded tiles delivered by the loading thread. */
+  std::vector<QImage> load_images;
+  /** Image positions of the delivered tiles. */
+  std::vector<Pt2i> load_places;
+  /** Point cloud overlay builder. */
+  GTPointOverlay points_overlay;
+  /** Point cloud overlay mode. */
+  int points_mode;
+  /** Point overlay fetching thread. */
+  std::thread fetcher;
+  /** Display parameters of the overlay being built. */
+  GTPointOverlay::View fetch_view;
+  /** Point overlay built by the fetching thread. */
+  QImage fetch_result;
+  /** Display parameters of the displayed point overlay. */
+  GTPointOverlay::View points_view;
+  /** Displayed point overlay. */
+  QImage points_image;
+  /** Last cursor position in the widget. */
+  QPoint cursor;
+  /** Profile view of the hovered road segment. */
+  GTProfileView *profile_view;
   /** Present image augmented with processed data. */
   QImage augmentedImage;
+  /** Reduced versions of the augmented image for dezoomed display. */
+  GTPyramid pyramid;
   /** Points cloud. */
   IPtTileSet ptset;
   /** Width of the present image. */
@@ -253,10 +355,16 @@ private:
 
   /** DTM normal map. */
   TerrainMap dtm_map;
+  /** Rasters derived from the DTM map. */
+  TerrainDerivatives derivatives;
+  /** Displayed derived raster type (-1 for the shaded DTM map). */
+  int derived;
   /** Delineated road. */
   ASTrack *trac;
   /** Saved roads. */
   std::vector<ASTrack> old_roads;
+  /** Grid index of saved road segments for picking. */
+  ASTrackIndex road_index;
   /** Old roads point display modality. */
   bool allPoints;
 
@@ -275,16 +383,75 @@ private:
 
   /**
    * \brief Rebuilds the background image after lighting modification.
+   * Previously rendered images are taken from the cache, others are
+   *   rendered in a separate thread while the old image remains displayed.
    */
   void rebuildImage ();
 
   /**
-   * \brief Selects the road that owns the selected point.
+   * \brief Starts loading the map tiles and the point clouds in background.
+   * Tiles nearest to the window center are loaded first, and delivered
+   *   to the widget as soon as they are shaded.
+   */
+  void startLoading ();
+
+  /**
+   * \brief Cancels background loading and waits for its end.
+   */
+  void stopLoading ();
+
+  /**
+   * \brief Returns the present display parameters of the point overlay.
+   */
+  GTPointOverlay::View pointsView () const;
+
+  /**
+   * \brief Starts building the point overlay of the present view in
+   *   a separate thread, unless already built or being built.
+   */
+  void requestPoints ();
+
+  /**
+   * \brief Returns the cache key of the present shading parameters.
+   * @param black Background black level.
+   */
+  GTImageCache::Key shadingKey (int black) const;
+
+  /**
+   * \brief Starts rendering a background image in a separate thread.
+   * @param key Shading parameters of the image.
+   */
+  void startRendering (const GTImageCache::Key &key);
+
+  /**
+   * \brief Selects the saved road nearest to the selected point.
+   * The nearest segment end is activated if close enough.
+   * Returns NULL if no road segment lies within the selection tolerance.
    * @param x Selected point X-coordinate.
    * @param y Selected point Y-coordinate.
    */
   ASTrack *select (int x, int y);
 
+  /**
+   * \brief Updates the picking index after an edition of the present road.
+   */
+  void trackEdited ();
+
+  /**
+   * \brief Moves all the points of the present road to the centers of
+   *   the closest flat areas, integrated over half the road width.
+   */
+  void snapTrack ();
+
+  /**
+   * \brief Updates the profiles of the road segment under the cursor.
+   * Segments of the present road are looked for first, then saved roads.
+   * Profiles are left unchanged if no segment is hovered.
+   * @param x Cursor X-coordinate (in image).
+   * @param y Cursor Y-coordinate (in image).
+   */
+  void updateProfile (int x, int y);
+
   /**
    * \brief Switches area selection modality on or off.
    */
@@ -331,10 +498,48 @@ private:
   void drawArea (QPainter &painter);
 
   /**
-   * \brief Draws tile borders.
+   * \brief Draws tile borders crossing an image area.
+   * @param painter Drawing device.
+   * @param area Image area to draw.
+   */
+  void drawTiles (QPainter &painter, const QRect &area);
+
+  /**
+   * \brief Draws the vector overlay (areas, tiles, roads) on an image area.
+   * Roads segments away from the area are skipped.
    * @param painter Drawing device.
+   * @param area Image area to draw.
+   */
+  void drawOverlay (QPainter &painter, const QRect &area);
+
+  /**
+   * \brief Returns the width of image borders drawn around overlay items.
+   */
+  int overlayMargin () const;
+
+  /**
+   * \brief Returns whether a segment may be drawn in an image area.
+   * @param area Image area.
+   * @param x1 Segment start X-coordinate (in image).
+   * @param y1 Segment start Y-coordinate (in image).
+   * @param x2 Segment end X-coordinate (in image).
+   * @param y2 Segment end Y-coordinate (in image).
+   * @param margin Drawing margin.
+   */
+  static bool crosses (const QRect &area, int x1, int y1, int x2, int y2,
+                       int margin);
+
+  /**
+   * \brief Returns the image area covered by the active point and its
+   *   adjacent segments, or an empty area if no point is active.
+   */
+  QRect activeArea ();
+
+  /**
+   * \brief Returns the widget area displaying an image area.
+   * @param area Image area.
    */
-  void drawTiles (QPainter &painter);
+  QRect widgetArea (const QRect &area) const;
 
   /**
    * \brief Returns the background black level.
@@ -359,10 +564,11 @@ private:
   void incLightAngle (int val);
 
   /**
-   * \brief Lighten the image according to the black level set.
+   * \brief Lighten the image according to the given black level.
    * @param im Image to lighten.
+   * @param level Black level.
    */
-  void lighten (QImage &im);
+  void lighten (QImage &im, int level) const;
 
   /**
    * \brief Writes the stats of the last detection in a file.
@@ -405,6 +611,13 @@ private:
    */
   void displaySelectionResult ();
 
+  /**
+   * \brief Displays the road selection on an image area only.
+   * The background layer is restored and the overlay redrawn in the area.
+   * @param area Image area to refresh.
+   */
+  void displayArea (const QRect &area);
+
   /**
    * \brief Displays the stored strokes and associated carriage roads.
    */
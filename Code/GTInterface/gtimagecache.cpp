@@ -0,0 +1,121 @@
+/*  Copyright 2021 Philippe Even and Phuc Ngo,
+      authors of paper:
+      Even, P., and Ngo, P., 2021,
+      Automatic forest road extraction fromLiDAR data of mountainous areas.
+      In the First International Joint Conference of Discrete Geometry
+      and Mathematical Morphology (Springer LNCS 12708), pp. 93-106.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <cmath>
+#include "gtimagecache.h"
+#include "terrainmap.h"
+
+
+const int64_t GTImageCache::DEFAULT_CAPACITY = (int64_t) 512 * 1024 * 1024;
+
+
+GTImageCache::Key::Key (int shading_type, float light_angle,
+                        int slp, int black, int derived_type)
+{
+  derived = derived_type;
+  shading = (derived == -1 ? shading_type : -1);
+  angle = (shading == TerrainMap::SHADE_HILL ?
+           (int) floor (light_angle * 10000.0f + 0.5f) : 0);
+  slopiness = (shading == TerrainMap::SHADE_EXP_SLOPE ? slp : 0);
+  blevel = black;
+}
+
+
+GTImageCache::GTImageCache ()
+{
+  cap = DEFAULT_CAPACITY;
+  used_bytes = 0;
+}
+
+
+GTImageCache::~GTImageCache ()
+{
+}
+
+
+void GTImageCache::clear ()
+{
+  entries.clear ();
+  used_bytes = 0;
+}
+
+
+void GTImageCache::setCapacity (int64_t bytes)
+{
+  cap = bytes;
+  shrink ();
+}
+
+
+bool GTImageCache::find (const Key &key, QImage &image)
+{
+  std::list<Entry>::iterator it = entries.begin ();
+  while (it != entries.end ())
+  {
+    if (it->key == key)
+    {
+      if (it != entries.begin ())
+        entries.splice (entries.begin (), entries, it);
+      image = entries.front().image;
+      return true;
+    }
+    it ++;
+  }
+  return false;
+}
+
+
+void GTImageCache::insert (const Key &key, const QImage &image)
+{
+  std::list<Entry>::iterator it = entries.begin ();
+  while (it != entries.end ())
+  {
+    if (it->key == key)
+    {
+      used_bytes -= bytes (it->image);
+      entries.erase (it);
+      break;
+    }
+    it ++;
+  }
+  Entry e;
+  e.key = key;
+  e.image = image;
+  entries.push_front (e);
+  used_bytes += bytes (image);
+  shrink ();
+}
+
+
+int64_t GTImageCache::bytes (const QImage &image)
+{
+  return ((int64_t) image.bytesPerLine () * image.height ());
+}
+
+
+void GTImageCache::shrink ()
+{
+  while (used_bytes > cap && entries.size () > 1)
+  {
+    used_bytes -= bytes (entries.back().image);
+    entries.pop_back ();
+  }
+}
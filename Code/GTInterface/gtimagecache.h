@@ -0,0 +1,177 @@
+/*  Copyright 2021 Philippe Even and Phuc Ngo,
+      authors of paper:
+      Even, P., and Ngo, P., 2021,
+      Automatic forest road extraction fromLiDAR data of mountainous areas.
+      In the First International Joint Conference of Discrete Geometry
+      and Mathematical Morphology (Springer LNCS 12708), pp. 93-106.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef GT_IMAGE_CACHE_H
+#define GT_IMAGE_CACHE_H
+
+#include <QImage>
+#include <list>
+#include <inttypes.h>
+
+
+/** 
+ * @class GTImageCache gtimagecache.h
+ * \brief Memory-bounded cache of shaded background images.
+ * Images are identified by their shading parameters and the least recently
+ *   used ones are discarded when the memory cap is exceeded.
+ */
+class GTImageCache
+{
+public:
+
+  /**
+   * @class Key gtimagecache.h
+   * \brief Shading parameters identifying a cached image.
+   */
+  class Key
+  {
+  public:
+
+    /** Shading type. */
+    int shading;
+    /** Lighting angle in tenths of milliradians (hill shading only). */
+    int angle;
+    /** Slope exponential factor (exponential slope shading only). */
+    int slopiness;
+    /** Background black level. */
+    int blevel;
+    /** Derived raster type (-1 for a shaded map). */
+    int derived;
+
+    /**
+     * \brief Creates a key from shading parameters.
+     * Parameters that have no effect on the given shading type are ignored.
+     * @param shading_type Shading type.
+     * @param light_angle Lighting angle in radians.
+     * @param slp Slope exponential factor.
+     * @param black Background black level.
+     * @param derived_type Derived raster type, -1 for a shaded map
+     *   (shading parameters are then ignored).
+     */
+    Key (int shading_type = 0, float light_angle = 0.0f,
+         int slp = 1, int black = 0, int derived_type = -1);
+
+    /**
+     * \brief Checks equality with another key.
+     * @param k Other key.
+     */
+    inline bool operator== (const Key &k) const {
+      return (shading == k.shading && angle == k.angle
+              && slopiness == k.slopiness && blevel == k.blevel
+              && derived == k.derived); }
+
+    /**
+     * \brief Checks difference with another key.
+     * @param k Other key.
+     */
+    inline bool operator!= (const Key &k) const { return (! (*this == k)); }
+  };
+
+  /** Default memory cap (in bytes). */
+  static const int64_t DEFAULT_CAPACITY;
+
+
+  /**
+   * \brief Creates an empty image cache.
+   */
+  GTImageCache ();
+
+  /**
+   * \brief Deletes the image cache.
+   */
+  ~GTImageCache ();
+
+  /**
+   * \brief Removes all cached images.
+   */
+  void clear ();
+
+  /**
+   * \brief Returns the memory cap (in bytes).
+   */
+  inline int64_t capacity () const { return cap; }
+
+  /**
+   * \brief Sets the memory cap and discards images in excess.
+   * @param bytes New memory cap (in bytes).
+   */
+  void setCapacity (int64_t bytes);
+
+  /**
+   * \brief Returns the memory used by cached images (in bytes).
+   */
+  inline int64_t used () const { return used_bytes; }
+
+  /**
+   * \brief Looks for the image matching the given key.
+   * Returns whether the image is cached.
+   * The found image becomes the most recently used one.
+   * @param key Searched key.
+   * @param image Returned image (shared copy).
+   */
+  bool find (const Key &key, QImage &image);
+
+  /**
+   * \brief Inserts an image in the cache.
+   * An already cached image with same key is replaced.
+   * @param key Image key.
+   * @param image Image to cache (shared copy).
+   */
+  void insert (const Key &key, const QImage &image);
+
+
+private:
+
+  /**
+   * @class Entry gtimagecache.h
+   * \brief Cached image with its key.
+   */
+  class Entry
+  {
+  public:
+    /** Image key. */
+    Key key;
+    /** Cached image. */
+    QImage image;
+  };
+
+  /** Cached images, most recently used first. */
+  std::list<Entry> entries;
+  /** Memory cap (in bytes). */
+  int64_t cap;
+  /** Used memory (in bytes). */
+  int64_t used_bytes;
+
+
+  /**
+   * \brief Returns the memory size of an image (in bytes).
+   * @param image Measured image.
+   */
+  static int64_t bytes (const QImage &image);
+
+  /**
+   * \brief Discards least recently used images until the cap is respected.
+   * The most recently used image is always kept.
+   */
+  void shrink ();
+};
+
+#endif
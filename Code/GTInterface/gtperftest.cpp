@@ -19,42 +19,76 @@
     along with this program.  If not, see <https://www.gnu.org/licenses/>.
 */
 
-#include <QtGui>
 #include <iostream>
 #include <fstream>
 #include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <iterator>
+#include <algorithm>
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
 #include "gtperftest.h"
+#include "distancetransform.h"
+#include "pngwriter.h"
+#include "ipttileset.h"
+#include "terrainmap.h"
 
 #define IMAGE_SUFFIX ".png"
+#define RAW_SUFFIX ".pgm"
+#define TXT_SUFFIX ".txt"
+#define DETECT_PREF "../Data/detections/roads_"
+#define ROADSET_PREF "../Data/roadsets/rgt_"
+#define AREA_PREF "../Data/areas/area_"
 #define MASK_PREF "../Data/outputs/mask_"
 #define RECALL_PREF "../Data/outputs/recall_"
 #define PREC_PREF "../Data/outputs/precision_"
+#define TOL_PREF "../Data/outputs/tolerance_"
+#define SWEEP_PREF "../Data/outputs/sweep_"
+#define PER_ROAD_PREF "../Data/outputs/perroad_"
+#define PER_TILE_PREF "../Data/outputs/pertile_"
+#define CSV_SUFFIX ".csv"
+#define CACHE_PREF "../Data/outputs/gtcache_"
+#define CACHE_SUFFIX ".rle"
+#define CACHE_TAG "GTC1"
 #define ROAD_PREF "../Data/roads/track_"
 #define ROAD_SUFF ".txt"
 
+const int GTPerfTest::DEFAULT_TILE_SIZE = 1000;
+const float GTPerfTest::MISSED_RECALL = 50.0f;
+const int GTPerfTest::DEFAULT_STRIP_HEIGHT = 256;
+
 
 GTPerfTest::GTPerfTest ()
 {
-  det_map = NULL;
   recall = 0.0f;
   precision = 0.0f;
   fmeasure = 0.0f;
+  width = 0;
+  height = 0;
   xref = (int64_t) 0;
   yref = (int64_t) 0;
   mapsize = 1;
+  tile_w = DEFAULT_TILE_SIZE;
+  tile_h = DEFAULT_TILE_SIZE;
   tr_width = 28;
   area = NULL;
+  diag = false;
+  verbose = true;
   sect_name = std::string ("");
 }
 
 
 GTPerfTest::~GTPerfTest ()
 {
+  waitOutputs ();
   std::vector<ASTrack *>::iterator it = gt_roads.begin ();
   while (it != gt_roads.end ()) delete *it++;
   gt_roads.clear ();
   if (area != NULL) delete area;
-  if (det_map != NULL) delete det_map;
 }
 
 
@@ -66,27 +100,177 @@ void GTPerfTest::setSize (int width, int height,
   this->xref = xref;
   this->yref = yref;
   this->mapsize = mapsize;
-  map_r = QImage (width, height, QImage::Format_RGB32);
-  map_p = QImage (width, height, QImage::Format_RGB32);
+  gt_w.resize (0, 0);
+  gt_l.resize (0, 0);
+  gt_labels.resize (0, 0);
+  det_map.resize (0, 0);
+  discard.resize (0, 0);
+}
+
+
+bool GTPerfTest::setTiles (const std::vector<std::string> &nvmfiles,
+                          const std::vector<std::string> &tilfiles)
+{
+  IPtTileSet ptset;
+  std::vector<std::string>::const_iterator it = tilfiles.begin ();
+  while (it != tilfiles.end ())
+  {
+    if (! ptset.addTile (*it, false))
+    {
+      if (verbose)
+        std::cout << "Header of " << *it << " can't be read" << std::endl;
+      return false;
+    }
+    it ++;
+  }
+  if (! ptset.create ()) return false;
+
+  int tw = 0, th = 0;
+  float cs = 0.0f;
+  it = nvmfiles.begin ();
+  while (it != nvmfiles.end ())
+  {
+    TerrainMap nmap;
+    if (! nmap.loadNormalMapInfo (*it)) return false;
+    if (it == nvmfiles.begin ())
+    {
+      tw = nmap.tileWidth ();
+      th = nmap.tileHeight ();
+      cs = nmap.cellSize ();
+    }
+    else if (nmap.tileWidth () != tw || nmap.tileHeight () != th)
+    {
+      if (verbose)
+        std::cout << "Header of " << *it << " inconsistent" << std::endl;
+      return false;
+    }
+    it ++;
+  }
+  if (tw <= 0 || th <= 0) return false;
+  setSize (ptset.columnsOfTiles () * tw, ptset.rowsOfTiles () * th,
+           ptset.xref (), ptset.yref (), (int) (cs * 1000 + 0.5f));
+  tile_w = tw;
+  tile_h = th;
+  return true;
+}
+
+
+void GTPerfTest::setDiagnostics (bool on)
+{
+  diag = on;
+}
+
+
+void GTPerfTest::setVerbose (bool on)
+{
+  verbose = on;
+}
+
+
+bool GTPerfTest::openDetectionMap (const std::string &name, ImageReader &im)
+{
+  det_name = name;
+  if (! im.open (name))
+  {
+    std::string rname (name);
+    size_t pos = rname.rfind (IMAGE_SUFFIX);
+    if (pos != std::string::npos)
+      rname.replace (pos, std::string (IMAGE_SUFFIX).length (), RAW_SUFFIX);
+    if (rname == name || ! im.open (rname))
+    {
+      if (verbose) std::cout << "Cannot open " << name << std::endl;
+      det_name = "";
+      return false;
+    }
+    det_name = rname;
+  }
+  return true;
 }
 
 
-void GTPerfTest::loadDetectionMap (std::string name)
+bool GTPerfTest::loadDetectionMap (std::string name)
 {
-  det_map = new QImage (QString (name.c_str ()));
+  det_map.resize (width, height);
+  initDiscard ();
+  ImageReader im;
+  if (! openDetectionMap (name, im)) return false;
+  int w = (im.width () < width ? im.width () : width);
+  int h = (im.height () < height ? im.height () : height);
+  std::vector<uint32_t> pix (im.width ());
+  for (int j = 0; j < h; j++)
+  {
+    if (! im.readRow (pix.data ()))
+    {
+      if (verbose)
+        std::cout << name << ": image data corrupted at row " << j
+                  << std::endl;
+      return false;
+    }
+    for (int i = 0; i < w; i++)
+      if (lightness (pix[i]) > 100) det_map.set (i, j);
+  }
+  return true;
 }
 
 
-void GTPerfTest::loadDiscardedAreas (std::string name)
+bool GTPerfTest::loadDiscardedAreas (std::string name)
 {
+  discard.resize (width, height);
+  if (! readAreas (name)) return false;
+  drawAreas (discard);
+  return true;
+}
+
+
+void GTPerfTest::initDiscard ()
+{
+  if (discard.width () != width || discard.height () != height)
+    discard.resize (width, height);
+}
+
+
+bool GTPerfTest::readAreas (const std::string &name)
+{
+  if (area != NULL) delete area;
   area = new ASArea ();
   if (! area->load (name, xref, yref, mapsize))
   {
-    std::cout << "No " << name << " file found" << std::endl;
+    if (verbose) std::cout << "No " << name << " file found" << std::endl;
     delete area;
     area = NULL;
+    return false;
   }
-  else std::cout << name << " loaded" << std::endl;
+  if (verbose) std::cout << name << " loaded" << std::endl;
+
+  // Builds discarded spans once for all passes
+  excluded.resize (width, height);
+  const std::vector<Pt2i> *corners = area->getCorners ();
+  std::vector<Pt2i>::const_iterator it = corners->begin ();
+  while (it != corners->end ())
+  {
+    Pt2i c1 (*it++);
+    Pt2i c2 (*it++);
+    excluded.addRect (c1.x (), height - 1 - c2.y (),
+                      c2.x (), height - 1 - c1.y ());
+  }
+  const std::vector<std::vector<Pt2i> > *polys = area->getPolygons ();
+  std::vector<std::vector<Pt2i> >::const_iterator pit = polys->begin ();
+  while (pit != polys->end ())
+  {
+    std::vector<Pt2i> pts;
+    for (it = pit->begin (); it != pit->end (); it++)
+      pts.push_back (Pt2i (it->x (), height - 1 - it->y ()));
+    excluded.addPolygon (pts);
+    pit ++;
+  }
+  return true;
+}
+
+
+void GTPerfTest::drawAreas (BitMask &mask, int top) const
+{
+  if (area == NULL) mask.clear ();
+  else excluded.fill (mask, top);
 }
 
 
@@ -99,69 +283,480 @@ void GTPerfTest::loadSectorName (std::string name)
 bool GTPerfTest::loadRoadSet (std::string name)
 {
   // Clears out structures
-  gt_w.clear ();
-  gt_l.clear ();
+  gt_w.resize (width, height);
+  gt_l.resize (width, height);
+  gt_labels.resize (width, height);
+  initDiscard ();
   std::vector<ASTrack *>::iterator it = gt_roads.begin ();
   while (it != gt_roads.end ()) delete *it++;
   gt_roads.clear ();
+  gt_names.clear ();
 
   // Loads road set
+  std::vector<std::string> rnames;
+  if (! readRoadNames (name, rnames)) return false;
+
+  // Reuses cached ground truth if neither roads nor geometry changed
+  uint64_t key = cacheKey (name, rnames);
+  char hex[17];
+  snprintf (hex, 17, "%016llx", (unsigned long long) key);
+  std::string cname (CACHE_PREF);
+  cname += std::string (hex) + std::string (CACHE_SUFFIX);
+  if (loadCache (cname, key))
+  {
+    if (verbose) std::cout << "Ground truth read from " << cname << std::endl;
+    return true;
+  }
+
+  // Loads delineated roads then draws linear then thick ground truth
+  loadTracks (rnames);
+  drawRoads (gt_l, 1, &gt_labels);
+  drawRoads (gt_w, tr_width);
+  saveCache (cname, key);
+  return true;
+}
+
+
+bool GTPerfTest::readRoadNames (const std::string &name,
+                                std::vector<std::string> &rnames) const
+{
   std::ifstream input (name, std::ios::in);
   if (! input)
   {
-    std::cout << "Cannot open " << name << std::endl;
+    if (verbose) std::cout << "Cannot open " << name << std::endl;
     return false;
   }
   char roadname[200];
   input >> roadname;
   while (! input.eof ())
+  {
+    rnames.push_back (std::string (roadname));
+    input >> roadname;
+  }
+  input.close ();
+  return true;
+}
+
+
+void GTPerfTest::loadTracks (const std::vector<std::string> &rnames)
+{
+  std::vector<std::string>::const_iterator it = rnames.begin ();
+  while (it != rnames.end ())
   {
     std::string tname (ROAD_PREF);
-    tname += std::string (roadname) + std::string (ROAD_SUFF);
+    tname += *it + std::string (ROAD_SUFF);
     ASTrack *tr = new ASTrack ();
     if (! tr->load (tname, xref, yref, mapsize))
     {
       delete tr;
-      std::cout << "Cannot load " << tname << std::endl;
+      if (verbose) std::cout << "Cannot load " << tname << std::endl;
     }
-    else gt_roads.push_back (tr);
-    input >> roadname;
+    else
+    {
+      gt_roads.push_back (tr);
+      gt_names.push_back (*it);
+    }
+    it ++;
   }
+}
 
-  // Draws linear ground truth
-  map_r.fill (Qt::white);
-  QPainter painter (&map_r);
-  painter.setPen (QPen (Qt::black, 1, Qt::SolidLine,
-                        Qt::RoundCap, Qt::RoundJoin));
-  std::vector<ASTrack *>::iterator itr = gt_roads.begin ();
-  while (itr != gt_roads.end ())
+
+void GTPerfTest::getMask ()
+{
+  std::string rname (MASK_PREF);
+  rname += sect_name + std::string (IMAGE_SUFFIX);
+  writers.push_back (std::thread (&GTPerfTest::writeMask, discard, rname));
+}
+
+
+void GTPerfTest::waitOutputs ()
+{
+  std::vector<std::thread>::iterator it = writers.begin ();
+  while (it != writers.end ()) (it++)->join ();
+  writers.clear ();
+}
+
+
+void GTPerfTest::getRecall ()
+{
+  int64_t nbok = gt_l.countAnd (det_map, &discard);
+  int64_t nbtot = gt_l.count (&discard);
+  recall = (nbok * 100) / (float) nbtot;
+  if (verbose) std::cout << "Recall : " << recall << std::endl;
+  if (diag)
   {
-    std::vector<Pt2i> pts = (*itr)->points ();
-    std::vector<Pt2i>::iterator it = pts.begin ();
-    if (it != pts.end ())
+    std::string rname (RECALL_PREF);
+    rname += sect_name + std::string (IMAGE_SUFFIX);
+    saveMeasureMap (gt_l, det_map, rname);
+  }
+}
+
+
+void GTPerfTest::getPrecision ()
+{
+  int64_t nbok = det_map.countAnd (gt_w, &discard);
+  int64_t nbtot = det_map.count (&discard);
+  precision = (nbok * 100) / (float) nbtot;
+  if (verbose) std::cout << "Precision : " << precision << std::endl;
+  if (diag)
+  {
+    std::string pname (PREC_PREF);
+    pname += sect_name + std::string (IMAGE_SUFFIX);
+    saveMeasureMap (det_map, gt_w, pname);
+  }
+}
+
+
+void GTPerfTest::getFMeasure ()
+{
+  fmeasure = (recall + precision == 0.0f ? 0.0f
+              : 2 * recall * precision / (recall + precision));
+  if (verbose) std::cout << "F-measure : " << fmeasure << std::endl;
+}
+
+
+void GTPerfTest::getToleranceCurves (std::vector<float> tol)
+{
+  std::sort (tol.begin (), tol.end ());
+  if (tol.empty () || tol.front () < 0.0f)
+  {
+    std::cout << "Invalid tolerances" << std::endl;
+    return;
+  }
+  uint32_t maxd2 = (uint32_t) (tol.back () * tol.back ());
+  std::vector<int64_t> rhist (maxd2 + 2, 0);
+  std::vector<int64_t> phist (maxd2 + 2, 0);
+  std::vector<uint32_t> d2;
+  DistanceTransform::squaredDistances (det_map, d2);
+  distanceHistogram (gt_l, d2, rhist);
+  DistanceTransform::squaredDistances (gt_l, d2);
+  distanceHistogram (det_map, d2, phist);
+  d2.clear ();
+
+  std::string tname (TOL_PREF);
+  tname += sect_name + std::string (CSV_SUFFIX);
+  std::ofstream output (tname.c_str (), std::ios::out);
+  if (output)
+    output << "tolerance_px,tolerance_m,recall,precision,fmeasure"
+           << std::endl;
+  int64_t rtot = 0, ptot = 0;
+  for (uint32_t k = 0; k <= maxd2 + 1; k++)
+  {
+    rtot += rhist[k];
+    ptot += phist[k];
+  }
+  int64_t rok = 0, pok = 0;
+  uint32_t k = 0;
+  if (verbose) std::cout << "Tolerance : recall precision F-measure"
+                         << std::endl;
+  std::vector<float>::iterator it = tol.begin ();
+  while (it != tol.end ())
+  {
+    uint32_t td2 = (uint32_t) (*it * *it);
+    for (; k <= td2; k++)
     {
-      Pt2i pt = *it++;
-      while (it != pts.end ())
+      rok += rhist[k];
+      pok += phist[k];
+    }
+    float rec = (rtot == 0 ? 0.0f : (rok * 100) / (float) rtot);
+    float prec = (ptot == 0 ? 0.0f : (pok * 100) / (float) ptot);
+    float fm = (rec + prec == 0.0f ? 0.0f : 2 * rec * prec / (rec + prec));
+    if (verbose) std::cout << *it << " : " << rec << " " << prec << " "
+                           << fm << std::endl;
+    if (output)
+      output << *it << "," << *it * mapsize / 1000.0f << ","
+             << rec << "," << prec << "," << fm << std::endl;
+    it ++;
+  }
+  if (output) output.close ();
+  else std::cout << "Cannot write " << tname << std::endl;
+}
+
+
+void GTPerfTest::getThresholdSweep ()
+{
+  ImageReader im;
+  if (det_name.empty () || ! im.open (det_name))
+  {
+    std::cout << "No detection map to sweep" << std::endl;
+    return;
+  }
+
+  // Single pass : all, well located and ground truth pixels per level
+  std::vector<int64_t> all (256, 0), match (256, 0), found (256, 0);
+  int w = (im.width () < width ? im.width () : width);
+  int h = (im.height () < height ? im.height () : height);
+  std::vector<uint32_t> pix (im.width ());
+  for (int j = 0; j < h; j++)
+  {
+    if (! im.readRow (pix.data ()))
+    {
+      std::cout << det_name << ": image data corrupted at row " << j
+                << std::endl;
+      return;
+    }
+    for (int i = 0; i < w; i++)
+    {
+      if (discard.get (i, j)) continue;
+      int l = lightness (pix[i]);
+      all[l] ++;
+      if (gt_w.get (i, j)) match[l] ++;
+      if (gt_l.get (i, j)) found[l] ++;
+    }
+  }
+  int64_t nbgt = gt_l.count (&discard);
+
+  // Pixels lighter than the threshold are detected
+  std::string sname (SWEEP_PREF);
+  sname += sect_name + std::string (CSV_SUFFIX);
+  std::ofstream output (sname.c_str (), std::ios::out);
+  if (output) output << "threshold,recall,precision,fmeasure" << std::endl;
+  std::vector<float> rec (256), prec (256), fm (256);
+  int64_t nbdet = 0, nbok = 0, nbfound = 0;
+  for (int t = 255; t >= 0; t--)
+  {
+    if (t != 255)
+    {
+      nbdet += all[t + 1];
+      nbok += match[t + 1];
+      nbfound += found[t + 1];
+    }
+    rec[t] = (nbfound * 100) / (float) nbgt;
+    prec[t] = (nbdet == 0 ? 100.0f : (nbok * 100) / (float) nbdet);
+    fm[t] = (rec[t] + prec[t] == 0.0f ? 0.0f
+             : 2 * rec[t] * prec[t] / (rec[t] + prec[t]));
+  }
+  int best = 0;
+  float ap = 0.0f;
+  for (int t = 254; t >= 0; t--)
+  {
+    ap += (rec[t] - rec[t + 1]) * prec[t] / 100.0f;
+    if (fm[t] > fm[best]) best = t;
+  }
+  if (output)
+  {
+    for (int t = 0; t < 255; t++)
+      output << t << "," << rec[t] << "," << prec[t] << "," << fm[t]
+             << std::endl;
+    output.close ();
+  }
+  else std::cout << "Cannot write " << sname << std::endl;
+  if (verbose)
+  {
+    std::cout << "Best F-measure : " << fm[best] << " (lightness > " << best
+              << ", recall " << rec[best] << ", precision " << prec[best]
+              << ")" << std::endl;
+    std::cout << "Average precision : " << ap << std::endl;
+  }
+}
+
+
+void GTPerfTest::getBreakdown ()
+{
+  int nbr = (int) gt_names.size ();
+  int tcols = (width + tile_w - 1) / tile_w;
+  int trows = (height + tile_h - 1) / tile_h;
+  std::vector<int64_t> rtot (nbr + 1, 0), rfound (nbr + 1, 0);
+  std::vector<int64_t> tgt (tcols * trows, 0), tfound (tcols * trows, 0);
+  std::vector<int64_t> tdet (tcols * trows, 0), tok (tcols * trows, 0);
+
+  // Single pass on ground truth line and detected pixels
+  int wpr = gt_l.wordsPerRow ();
+  for (int j = 0; j < height; j++)
+  {
+    const uint64_t *gl = gt_l.row (j);
+    const uint64_t *gw = gt_w.row (j);
+    const uint64_t *dm = det_map.row (j);
+    const uint64_t *ex = discard.row (j);
+    const uint16_t *lab = gt_labels.row (j);
+    int tbase = (j / tile_h) * tcols;
+    for (int k = 0; k < wpr; k++)
+    {
+      uint64_t gbits = gl[k] & ~ex[k];
+      uint64_t dbits = dm[k] & ~ex[k];
+      for (int b = 0; (gbits | dbits) != 0; b++, gbits >>= 1, dbits >>= 1)
       {
-        painter.drawLine (pt.x (), height - 1 - pt.y (),
-                          it->x (), height - 1 - it->y ());
-        pt.set (*it++);
+        if ((gbits | dbits) & 1)
+        {
+          int i = k * 64 + b;
+          int t = tbase + i / tile_w;
+          bool det = ((dbits & 1) != 0);
+          if (gbits & 1)
+          {
+            rtot[lab[i]] ++;
+            tgt[t] ++;
+            if (det)
+            {
+              rfound[lab[i]] ++;
+              tfound[t] ++;
+            }
+          }
+          if (det)
+          {
+            tdet[t] ++;
+            if ((gw[k] >> b) & 1) tok[t] ++;
+          }
+        }
       }
     }
-    itr ++;
   }
-  for (int j = 0; j < height; j ++)
-    for (int i = 0; i < width; i++)
-      if (QColor (map_r.pixel (i, height - 1 - j)).value () < 10)
-        gt_l.push_back (Pt2i (i, j));
 
-  // Draws thick ground truth
-  map_r.fill (Qt::white);
-  painter.setPen (QPen (Qt::black, tr_width, Qt::SolidLine,
-                        Qt::RoundCap, Qt::RoundJoin));
-  itr = gt_roads.begin ();
+  // Per road measures
+  std::string rname (PER_ROAD_PREF);
+  rname += sect_name + std::string (CSV_SUFFIX);
+  std::ofstream output (rname.c_str (), std::ios::out);
+  if (output) output << "road,pixels,found,recall,missed" << std::endl;
+  else std::cout << "Cannot write " << rname << std::endl;
+  int nbmissed = 0;
+  for (int r = 0; r < nbr; r++)
+  {
+    int64_t tot = rtot[r + 1], found = rfound[r + 1];
+    float rec = (tot == 0 ? 0.0f : (found * 100) / (float) tot);
+    bool missed = (tot != 0 && rec < MISSED_RECALL);
+    if (output)
+      output << gt_names[r] << "," << tot << "," << found << ","
+             << rec << "," << (missed ? 1 : 0) << std::endl;
+    if (missed)
+    {
+      if (verbose)
+      {
+        if (nbmissed == 0) std::cout << "Missed roads (recall below "
+                                     << MISSED_RECALL << "%) :" << std::endl;
+        std::cout << "  " << gt_names[r] << " : " << rec << std::endl;
+      }
+      nbmissed ++;
+    }
+  }
+  if (output) output.close ();
+  if (verbose && nbmissed == 0) std::cout << "No missed road" << std::endl;
+
+  // Per tile measures
+  std::string tname (PER_TILE_PREF);
+  tname += sect_name + std::string (CSV_SUFFIX);
+  output.open (tname.c_str (), std::ios::out);
+  if (! output)
+  {
+    std::cout << "Cannot write " << tname << std::endl;
+    return;
+  }
+  output << "xmin_m,ymin_m,column,row,gt_pixels,found,recall,"
+         << "detected,matched,precision" << std::endl;
+  for (int tj = 0; tj < trows; tj++)
+  {
+    int bottom = height - ((tj + 1) * tile_h < height ?
+                           (tj + 1) * tile_h : height);
+    for (int ti = 0; ti < tcols; ti++)
+    {
+      int t = tj * tcols + ti;
+      output << (xref + (int64_t) ti * tile_w * mapsize) / 1000 << ","
+             << (yref + (int64_t) bottom * mapsize) / 1000 << ","
+             << ti << "," << tj << "," << tgt[t] << "," << tfound[t] << ",";
+      if (tgt[t] != 0) output << (tfound[t] * 100) / (float) tgt[t];
+      output << "," << tdet[t] << "," << tok[t] << ",";
+      if (tdet[t] != 0) output << (tok[t] * 100) / (float) tdet[t];
+      output << std::endl;
+    }
+  }
+  output.close ();
+}
+
+
+bool GTPerfTest::runStrips (int strip)
+{
+  if (strip <= 0) strip = DEFAULT_STRIP_HEIGHT;
+  if (strip > height) strip = height;
+
+  // Loads vector inputs only
+  std::vector<ASTrack *>::iterator it = gt_roads.begin ();
+  while (it != gt_roads.end ()) delete *it++;
+  gt_roads.clear ();
+  gt_names.clear ();
+  std::vector<std::string> rnames;
+  if (! readRoadNames (std::string (ROADSET_PREF)
+                       + sect_name + std::string (TXT_SUFFIX), rnames))
+    return false;
+  loadTracks (rnames);
+  readAreas (std::string (AREA_PREF) + sect_name + std::string (TXT_SUFFIX));
+  ImageReader im;
+  if (! openDetectionMap (std::string (DETECT_PREF)
+                         + sect_name + std::string (IMAGE_SUFFIX), im))
+    return false;
+
+  // Rasterizes and counts strip by strip
+  BitMask st_l (width, strip), st_w (width, strip);
+  BitMask st_det (width, strip), st_disc (width, strip);
+  std::vector<uint32_t> pix (im.width ());
+  int w = (im.width () < width ? im.width () : width);
+  int64_t gtok = 0, gttot = 0, detok = 0, dettot = 0;
+  for (int top = 0; top < height; top += strip)
+  {
+    int sh = (height - top < strip ? height - top : strip);
+    if (sh != st_l.height ())
+    {
+      st_l.resize (width, sh);
+      st_w.resize (width, sh);
+      st_det.resize (width, sh);
+      st_disc.resize (width, sh);
+    }
+    st_det.clear ();
+    for (int j = 0; j < sh && top + j < im.height (); j++)
+    {
+      if (! im.readRow (pix.data ()))
+      {
+        if (verbose)
+          std::cout << det_name << ": image data corrupted at row "
+                    << top + j << std::endl;
+        return false;
+      }
+      for (int i = 0; i < w; i++)
+        if (lightness (pix[i]) > 100) st_det.set (i, j);
+    }
+    drawRoads (st_l, 1, NULL, top);
+    drawRoads (st_w, tr_width, NULL, top);
+    drawAreas (st_disc, top);
+    gtok += st_l.countAnd (st_det, &st_disc);
+    gttot += st_l.count (&st_disc);
+    detok += st_det.countAnd (st_w, &st_disc);
+    dettot += st_det.count (&st_disc);
+  }
+  im.close ();
+
+  recall = (gttot == 0 ? 0.0f : (gtok * 100) / (float) gttot);
+  if (verbose) std::cout << "Recall : " << recall << std::endl;
+  precision = (dettot == 0 ? 0.0f : (detok * 100) / (float) dettot);
+  if (verbose) std::cout << "Precision : " << precision << std::endl;
+  getFMeasure ();
+  return true;
+}
+
+
+void GTPerfTest::run (bool mask)
+{
+  loadDetectionMap (std::string (DETECT_PREF)
+                    + sect_name + std::string (IMAGE_SUFFIX));
+  loadRoadSet (std::string (ROADSET_PREF)
+               + sect_name + std::string (TXT_SUFFIX));
+  loadDiscardedAreas (std::string (AREA_PREF)
+                      + sect_name + std::string (TXT_SUFFIX));
+  if (mask) getMask ();
+  getRecall ();
+  getPrecision ();
+  getFMeasure ();
+}
+
+
+void GTPerfTest::drawRoads (BitMask &mask, int pen_width,
+                            LabelMap *labels, int top) const
+{
+  mask.clear ();
+  if (labels != NULL) labels->clear ();
+  int ymax = height - 1 - top + pen_width;
+  int ymin = height - top - mask.height () - pen_width;
+  uint16_t lab = 0;
+  std::vector<ASTrack *>::const_iterator itr = gt_roads.begin ();
   while (itr != gt_roads.end ())
   {
+    if (lab != 0xffff) lab ++;
     std::vector<Pt2i> pts = (*itr)->points ();
     std::vector<Pt2i>::iterator it = pts.begin ();
     if (it != pts.end ())
@@ -169,147 +764,226 @@ bool GTPerfTest::loadRoadSet (std::string name)
       Pt2i pt = *it++;
       while (it != pts.end ())
       {
-        painter.drawLine (pt.x (), height - 1 - pt.y (),
-                          it->x (), height - 1 - it->y ());
+        // Segments away from the mask rows are skipped
+        if ((pt.y () >= ymin || it->y () >= ymin)
+            && (pt.y () <= ymax || it->y () <= ymax))
+        {
+          int y1 = height - 1 - top - pt.y ();
+          int y2 = height - 1 - top - it->y ();
+          if (pen_width <= 1)
+          {
+            mask.drawLine (pt.x (), y1, it->x (), y2);
+            if (labels != NULL)
+              labels->drawLine (pt.x (), y1, it->x (), y2, lab);
+          }
+          else
+            mask.drawThickLine (pt.x (), y1, it->x (), y2,
+                                (float) pen_width);
+        }
         pt.set (*it++);
       }
     }
     itr ++;
   }
-  for (int j = 0; j < height; j ++)
-    for (int i = 0; i < width; i++)
-      if (QColor (map_r.pixel (i, height - 1 - j)).value () < 10)
-        gt_w.push_back (Pt2i (i, j));
-  return true;
 }
 
 
-void GTPerfTest::getMask ()
+void GTPerfTest::hashBytes (uint64_t &hash, const char *data, size_t n)
 {
-  QImage area_mask (width, height, QImage::Format_RGB32);
-  area_mask.fill (Qt::white);
-  if (area != NULL)
+  for (size_t i = 0; i < n; i++)
   {
-    QPainter painter (&area_mask);
-    const std::vector<Pt2i> *corners = area->getCorners ();
-    std::vector<Pt2i>::const_iterator it = corners->begin ();
-    while (it != corners->end ())
-    {
-      Pt2i c1 (*it++);
-      Pt2i c2 (*it++);
-      painter.fillRect (c1.x (), height - 1 - c2.y (),
-                        c2.x () - c1.x (), c2.y () - c1.y (), Qt::black);
-    }
+    hash ^= (unsigned char) data[i];
+    hash *= (uint64_t) 0x100000001b3ULL;
   }
-  std::string rname (MASK_PREF);
-  rname += sect_name + std::string (IMAGE_SUFFIX);
-  area_mask.save (rname.c_str ());
 }
 
 
-void GTPerfTest::getRecall ()
+bool GTPerfTest::hashFile (uint64_t &hash, const std::string &name)
 {
-  map_r.fill (0);
-  if (area != NULL)
+  std::ifstream input (name, std::ios::in | std::ios::binary);
+  if (! input) return false;
+  char buf[4096];
+  while (input)
   {
-    QPainter painter (&map_r);
-    const std::vector<Pt2i> *corners = area->getCorners ();
-    std::vector<Pt2i>::const_iterator it = corners->begin ();
-    while (it != corners->end ())
-    {
-      Pt2i c1 (*it++);
-      Pt2i c2 (*it++);
-      painter.fillRect (c1.x (), height - 1 - c2.y (),
-                        c2.x () - c1.x (), c2.y () - c1.y (), Qt::red);
-    }
+    input.read (buf, sizeof (buf));
+    hashBytes (hash, buf, (size_t) input.gcount ());
   }
+  return true;
+}
 
-  for (int j = 0; j < height; j++)
-    for (int i = 0; i < width; i++)
-      if (QColor(det_map->pixel(i,j)).lightness () > 100)
-      {
-        int red = QColor(map_r.pixel (i, j)).red ();
-        if (red < 200) map_r.setPixel (i, j, 127 + 127 * 256 + 127 * 256 * 256);
-      }
-  std::vector<Pt2i>::iterator pit = gt_l.begin ();
-  int nbok = 0, nbtot = 0;
-  while (pit != gt_l.end ())
+
+uint64_t GTPerfTest::cacheKey (const std::string &name,
+                               const std::vector<std::string> &rnames) const
+{
+  uint64_t hash = (uint64_t) 0xcbf29ce484222325ULL;
+  hashBytes (hash, CACHE_TAG, strlen (CACHE_TAG));
+  hashFile (hash, name);
+  std::vector<std::string>::const_iterator it = rnames.begin ();
+  while (it != rnames.end ())
   {
-    int red = QColor(map_r.pixel (pit->x (), height - 1 - pit->y ())).red ();
-    if (red > 100 && red < 150)
-    {
-      map_r.setPixel (pit->x (), height - 1 - pit->y (), 255 * 256);
-      nbok ++;
-      nbtot ++;
-    }
-    else if (red < 200)
-    {
-      map_r.setPixel (pit->x (), height - 1 - pit->y (), 255);
-      nbtot ++;
-    }
-    pit ++;
+    std::string tname (ROAD_PREF);
+    tname += *it++ + std::string (ROAD_SUFF);
+    hashBytes (hash, tname.c_str (), tname.size () + 1);
+    if (! hashFile (hash, tname)) hashBytes (hash, "-", 1);
   }
-  recall = (nbok * 100) / (float) nbtot;
-  std::cout << "Recall : " << recall << std::endl;
-  std::string rname (RECALL_PREF);
-  rname += sect_name + std::string (IMAGE_SUFFIX);
-  map_r.save (rname.c_str ());
+  int64_t geom[6] = {(int64_t) width, (int64_t) height, xref, yref,
+                     (int64_t) mapsize, (int64_t) tr_width};
+  hashBytes (hash, (const char *) geom, sizeof (geom));
+  return hash;
 }
 
 
-void GTPerfTest::getPrecision ()
+bool GTPerfTest::loadCache (const std::string &cname, uint64_t key)
 {
-  map_p.fill (0);
-  if (area != NULL)
+  std::ifstream input (cname, std::ios::in | std::ios::binary);
+  if (! input) return false;
+  std::vector<unsigned char> data ((std::istreambuf_iterator<char> (input)),
+                                   std::istreambuf_iterator<char> ());
+  input.close ();
+
+  // Checks the header
+  const unsigned char *in = data.data ();
+  const unsigned char *end = in + data.size ();
+  uint64_t ckey = 0;
+  int32_t head[3] = {0, 0, 0};
+  if (data.size () < 4 + sizeof (ckey) + sizeof (head)
+      || memcmp (in, CACHE_TAG, 4) != 0) return false;
+  in += 4;
+  memcpy (&ckey, in, sizeof (ckey));
+  in += sizeof (ckey);
+  memcpy (head, in, sizeof (head));
+  in += sizeof (head);
+  if (ckey != key || head[0] != width || head[1] != height || head[2] < 0)
+    return false;
+
+  // Reads road names then ground truth rasters
+  std::vector<std::string> names;
+  for (int i = 0; i < head[2]; i++)
   {
-    QPainter painter (&map_p);
-    const std::vector<Pt2i> *corners = area->getCorners ();
-    std::vector<Pt2i>::const_iterator it = corners->begin ();
-    while (it != corners->end ())
-    {
-      Pt2i c1 (*it++);
-      Pt2i c2 (*it++);
-      painter.fillRect (c1.x (), height - 1 - c2.y (),
-                        c2.x () - c1.x (), c2.y () - c1.y (), Qt::red);
-    }
+    int32_t len = 0;
+    if (end - in < (long) sizeof (len)) return false;
+    memcpy (&len, in, sizeof (len));
+    in += sizeof (len);
+    if (len < 0 || end - in < (long) len) return false;
+    names.push_back (std::string ((const char *) in, (size_t) len));
+    in += len;
+  }
+  if (! (gt_l.decodeRuns (in, end) && gt_w.decodeRuns (in, end)
+         && gt_labels.decodeRuns (in, end)))
+  {
+    gt_l.clear ();
+    gt_w.clear ();
+    gt_labels.clear ();
+    return false;
   }
+  gt_names = names;
+  return true;
+}
+
 
-  std::vector<Pt2i>::iterator pit = gt_w.begin ();
-  while (pit != gt_w.end ())
+void GTPerfTest::saveCache (const std::string &cname, uint64_t key) const
+{
+  std::vector<unsigned char> data (CACHE_TAG, CACHE_TAG + 4);
+  const unsigned char *kp = (const unsigned char *) &key;
+  data.insert (data.end (), kp, kp + sizeof (key));
+  int32_t head[3] = {(int32_t) width, (int32_t) height,
+                     (int32_t) gt_names.size ()};
+  const unsigned char *hp = (const unsigned char *) head;
+  data.insert (data.end (), hp, hp + sizeof (head));
+  std::vector<std::string>::const_iterator it = gt_names.begin ();
+  while (it != gt_names.end ())
   {
-    int red = QColor(map_p.pixel (pit->x (), height - 1 - pit->y ())).red ();
-    if (red < 200) map_p.setPixel (pit->x (), height - 1 - pit->y (),
-                                   127 + 127 * 256 + 127 * 256 * 256);
-    pit ++;
+    int32_t len = (int32_t) it->size ();
+    const unsigned char *lp = (const unsigned char *) &len;
+    data.insert (data.end (), lp, lp + sizeof (len));
+    data.insert (data.end (), it->begin (), it->end ());
+    it ++;
   }
-  int nbok = 0, nbtot = 0;
+  gt_l.encodeRuns (data);
+  gt_w.encodeRuns (data);
+  gt_labels.encodeRuns (data);
+
+  // Writes in a private file first, as concurrent runs may share the cache
+#ifdef _WIN32
+  int pid = _getpid ();
+#else
+  int pid = (int) getpid ();
+#endif
+  std::string tmpname = cname + std::string (".") + std::to_string (pid)
+                        + std::string (".")
+                        + std::to_string ((unsigned long long) (size_t) this);
+  std::ofstream output (tmpname, std::ios::out | std::ios::binary);
+  if (! output) return;
+  output.write ((const char *) data.data (), (std::streamsize) data.size ());
+  output.close ();
+  if (! output || std::rename (tmpname.c_str (), cname.c_str ()) != 0)
+    std::remove (tmpname.c_str ());
+}
+
+
+void GTPerfTest::distanceHistogram (const BitMask &mask,
+                                    const std::vector<uint32_t> &d2,
+                                    std::vector<int64_t> &hist) const
+{
+  uint32_t last = (uint32_t) hist.size () - 1;
+  int wpr = mask.wordsPerRow ();
   for (int j = 0; j < height; j++)
-    for (int i = 0; i < width; i++)
-      if (QColor(det_map->pixel(i,j)).lightness () > 100)
-      {
-        int red = QColor(map_p.pixel (i, j)).red ();
-        if (red > 100 && red < 150)
-        {
-          map_p.setPixel (i, j, 255 * 256 );
-          nbok ++;
-          nbtot ++;
-        }
-        else if (red < 200)
+  {
+    const uint64_t *m = mask.row (j);
+    const uint64_t *e = discard.row (j);
+    const uint32_t *d = d2.data () + (size_t) j * width;
+    for (int k = 0; k < wpr; k++)
+    {
+      uint64_t bits = m[k] & ~e[k];
+      for (int b = 0; bits != 0; b++, bits >>= 1)
+        if (bits & 1)
         {
-          map_p.setPixel (i, j, 255);
-          nbtot ++;
+          uint32_t v = d[k * 64 + b];
+          hist[v < last ? v : last] ++;
         }
-      }
-  precision = (nbok * 100) / (float) nbtot;
-  std::cout << "Precision : " << precision << std::endl;
-  std::string pname (PREC_PREF);
-  pname += sect_name + std::string (IMAGE_SUFFIX);
-  map_p.save (pname.c_str ());
+    }
+  }
 }
 
 
-void GTPerfTest::getFMeasure ()
+void GTPerfTest::saveMeasureMap (const BitMask &tested, const BitMask &ref,
+                                 const std::string &name)
+{
+  writers.push_back (std::thread (&GTPerfTest::writeMeasureMap,
+                                  tested, ref, discard, name));
+}
+
+
+void GTPerfTest::writeMask (BitMask excl, std::string name)
+{
+  std::vector<uint32_t> palette;
+  palette.push_back (0xffffff);
+  palette.push_back (0x000000);
+  if (! PngWriter::save (name, excl.width (), excl.height (), palette,
+                         [&excl] (int j, unsigned char *pix) {
+         for (int i = 0; i < excl.width (); i++)
+           pix[i] = (excl.get (i, j) ? 1 : 0); }))
+    std::cout << "Cannot write " << name << std::endl;
+}
+
+
+void GTPerfTest::writeMeasureMap (BitMask tested, BitMask ref, BitMask excl,
+                                  std::string name)
 {
-  fmeasure = 2 * recall * precision / (recall + precision);
-  std::cout << "F-measure : " << fmeasure << std::endl;
+  // Palette : black, grey, blue, green, red
+  std::vector<uint32_t> palette;
+  palette.push_back (0x000000);
+  palette.push_back (0x7f7f7f);
+  palette.push_back (0x0000ff);
+  palette.push_back (0x00ff00);
+  palette.push_back (0xff0000);
+  if (! PngWriter::save (name, tested.width (), tested.height (), palette,
+                         [&] (int j, unsigned char *pix) {
+         for (int i = 0; i < tested.width (); i++)
+         {
+           if (excl.get (i, j)) pix[i] = 4;
+           else if (tested.get (i, j)) pix[i] = (ref.get (i, j) ? 3 : 2);
+           else pix[i] = (ref.get (i, j) ? 1 : 0);
+         } }))
+    std::cout << "Cannot write " << name << std::endl;
 }
@@ -22,15 +22,24 @@
 #ifndef GT_PERF_TEST_H
 #define GT_PERF_TEST_H
 
-#include <QImage>
+#include <string>
+#include <vector>
+#include <thread>
 #include "astrack.h"
 #include "asarea.h"
+#include "bitmask.h"
+#include "labelmap.h"
+#include "spanmask.h"
+#include "imagereader.h"
 
 
 /** 
  * @class GTPerfTest gtperftest.h
  * \brief Road detector performance test.
  * Compares detected roads with a created ground truth (recall and precision).
+ * Detection, ground truth and discarded areas are stored as bit masks,
+ *   and measures are counted on their combinations.
+ * No GUI library is used, so that tests can be run on headless machines.
  */
 class GTPerfTest
 {
@@ -57,17 +66,43 @@ public:
   void setSize (int width, int height,
                 int64_t xref, int64_t yref, int mapsize);
 
+  /**
+   * \brief Sets the size and dimensions of the structures from tile headers.
+   * Only normal map and point tile file headers are read.
+   * Returns false if a header can not be read or tiles are inconsistent.
+   * @param nvmfiles Normal map file names.
+   * @param tilfiles Point tile file names.
+   */
+  bool setTiles (const std::vector<std::string> &nvmfiles,
+                 const std::vector<std::string> &tilfiles);
+
+  /**
+   * \brief Sets the diagnostic images output modality.
+   * @param on Recall and precision maps are saved if true.
+   */
+  void setDiagnostics (bool on);
+
+  /**
+   * \brief Sets the messages and measures display modality.
+   * @param on Messages and measures are displayed if true.
+   */
+  void setVerbose (bool on);
+
   /**
    * \brief Loads a map of detected structures.
+   * PNG files, or binary PGM and PPM files are accepted.
+   * If the file is missing, a PGM file with same base name is looked for.
+   * Returns false if the map can not be read.
    * @param name of the map file.
    */
-  void loadDetectionMap (std::string name);
+  bool loadDetectionMap (std::string name);
 
   /**
    * \brief Loads discarded areas for this test.
+   * Returns false if the area file can not be read.
    * @param name Area file name.
    */
-  void loadDiscardedAreas (std::string name);
+  bool loadDiscardedAreas (std::string name);
 
   /**
    * \brief Loads the name of tested sector.
@@ -83,16 +118,24 @@ public:
 
   /**
    * \brief Outputs measure mask.
+   * The image is compressed and saved in background.
    */
   void getMask ();
 
+  /**
+   * \brief Waits for the end of background image outputs.
+   */
+  void waitOutputs ();
+
   /**
    * \brief Computes and edits recall measure.
+   * The recall map is saved in background if diagnostics are set.
    */
   void getRecall ();
 
   /**
    * \brief Computes and edits precision measure.
+   * The precision map is saved in background if diagnostics are set.
    */
   void getPrecision ();
 
@@ -101,17 +144,102 @@ public:
    */
   void getFMeasure ();
 
+  /**
+   * \brief Computes and edits recall and precision for a list of tolerances.
+   * Recall counts ground truth line pixels closer to a detected pixel than
+   *   the tolerance, precision counts detected pixels closer to a ground
+   *   truth line pixel than the tolerance.
+   * Both distance maps are computed once and measures for all tolerances
+   *   are derived from histograms of distances.
+   * Measures are also saved in a CSV file.
+   * @param tol Tolerances (in pixels).
+   */
+  void getToleranceCurves (std::vector<float> tol);
+
+  /**
+   * \brief Computes and edits the precision-recall curve over detection
+   *   map lightness thresholds.
+   * The last loaded detection map is read again in a single pass, and
+   *   pixels are counted per lightness level.
+   * The curve is saved in a CSV file, best F-measure threshold and
+   *   average precision are edited.
+   */
+  void getThresholdSweep ();
+
+  /**
+   * \brief Computes and edits measures per ground truth road and per tile.
+   * All counts are accumulated in a single pass over the masks, road
+   *   pixels being identified in a label map of the ground truth lines.
+   * Measures are saved in CSV files, and missed roads are edited.
+   */
+  void getBreakdown ();
+
+  /**
+   * \brief Returns the last computed recall (in percent).
+   */
+  inline float recallValue () const { return recall; }
+
+  /**
+   * \brief Returns the last computed precision (in percent).
+   */
+  inline float precisionValue () const { return precision; }
+
+  /**
+   * \brief Returns the last computed F-measure (in percent).
+   */
+  inline float fMeasureValue () const { return fmeasure; }
+
+  /**
+   * \brief Loads the sector test files and edits all measures.
+   * Detection map, road set and discarded areas file names are derived
+   *   from the sector name.
+   * @param mask Measure mask output modality.
+   */
+  void run (bool mask);
+
+  /**
+   * \brief Loads the sector test files and edits recall, precision and
+   *   F-measure in bounded memory.
+   * The detection map is decoded, and ground truth and discarded areas
+   *   are drawn, by horizontal strips of the tile set, so that only
+   *   strip masks are allocated.
+   * Returns false if the road set or the detection map can not be read.
+   * @param strip Strip height (in pixels), default height if not positive.
+   */
+  bool runStrips (int strip);
+
 
 private:
+
+  /** Default tile size (in pixels). */
+  static const int DEFAULT_TILE_SIZE;
+  /** Recall below which a road is reported as missed (in percent). */
+  static const float MISSED_RECALL;
+  /** Default strip height for bounded memory evaluation (in pixels). */
+  static const int DEFAULT_STRIP_HEIGHT;
  
   /** Ground truth roads. */
   std::vector<ASTrack *> gt_roads;
-  /** Wide ground truth map. */
-  std::vector<Pt2i> gt_w;
-  /** Fine ground truth map. */
-  std::vector<Pt2i> gt_l;
-  /** Detected plateaux. */
-  QImage *det_map;
+  /** Ground truth road names. */
+  std::vector<std::string> gt_names;
+  /** Ground truth line pixels labelled by road (index + 1). */
+  LabelMap gt_labels;
+  /** Wide ground truth pixels. */
+  BitMask gt_w;
+  /** Fine ground truth pixels. */
+  BitMask gt_l;
+  /** Detected road pixels. */
+  BitMask det_map;
+  /** Discarded area pixels. */
+  BitMask discard;
+  /** Discarded area spans. */
+  SpanMask excluded;
+  /** Loaded detection map file name. */
+  std::string det_name;
+  /** Diagnostic images output modality. */
+  bool diag;
+  /** Messages and measures display modality. */
+  bool verbose;
 
   /** Output recall. */
   float recall;
@@ -120,11 +248,6 @@ private:
   /** Output F-measure. */
   float fmeasure;
 
-  /** Output recall map. */
-  QImage map_r;
-  /** Output precision map. */
-  QImage map_p;
-
   /** Tile set width. */
   int width;
   /** Tile set height. */
@@ -135,6 +258,10 @@ private:
   int64_t yref;
   /** Covered terrain size per tile (in meters). */
   int mapsize;
+  /** Tile width (in pixels). */
+  int tile_w;
+  /** Tile height (in pixels). */
+  int tile_h;
 
   /** Studied sector name. */
   std::string sect_name;
@@ -142,6 +269,156 @@ private:
   int tr_width;
   /** Discarded areas. */
   ASArea *area;
+  /** Background image output threads. */
+  std::vector<std::thread> writers;
+
+
+  /**
+   * \brief Returns the lightness of a color (mean of extreme components).
+   * @param rgb Color as 0xRRGGBB value.
+   */
+  static inline int lightness (uint32_t rgb) {
+    int r = (rgb >> 16) & 0xff, g = (rgb >> 8) & 0xff, b = rgb & 0xff;
+    int cmax = (r > g ? (r > b ? r : b) : (g > b ? g : b));
+    int cmin = (r < g ? (r < b ? r : b) : (g < b ? g : b));
+    return ((cmax + cmin) / 2); }
+
+  /**
+   * \brief Draws the ground truth roads in a mask.
+   * Roads are drawn as polylines with round caps and joins.
+   * @param mask Mask to draw in.
+   * @param pen_width Road drawing width.
+   * @param labels Label map of thin road pixels to fill in (optional).
+   * @param top Tile set row of the mask first row.
+   */
+  void drawRoads (BitMask &mask, int pen_width,
+                  LabelMap *labels = NULL, int top = 0) const;
+
+  /**
+   * \brief Opens the detection map, or the PGM file with same base name.
+   * Returns false if none can be opened.
+   * @param name Detection map file name.
+   * @param im Image reader to open.
+   */
+  bool openDetectionMap (const std::string &name, ImageReader &im);
+
+  /**
+   * \brief Allocates an empty discarded area mask if none is loaded yet.
+   */
+  void initDiscard ();
+
+  /**
+   * \brief Reads discarded areas and builds their spans.
+   * Returns false if the area file can not be read.
+   * @param name Area file name.
+   */
+  bool readAreas (const std::string &name);
+
+  /**
+   * \brief Sets the discarded area pixels in a mask.
+   * @param mask Mask to draw in.
+   * @param top Tile set row of the mask first row.
+   */
+  void drawAreas (BitMask &mask, int top = 0) const;
+
+  /**
+   * \brief Reads the road names listed in a road set file.
+   * Returns false if the file can not be read.
+   * @param name Road set file name.
+   * @param rnames Road names to complete.
+   */
+  bool readRoadNames (const std::string &name,
+                      std::vector<std::string> &rnames) const;
+
+  /**
+   * \brief Loads the delineated roads of given names.
+   * Unreadable roads are skipped.
+   * @param rnames Road names.
+   */
+  void loadTracks (const std::vector<std::string> &rnames);
+
+  /**
+   * \brief Updates a FNV-1a hash value with a byte array.
+   * @param hash Hash value to update.
+   * @param data Byte array.
+   * @param n Byte array size.
+   */
+  static void hashBytes (uint64_t &hash, const char *data, size_t n);
+
+  /**
+   * \brief Updates a FNV-1a hash value with a file content.
+   * Returns false if the file can not be read.
+   * @param hash Hash value to update.
+   * @param name File name.
+   */
+  static bool hashFile (uint64_t &hash, const std::string &name);
+
+  /**
+   * \brief Returns the ground truth cache key.
+   * The key hashes the road set and delineated road files contents,
+   *   the road width and the tile set geometry.
+   * @param name Road set file name.
+   * @param rnames Road names listed in the road set.
+   */
+  uint64_t cacheKey (const std::string &name,
+                     const std::vector<std::string> &rnames) const;
+
+  /**
+   * \brief Loads ground truth rasters and road names from a cache file.
+   * Returns false if the cache is missing, stale or corrupted.
+   * @param cname Cache file name.
+   * @param key Expected cache key.
+   */
+  bool loadCache (const std::string &cname, uint64_t key);
+
+  /**
+   * \brief Saves ground truth rasters and road names in a cache file.
+   * Rasters are run-length encoded.
+   * @param cname Cache file name.
+   * @param key Cache key.
+   */
+  void saveCache (const std::string &cname, uint64_t key) const;
+
+  /**
+   * \brief Accumulates the histogram of squared distances of mask pixels.
+   * Discarded pixels are not counted, farther pixels go to the last bin.
+   * @param mask Counted pixels.
+   * @param d2 Squared distances of all pixels.
+   * @param hist Histogram to fill in.
+   */
+  void distanceHistogram (const BitMask &mask,
+                          const std::vector<uint32_t> &d2,
+                          std::vector<int64_t> &hist) const;
+
+  /**
+   * \brief Saves a measure map in background.
+   * Masks are copied so that measures can go on meanwhile.
+   * @param tested Tested pixels.
+   * @param ref Reference pixels.
+   * @param name Output image file name.
+   */
+  void saveMeasureMap (const BitMask &tested, const BitMask &ref,
+                       const std::string &name);
+
+  /**
+   * \brief Writes a discarded area mask image.
+   * @param excl Discarded pixels.
+   * @param name Output image file name.
+   */
+  static void writeMask (BitMask excl, std::string name);
+
+  /**
+   * \brief Writes a measure map image.
+   * Tested pixels are displayed in green when found in the reference,
+   *   in blue otherwise, other reference pixels in grey and discarded
+   *   areas in red.
+   * @param tested Tested pixels.
+   * @param ref Reference pixels.
+   * @param excl Discarded pixels.
+   * @param name Output image file name.
+   */
+  static void writeMeasureMap (BitMask tested, BitMask ref, BitMask excl,
+                               std::string name);
 
 };
 #endif
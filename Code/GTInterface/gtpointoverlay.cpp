@@ -0,0 +1,187 @@
+/*  Copyright 2021 Philippe Even and Phuc Ngo,
+      authors of paper:
+      Even, P., and Ngo, P., 2021,
+      Automatic forest road extraction fromLiDAR data of mountainous areas.
+      In the First International Joint Conference of Discrete Geometry
+      and Mathematical Morphology (Springer LNCS 12708), pp. 93-106.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+#include <inttypes.h>
+#include "gtpointoverlay.h"
+
+
+const int GTPointOverlay::MODE_OFF = 0;
+const int GTPointOverlay::MODE_HEIGHT = 1;
+const int GTPointOverlay::MODE_LABEL = 2;
+const int GTPointOverlay::NB_MODES = 3;
+const int GTPointOverlay::CURSOR_RADIUS = 128;
+const int GTPointOverlay::CURSOR_STEP = 16;
+const int GTPointOverlay::FULL_CELL_SIZE = 4;
+const int GTPointOverlay::MAX_POINTS = 1000000;
+
+
+GTPointOverlay::View::View ()
+{
+  mode = MODE_OFF;
+  width = 0;
+  height = 0;
+  xshift = 0;
+  yshift = 0;
+  zoom = 1;
+  dezoom = 1;
+  cursor = QPoint (-1, -1);
+}
+
+
+GTPointOverlay::GTPointOverlay ()
+{
+  ptset = NULL;
+  iratio = 1.0f;
+  iheight = 0;
+}
+
+
+void GTPointOverlay::setPoints (const IPtTileSet *pts, float ratio, int h)
+{
+  ptset = pts;
+  iratio = ratio;
+  iheight = h;
+}
+
+
+std::string GTPointOverlay::name (int mode)
+{
+  if (mode == MODE_HEIGHT) return (std::string ("points by height"));
+  if (mode == MODE_LABEL) return (std::string ("points by label"));
+  return (std::string ("no points"));
+}
+
+
+QImage GTPointOverlay::build (const View &view) const
+{
+  QImage im (view.width, view.height, QImage::Format_ARGB32);
+  im.fill (0);
+  if (view.mode == MODE_OFF || ptset == NULL
+      || ptset->columnsOfTiles () == 0 || ptset->rowsOfTiles () == 0)
+    return im;
+
+  // Screen pixels per millimeter, screen ordinate of the map bottom
+  float sc = (iratio * view.zoom) / (view.dezoom * 1000.0f);
+  float ybot = ((float) (iheight * view.zoom)) / view.dezoom + view.yshift;
+
+  // Visible cells, sampled every step cells when smaller than a pixel
+  int tw = ptset->tileWidth (), th = ptset->tileHeight ();
+  int csize = ptset->tileXSpread () / tw;
+  float cpix = csize * sc;
+  int step = (cpix >= 1.0f ? 1 : (int) (1.0f / cpix));
+  bool full = (cpix >= FULL_CELL_SIZE);
+  int cimin = (int) ((- view.xshift) / cpix);
+  int cimax = (int) ((view.width - view.xshift) / cpix);
+  int cjmin = (int) ((ybot - view.height) / cpix);
+  int cjmax = (int) (ybot / cpix);
+  if (cimin < 0) cimin = 0;
+  if (cjmin < 0) cjmin = 0;
+  if (cimax >= ptset->columnsOfTiles () * tw)
+    cimax = ptset->columnsOfTiles () * tw - 1;
+  if (cjmax >= ptset->rowsOfTiles () * th)
+    cjmax = ptset->rowsOfTiles () * th - 1;
+  cimin -= cimin % step;
+  cjmin -= cjmin % step;
+
+  // Full density area around the cursor (in cells)
+  bool lod = (step == 1 && view.cursor.x () >= 0 && view.cursor.y () >= 0);
+  float cx = (view.cursor.x () - view.xshift) / cpix;
+  float cy = (ybot - view.cursor.y ()) / cpix;
+  float crad = CURSOR_RADIUS / cpix;
+
+  // Collects screen positions and values (heights or labels)
+  std::vector<Pt3i> dots;
+  int budget = MAX_POINTS;
+  int zmin = 0, zmax = 0;
+  for (int pass = 0; pass < 2; pass++)
+  {
+    if (pass == 0 && ! lod) continue;
+    for (int cj = cjmin; cj <= cjmax; cj += step)
+    {
+      const IPtTile *tile = NULL;
+      int tcol = -1;
+      for (int ci = cimin; ci <= cimax; ci += step)
+      {
+        bool near = false;
+        if (lod)
+        {
+          float dx = ci + 0.5f - cx, dy = cj + 0.5f - cy;
+          near = (dx * dx + dy * dy < crad * crad);
+        }
+        if (near != (pass == 0)) continue;
+        if (ci / tw != tcol)
+        {
+          tcol = ci / tw;
+          tile = ptset->getTile (tcol, cj / th);
+        }
+        if (tile == NULL || tile->unloaded ()) continue;
+        int i = ci % tw, j = cj % th;
+        int n = tile->cellSize (i, j);
+        if (n == 0) continue;
+        if ((near || full) && n <= budget) budget -= n;
+        else n = 1;  // per-cell decimation
+        const Pt3i *pt = tile->cellStartPt (i, j);
+        const unsigned char *labs = tile->getLabelsArray ();
+        if (labs != NULL) labs += tile->cellStart (i, j);
+        int64_t ox = (int64_t) (ci / tw) * ptset->tileXSpread ();
+        int64_t oy = (int64_t) (cj / th) * ptset->tileYSpread ();
+        for (int k = 0; k < n; k++)
+        {
+          int sx = (int) ((ox + pt[k].x ()) * sc) + view.xshift;
+          int sy = (int) (ybot - (oy + pt[k].y ()) * sc);
+          if (sx < 0 || sx >= view.width || sy < 0 || sy >= view.height)
+            continue;
+          int val = pt[k].z ();
+          if (view.mode == MODE_LABEL) val = (labs != NULL ? labs[k] : 0);
+          else if (dots.empty ()) zmin = zmax = val;
+          else if (val < zmin) zmin = val;
+          else if (val > zmax) zmax = val;
+          dots.push_back (Pt3i (sx, sy, val));
+        }
+      }
+    }
+  }
+
+  // Draws the collected points
+  uint32_t *bits = (uint32_t *) im.bits ();
+  int stride = im.bytesPerLine () / 4;
+  for (std::vector<Pt3i>::const_iterator it = dots.begin ();
+       it != dots.end (); it++)
+    bits[it->y () * stride + it->x ()] = (view.mode == MODE_LABEL ?
+      (it->z () != 0 ? 0xffff0000u : 0xffd0d0d0u) :
+      heightColor (it->z (), zmin, zmax));
+  return im;
+}
+
+
+uint32_t GTPointOverlay::heightColor (int z, int zmin, int zmax)
+{
+  // Blue - cyan - green - yellow - red ramp
+  int t = (zmax > zmin ? (int) (((int64_t) (z - zmin) * 1020) / (zmax - zmin))
+                       : 0);
+  uint32_t r = 0, g = 0, b = 0;
+  if (t < 255) { g = t; b = 255; }
+  else if (t < 510) { g = 255; b = 510 - t; }
+  else if (t < 765) { r = t - 510; g = 255; }
+  else { r = 255; g = 1020 - t; }
+  return (0xff000000u | (r << 16) | (g << 8) | b);
+}
@@ -0,0 +1,163 @@
+/*  Copyright 2021 Philippe Even and Phuc Ngo,
+      authors of paper:
+      Even, P., and Ngo, P., 2021,
+      Automatic forest road extraction fromLiDAR data of mountainous areas.
+      In the First International Joint Conference of Discrete Geometry
+      and Mathematical Morphology (Springer LNCS 12708), pp. 93-106.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef GT_POINT_OVERLAY_H
+#define GT_POINT_OVERLAY_H
+
+#include <QImage>
+#include <QPoint>
+#include "ipttileset.h"
+
+
+/** 
+ * @class GTPointOverlay gtpointoverlay.h
+ * \brief Display of point cloud points over the DTM map.
+ * Points of the visible area are drawn in a transparent image of the
+ *   widget size, so that the display cost does not depend on the density.
+ * Points are decimated to one point per cell when cells are smaller than
+ *   a few screen pixels, except around the cursor where all points are
+ *   drawn, within a bounded total count of points.
+ */
+class GTPointOverlay
+{
+public:
+
+  /**
+   * @class View gtpointoverlay.h
+   * \brief Display parameters of a point overlay.
+   */
+  class View
+  {
+  public:
+
+    /** Overlay mode. */
+    int mode;
+    /** Widget width. */
+    int width;
+    /** Widget height. */
+    int height;
+    /** X-scroll shift. */
+    int xshift;
+    /** Y-scroll shift. */
+    int yshift;
+    /** Window zoom. */
+    int zoom;
+    /** Window dezoom. */
+    int dezoom;
+    /** Cursor position in the widget (negative if unknown). */
+    QPoint cursor;
+
+    /**
+     * \brief Creates an empty view.
+     */
+    View ();
+
+    /**
+     * \brief Checks equality with another view.
+     * @param v Other view.
+     */
+    inline bool operator== (const View &v) const {
+      return (mode == v.mode && width == v.width && height == v.height
+              && xshift == v.xshift && yshift == v.yshift
+              && zoom == v.zoom && dezoom == v.dezoom
+              && cursor == v.cursor); }
+
+    /**
+     * \brief Checks difference with another view.
+     * @param v Other view.
+     */
+    inline bool operator!= (const View &v) const { return (! (*this == v)); }
+
+    /**
+     * \brief Checks whether an overlay of another view can be displayed
+     *   in this view, possibly shifted.
+     * @param v Other view.
+     */
+    inline bool sameScale (const View &v) const {
+      return (mode == v.mode && zoom == v.zoom && dezoom == v.dezoom); }
+  };
+
+  /** Overlay mode : no point displayed. */
+  static const int MODE_OFF;
+  /** Overlay mode : points colored by height. */
+  static const int MODE_HEIGHT;
+  /** Overlay mode : points colored by label. */
+  static const int MODE_LABEL;
+  /** Count of overlay modes. */
+  static const int NB_MODES;
+  /** Radius of full density display around the cursor (screen pixels). */
+  static const int CURSOR_RADIUS;
+  /** Cursor position quantization step (screen pixels). */
+  static const int CURSOR_STEP;
+  /** Minimal cell size for full density display (screen pixels). */
+  static const int FULL_CELL_SIZE;
+  /** Maximal count of points drawn at full density. */
+  static const int MAX_POINTS;
+
+
+  /**
+   * \brief Creates a point overlay.
+   */
+  GTPointOverlay ();
+
+  /**
+   * \brief Sets the displayed point cloud and its geometry.
+   * @param pts Point cloud.
+   * @param ratio Image to meter ratio.
+   * @param h DTM image height.
+   */
+  void setPoints (const IPtTileSet *pts, float ratio, int h);
+
+  /**
+   * \brief Returns the name of an overlay mode.
+   * @param mode Overlay mode.
+   */
+  static std::string name (int mode);
+
+  /**
+   * \brief Builds the overlay image of a view.
+   * Can be called in a separate thread while points are not modified.
+   * @param view Display parameters.
+   */
+  QImage build (const View &view) const;
+
+
+private:
+
+  /** Displayed point cloud. */
+  const IPtTileSet *ptset;
+  /** Image to meter ratio. */
+  float iratio;
+  /** DTM image height. */
+  int iheight;
+
+
+  /**
+   * \brief Returns the color of a height in the displayed range.
+   * @param z Point height.
+   * @param zmin Lowest displayed height.
+   * @param zmax Highest displayed height.
+   */
+  static uint32_t heightColor (int z, int zmin, int zmax);
+};
+
+#endif
@@ -0,0 +1,142 @@
+/*  Copyright 2021 Philippe Even and Phuc Ngo,
+      authors of paper:
+      Even, P., and Ngo, P., 2021,
+      Automatic forest road extraction fromLiDAR data of mountainous areas.
+      In the First International Joint Conference of Discrete Geometry
+      and Mathematical Morphology (Springer LNCS 12708), pp. 93-106.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+#include <QtGui>
+#include <inttypes.h>
+#include "gtprofileview.h"
+
+
+const int GTProfileView::DEFAULT_WIDTH = 360;
+const int GTProfileView::DEFAULT_HEIGHT = 400;
+const int GTProfileView::MARGIN = 8;
+const float GTProfileView::MIN_HEIGHT_RANGE = 1.0f;
+
+
+GTProfileView::GTProfileView (QWidget *parent) : QWidget (parent)
+{
+  cross_half = 0.0f;
+  along_length = 0.0f;
+  along_pos = 0.0f;
+  setMinimumSize (DEFAULT_WIDTH, DEFAULT_HEIGHT);
+}
+
+
+GTProfileView::~GTProfileView ()
+{
+}
+
+
+void GTProfileView::setProfiles (const std::vector<Pt2f> &cross, float half,
+                                 const std::vector<Pt2f> &along,
+                                 float length, float pos)
+{
+  cross_pts = cross;
+  cross_half = half;
+  along_pts = along;
+  along_length = length;
+  along_pos = pos;
+  update ();
+}
+
+
+void GTProfileView::clearProfiles ()
+{
+  cross_pts.clear ();
+  along_pts.clear ();
+  update ();
+}
+
+
+void GTProfileView::paintEvent (QPaintEvent *event)
+{
+  Q_UNUSED (event);
+  QPainter painter (this);
+  painter.fillRect (rect (), Qt::white);
+  int w = size().width () - 2 * MARGIN;
+  int h = (size().height () - 3 * MARGIN) / 2;
+  if (w <= 0 || h <= 0) return;
+  drawProfile (painter, QRect (MARGIN, MARGIN, w, h),
+               cross_pts, - cross_half, cross_half, 0.0f,
+               QString ("Cross profile"));
+  drawProfile (painter, QRect (MARGIN, 2 * MARGIN + h, w, h),
+               along_pts, 0.0f, along_length, along_pos,
+               QString ("Longitudinal profile"));
+}
+
+
+void GTProfileView::drawProfile (QPainter &painter, const QRect &frame,
+                                 const std::vector<Pt2f> &pts,
+                                 float xmin, float xmax, float mark,
+                                 const QString &title)
+{
+  painter.setPen (Qt::gray);
+  painter.drawRect (frame);
+  if (pts.empty () || xmax <= xmin)
+  {
+    painter.drawText (frame.x () + MARGIN, frame.y () + 2 * MARGIN, title);
+    return;
+  }
+
+  // Height range centered on the points
+  float zmin = pts.front().y (), zmax = zmin;
+  for (std::vector<Pt2f>::const_iterator it = pts.begin ();
+       it != pts.end (); it++)
+  {
+    if (it->y () < zmin) zmin = it->y ();
+    else if (it->y () > zmax) zmax = it->y ();
+  }
+  if (zmax - zmin < MIN_HEIGHT_RANGE)
+  {
+    float mid = (zmin + zmax) / 2;
+    zmin = mid - MIN_HEIGHT_RANGE / 2;
+    zmax = mid + MIN_HEIGHT_RANGE / 2;
+  }
+  float sx = (frame.width () - 1) / (xmax - xmin);
+  float sz = (frame.height () - 1) / (zmax - zmin);
+
+  // Points rasterized at once, whatever their count
+  QImage im (frame.width (), frame.height (), QImage::Format_RGB32);
+  im.fill (Qt::white);
+  uint32_t *bits = (uint32_t *) im.bits ();
+  int stride = im.bytesPerLine () / 4;
+  for (std::vector<Pt2f>::const_iterator it = pts.begin ();
+       it != pts.end (); it++)
+  {
+    int i = (int) ((it->x () - xmin) * sx);
+    int j = frame.height () - 1 - (int) ((it->y () - zmin) * sz);
+    if (i >= 0 && i < frame.width () && j >= 0 && j < frame.height ())
+      bits[j * stride + i] = 0xff000000u;
+  }
+  painter.drawImage (frame.topLeft (), im);
+  painter.setPen (Qt::gray);
+  painter.drawRect (frame);
+
+  // Marker and legend
+  int mx = frame.x () + (int) ((mark - xmin) * sx);
+  painter.setPen (Qt::red);
+  painter.drawLine (mx, frame.y (), mx, frame.y () + frame.height () - 1);
+  painter.setPen (Qt::blue);
+  painter.drawText (frame.x () + MARGIN, frame.y () + 2 * MARGIN,
+                    title + QString (" : ") + QString::number (zmin)
+                    + QString (" - ") + QString::number (zmax)
+                    + QString (" m"));
+}
@@ -0,0 +1,120 @@
+/*  Copyright 2021 Philippe Even and Phuc Ngo,
+      authors of paper:
+      Even, P., and Ngo, P., 2021,
+      Automatic forest road extraction fromLiDAR data of mountainous areas.
+      In the First International Joint Conference of Discrete Geometry
+      and Mathematical Morphology (Springer LNCS 12708), pp. 93-106.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef GT_PROFILE_VIEW_H
+#define GT_PROFILE_VIEW_H
+
+#include <QWidget>
+#include <QPainter>
+#include <vector>
+#include "pt2f.h"
+
+
+/** 
+ * @class GTProfileView gtprofileview.h
+ * \brief Display of LiDAR profiles across and along a road segment.
+ * The cross profile is displayed above the longitudinal profile.
+ * Profile points are given as (abscissa, height) pairs in meters.
+ */
+class GTProfileView : public QWidget
+{
+  Q_OBJECT
+
+
+public:
+
+  /** Default widget width. */
+  static const int DEFAULT_WIDTH;
+  /** Default widget height. */
+  static const int DEFAULT_HEIGHT;
+  /** Margin around profile frames (in pixels). */
+  static const int MARGIN;
+  /** Minimal displayed height range (in meters). */
+  static const float MIN_HEIGHT_RANGE;
+
+
+  /**
+   * \brief Creates a profile view.
+   */
+  GTProfileView (QWidget *parent = 0);
+
+  /**
+   * \brief Deletes the profile view.
+   */
+  ~GTProfileView ();
+
+  /**
+   * \brief Sets the displayed profiles.
+   * @param cross Cross profile points (abscissae from the segment).
+   * @param half Cross profile half length.
+   * @param along Longitudinal profile points (abscissae from segment start).
+   * @param length Longitudinal profile length.
+   * @param pos Abscissa of the cross profile on the longitudinal profile.
+   */
+  void setProfiles (const std::vector<Pt2f> &cross, float half,
+                    const std::vector<Pt2f> &along, float length, float pos);
+
+  /**
+   * \brief Removes the displayed profiles.
+   */
+  void clearProfiles ();
+
+
+protected:
+
+  /**
+   * \brief Updates the widget drawing.
+   */
+  void paintEvent (QPaintEvent *event);
+
+
+private:
+
+  /** Cross profile points. */
+  std::vector<Pt2f> cross_pts;
+  /** Cross profile half length. */
+  float cross_half;
+  /** Longitudinal profile points. */
+  std::vector<Pt2f> along_pts;
+  /** Longitudinal profile length. */
+  float along_length;
+  /** Cross profile abscissa on the longitudinal profile. */
+  float along_pos;
+
+
+  /**
+   * \brief Draws a profile in a frame.
+   * Heights are scaled to fit the frame.
+   * @param painter Drawing device.
+   * @param frame Profile frame.
+   * @param pts Profile points.
+   * @param xmin Lowest abscissa.
+   * @param xmax Highest abscissa.
+   * @param mark Abscissa of the vertical marker.
+   * @param title Profile name.
+   */
+  void drawProfile (QPainter &painter, const QRect &frame,
+                    const std::vector<Pt2f> &pts, float xmin, float xmax,
+                    float mark, const QString &title);
+};
+
+#endif
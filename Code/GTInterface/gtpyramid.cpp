@@ -0,0 +1,142 @@
+/*  Copyright 2021 Philippe Even and Phuc Ngo,
+      authors of paper:
+      Even, P., and Ngo, P., 2021,
+      Automatic forest road extraction fromLiDAR data of mountainous areas.
+      In the First International Joint Conference of Discrete Geometry
+      and Mathematical Morphology (Springer LNCS 12708), pp. 93-106.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <inttypes.h>
+#include "gtpyramid.h"
+#include "asparallel.h"
+
+
+const int GTPyramid::MIN_LEVEL_SIZE = 64;
+
+
+GTPyramid::GTPyramid ()
+{
+  bw = 0;
+  bh = 0;
+}
+
+
+GTPyramid::~GTPyramid ()
+{
+}
+
+
+void GTPyramid::clear ()
+{
+  levels.clear ();
+  dirty_areas.clear ();
+  bw = 0;
+  bh = 0;
+}
+
+
+void GTPyramid::update (const QRect &dirty)
+{
+  QRect area = dirty;
+  for (int k = 0; k < (int) levels.size (); k++)
+  {
+    // Enclosing area at next level
+    area = QRect (QPoint (area.left () / 2, area.top () / 2),
+                  QPoint (area.right () / 2, area.bottom () / 2))
+           & levels[k].rect ();
+    if (area.isEmpty ()) break;
+    dirty_areas[k] = dirty_areas[k].united (area);
+  }
+}
+
+
+void GTPyramid::updateAll ()
+{
+  for (int k = 0; k < (int) levels.size (); k++)
+    dirty_areas[k] = levels[k].rect ();
+}
+
+
+int GTPyramid::levelCount (int w, int h)
+{
+  int n = 1;
+  while ((w >> n) >= MIN_LEVEL_SIZE && (h >> n) >= MIN_LEVEL_SIZE) n++;
+  return n;
+}
+
+
+const QImage &GTPyramid::level (const QImage &base, int k)
+{
+  if (k <= 0) return base;
+  if (base.width () != bw || base.height () != bh)
+    allocate (base.width (), base.height ());
+  if (levels.empty ()) return base;
+  if (k > (int) levels.size ()) k = (int) levels.size ();
+  for (int i = 0; i < k; i++)
+    if (! dirty_areas[i].isEmpty ())
+    {
+      reduce (i == 0 ? base : levels[i - 1], levels[i], dirty_areas[i]);
+      dirty_areas[i] = QRect ();
+    }
+  return levels[k - 1];
+}
+
+
+void GTPyramid::allocate (int w, int h)
+{
+  clear ();
+  bw = w;
+  bh = h;
+  int n = levelCount (w, h);
+  for (int k = 1; k < n; k++)
+  {
+    levels.push_back (QImage (w >> k, h >> k, QImage::Format_RGB32));
+    dirty_areas.push_back (levels.back().rect ());
+  }
+}
+
+
+void GTPyramid::reduce (const QImage &src, QImage &dst, const QRect &area)
+{
+  int x0 = area.left (), w = area.width ();
+  int y0 = area.top ();
+  uchar *dbits = dst.bits ();
+  int dbpl = dst.bytesPerLine ();
+  const uchar *sbits = src.constBits ();
+  int sbpl = src.bytesPerLine ();
+  ASParallel::forBands (area.height (), 16,
+    [=] (int start, int stop)
+    {
+      for (int j = y0 + start; j < y0 + stop; j++)
+      {
+        const uint32_t *s1 = (const uint32_t *) (sbits + 2 * j * sbpl);
+        const uint32_t *s2 = (const uint32_t *) (sbits + (2 * j + 1) * sbpl);
+        uint32_t *d = (uint32_t *) (dbits + j * dbpl);
+        for (int i = x0; i < x0 + w; i++)
+        {
+          // Two channels summed at once in each 32 bits word
+          uint32_t a = s1[2 * i], b = s1[2 * i + 1];
+          uint32_t c = s2[2 * i], e = s2[2 * i + 1];
+          uint32_t rb = (a & 0xff00ffu) + (b & 0xff00ffu)
+                        + (c & 0xff00ffu) + (e & 0xff00ffu) + 0x20002u;
+          uint32_t ag = ((a >> 8) & 0xff00ffu) + ((b >> 8) & 0xff00ffu)
+                        + ((c >> 8) & 0xff00ffu) + ((e >> 8) & 0xff00ffu)
+                        + 0x20002u;
+          d[i] = ((rb >> 2) & 0xff00ffu) | (((ag >> 2) & 0xff00ffu) << 8);
+        }
+      }
+    });
+}
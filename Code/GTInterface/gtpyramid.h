@@ -0,0 +1,116 @@
+/*  Copyright 2021 Philippe Even and Phuc Ngo,
+      authors of paper:
+      Even, P., and Ngo, P., 2021,
+      Automatic forest road extraction fromLiDAR data of mountainous areas.
+      In the First International Joint Conference of Discrete Geometry
+      and Mathematical Morphology (Springer LNCS 12708), pp. 93-106.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef GT_PYRAMID_H
+#define GT_PYRAMID_H
+
+#include <QImage>
+#include <QRect>
+#include <vector>
+
+
+/** 
+ * @class GTPyramid gtpyramid.h
+ * \brief Multi-resolution pyramid of a displayed image.
+ * Level k holds the image reduced by a factor 2^k (2x2 box filtering).
+ * Level 0 is the displayed image itself and is not stored.
+ * Modified areas are registered and levels are refreshed on demand.
+ */
+class GTPyramid
+{
+public:
+
+  /** Size under which no further level is created. */
+  static const int MIN_LEVEL_SIZE;
+
+
+  /**
+   * \brief Creates an empty pyramid.
+   */
+  GTPyramid ();
+
+  /**
+   * \brief Deletes the pyramid.
+   */
+  ~GTPyramid ();
+
+  /**
+   * \brief Releases all levels.
+   */
+  void clear ();
+
+  /**
+   * \brief Registers a modified area of the base image.
+   * @param dirty Modified area in base image coordinates.
+   */
+  void update (const QRect &dirty);
+
+  /**
+   * \brief Registers a modification of the whole base image.
+   */
+  void updateAll ();
+
+  /**
+   * \brief Returns the count of levels available for the given base size.
+   * @param w Base image width.
+   * @param h Base image height.
+   */
+  static int levelCount (int w, int h);
+
+  /**
+   * \brief Returns the pyramid level of given index, refreshed if needed.
+   * Returns the base image itself for index 0,
+   *   and the coarsest level for indices beyond.
+   * @param base Base image (level 0, RGB32 format).
+   * @param k Level index.
+   */
+  const QImage &level (const QImage &base, int k);
+
+
+private:
+
+  /** Pyramid levels from level 1. */
+  std::vector<QImage> levels;
+  /** Areas to refresh in each level (level coordinates). */
+  std::vector<QRect> dirty_areas;
+  /** Base image width. */
+  int bw;
+  /** Base image height. */
+  int bh;
+
+
+  /**
+   * \brief Allocates the levels for a new base size.
+   * @param w Base image width.
+   * @param h Base image height.
+   */
+  void allocate (int w, int h);
+
+  /**
+   * \brief Reduces an area of a level into the next one.
+   * @param src Finer level.
+   * @param dst Coarser level.
+   * @param area Area to compute in the coarser level.
+   */
+  static void reduce (const QImage &src, QImage &dst, const QRect &area);
+};
+
+#endif
@@ -23,6 +23,7 @@
 #include <QtGui>
 #include <QFileDialog>
 #include <QMenuBar>
+#include <QStatusBar>
 #include <iostream>
 
 
@@ -31,6 +32,8 @@ GTWindow::GTWindow (int *val)
   Q_UNUSED (val);
   creationWidget = new GTCreator;
   setCentralWidget (creationWidget);
+  createStatusBar ();
+  createProfileView ();
   // setFocus();  
   // createActions ();
   // createMenus ();
@@ -43,6 +46,8 @@ GTWindow::GTWindow ()
 {
   creationWidget = new GTCreator;
   setCentralWidget (creationWidget);
+  createStatusBar ();
+  createProfileView ();
   // setFocus ();
   // createActions ();
   // createMenus ();
@@ -66,7 +71,8 @@ bool GTWindow::setLidarFiles (const std::string &dtm, const std::string &pts)
 
 void GTWindow::createMaps (bool binary)
 {
-  resize (creationWidget->createMap (binary));
+  QSize msize = creationWidget->createMap (binary);
+  resize (msize.width () + GTProfileView::DEFAULT_WIDTH, msize.height ());
 }
 
 
@@ -76,23 +82,11 @@ void GTWindow::setSectorName (std::string name)
 }
 
 
-void GTWindow::setMaskDisplay (bool opt)
-{
-  creationWidget->setMaskDisplay (opt);
-}
-
-
 void GTWindow::runOptions ()
 {
 }
 
 
-void GTWindow::compare ()
-{
-  creationWidget->compare ();
-}
-
-
 void GTWindow::closeEvent (QCloseEvent *event)
 {
   event->accept ();
@@ -159,6 +153,41 @@ void GTWindow::createMenus ()
 }
 
 
+void GTWindow::createStatusBar ()
+{
+  loadBar = new QProgressBar (this);
+  loadBar->setFormat (tr ("Loading tiles %v / %m"));
+  statusBar()->addWidget (loadBar, 1);
+  statusBar()->hide ();
+  connect (creationWidget, SIGNAL (loadingProgress (int, int)),
+           this, SLOT (showLoading (int, int)));
+}
+
+
+void GTWindow::createProfileView ()
+{
+  profileView = new GTProfileView;
+  profileDock = new QDockWidget (tr ("Profiles"), this);
+  profileDock->setAllowedAreas (Qt::LeftDockWidgetArea
+                                | Qt::RightDockWidgetArea);
+  profileDock->setWidget (profileView);
+  addDockWidget (Qt::RightDockWidgetArea, profileDock);
+  creationWidget->setProfileView (profileView);
+}
+
+
+void GTWindow::showLoading (int done, int total)
+{
+  if (done < total)
+  {
+    loadBar->setRange (0, total);
+    loadBar->setValue (done);
+    statusBar()->show ();
+  }
+  else statusBar()->hide ();
+}
+
+
 bool GTWindow::saveFile (const QByteArray &fileFormat)
 {
   QString initialPath = QDir::currentPath () + "/untitled." + fileFormat;
@@ -24,6 +24,8 @@
 
 #include <QList>
 #include <QMainWindow>
+#include <QProgressBar>
+#include <QDockWidget>
 #include "gtcreator.h"
 
 
@@ -80,22 +82,11 @@ public:
    */
   void setSectorName (std::string name);
 
-  /**
-   * Sets the mask output option.
-   * @param opt New option status.
-   */
-  void setMaskDisplay (bool opt);
-
   /**
    * Takes into account the option (after image load).
    */
   void runOptions ();
 
-  /**
-   * Performs a comparison of the roads with detected roads from AMREL.
-   */
-  void compare ();
-
 
 protected:
   void closeEvent (QCloseEvent *event);
@@ -106,6 +97,13 @@ private slots:
   void save ();
   void updateActions ();
 
+  /**
+   * Displays the progress of background tile loading.
+   * @param done Count of loaded tiles.
+   * @param total Count of tiles to load.
+   */
+  void showLoading (int done, int total);
+
 
 private:
 
@@ -114,6 +112,8 @@ private:
 
   void createActions ();
   void createMenus ();
+  void createStatusBar ();
+  void createProfileView ();
   bool saveFile (const QByteArray &fileFormat);
   QMenu *saveAsMenu;
   QMenu *fileMenu;
@@ -121,6 +121,9 @@ private:
   QAction *openAct;
   QList<QAction *> saveAsActs;
   QAction *exitAct;
+  QProgressBar *loadBar;
+  QDockWidget *profileDock;
+  GTProfileView *profileView;
 
 };
 #endif
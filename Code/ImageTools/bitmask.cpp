@@ -0,0 +1,269 @@
+/*  Copyright 2021 Philippe Even and Phuc Ngo,
+      authors of paper:
+      Even, P., and Ngo, P., 2021,
+      Automatic forest road extraction fromLiDAR data of mountainous areas.
+      In the First International Joint Conference of Discrete Geometry
+      and Mathematical Morphology (Springer LNCS 12708), pp. 93-106.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <cmath>
+#include "bitmask.h"
+#include "varint.h"
+
+
+BitMask::BitMask ()
+{
+  mw = 0;
+  mh = 0;
+  wpr = 0;
+}
+
+
+BitMask::BitMask (int w, int h)
+{
+  mw = 0;
+  mh = 0;
+  wpr = 0;
+  resize (w, h);
+}
+
+
+BitMask::~BitMask ()
+{
+}
+
+
+void BitMask::resize (int w, int h)
+{
+  mw = (w < 0 ? 0 : w);
+  mh = (h < 0 ? 0 : h);
+  wpr = (mw + 63) / 64;
+  words.assign ((size_t) wpr * mh, (uint64_t) 0);
+}
+
+
+void BitMask::clear ()
+{
+  words.assign (words.size (), (uint64_t) 0);
+}
+
+
+void BitMask::setSpan (int j, int imin, int imax)
+{
+  if (j < 0 || j >= mh) return;
+  if (imin < 0) imin = 0;
+  if (imax > mw) imax = mw;
+  if (imin >= imax) return;
+  int w0 = imin >> 6, w1 = (imax - 1) >> 6;
+  uint64_t m0 = (~((uint64_t) 0)) << (imin & 63);
+  uint64_t m1 = (~((uint64_t) 0)) >> (63 - ((imax - 1) & 63));
+  uint64_t *r = row (j);
+  if (w0 == w1) r[w0] |= m0 & m1;
+  else
+  {
+    r[w0] |= m0;
+    for (int k = w0 + 1; k < w1; k++) r[k] = ~((uint64_t) 0);
+    r[w1] |= m1;
+  }
+}
+
+
+void BitMask::setRect (int imin, int jmin, int imax, int jmax)
+{
+  if (jmin < 0) jmin = 0;
+  if (jmax > mh) jmax = mh;
+  for (int j = jmin; j < jmax; j++) setSpan (j, imin, imax);
+}
+
+
+void BitMask::drawLine (int x1, int y1, int x2, int y2)
+{
+  int dx = (x2 > x1 ? x2 - x1 : x1 - x2);
+  int dy = (y2 > y1 ? y2 - y1 : y1 - y2);
+  int sx = (x2 > x1 ? 1 : -1);
+  int sy = (y2 > y1 ? 1 : -1);
+  int err = dx - dy;
+  while (true)
+  {
+    if (x1 >= 0 && x1 < mw && y1 >= 0 && y1 < mh) set (x1, y1);
+    if (x1 == x2 && y1 == y2) break;
+    int e2 = 2 * err;
+    if (e2 > - dy)
+    {
+      err -= dy;
+      x1 += sx;
+    }
+    if (e2 < dx)
+    {
+      err += dx;
+      y1 += sy;
+    }
+  }
+}
+
+
+void BitMask::drawThickLine (int x1, int y1, int x2, int y2, float width)
+{
+  double r = width / 2.0 + 1e-9;
+  double ex = x2 - x1, ey = y2 - y1;
+  double l2 = ex * ex + ey * ey;
+  double rl = r * sqrt (l2);
+  int jmin = (int) floor ((y1 < y2 ? y1 : y2) - r);
+  int jmax = (int) ceil ((y1 > y2 ? y1 : y2) + r);
+  if (jmin < 0) jmin = 0;
+  if (jmax > mh - 1) jmax = mh - 1;
+  for (int j = jmin; j <= jmax; j++)
+  {
+    // The row crosses the convex segment area on a single span
+    double lo = HUGE_VAL, hi = - HUGE_VAL;
+    for (int k = 0; k < 2; k++)
+    {
+      double dy = j - (k == 0 ? y1 : y2);
+      if (dy * dy <= r * r)
+      {
+        double dx = sqrt (r * r - dy * dy);
+        double cx = (k == 0 ? x1 : x2);
+        if (cx - dx < lo) lo = cx - dx;
+        if (cx + dx > hi) hi = cx + dx;
+      }
+    }
+    if (l2 > 0.)
+    {
+      // Distance to the segment line below r and projection inside
+      double dy = j - y1;
+      double a = - HUGE_VAL, b = HUGE_VAL;
+      if (ey != 0.)
+      {
+        double u = (ex * dy - rl) / ey, v = (ex * dy + rl) / ey;
+        a = (u < v ? u : v);
+        b = (u < v ? v : u);
+      }
+      else if (ex * dy > rl || ex * dy < - rl) a = HUGE_VAL;
+      if (ex != 0.)
+      {
+        double u = - ey * dy / ex, v = (l2 - ey * dy) / ex;
+        if ((u < v ? u : v) > a) a = (u < v ? u : v);
+        if ((u < v ? v : u) < b) b = (u < v ? v : u);
+      }
+      else if (ey * dy < 0. || ey * dy > l2) a = HUGE_VAL;
+      if (a <= b)
+      {
+        if (x1 + a < lo) lo = x1 + a;
+        if (x1 + b > hi) hi = x1 + b;
+      }
+    }
+    if (lo <= hi) setSpan (j, (int) ceil (lo), (int) floor (hi) + 1);
+  }
+}
+
+
+void BitMask::intersect (const BitMask &m)
+{
+  for (size_t k = 0; k < words.size (); k++) words[k] &= m.words[k];
+}
+
+
+void BitMask::subtract (const BitMask &m)
+{
+  for (size_t k = 0; k < words.size (); k++) words[k] &= ~m.words[k];
+}
+
+
+void BitMask::unite (const BitMask &m)
+{
+  for (size_t k = 0; k < words.size (); k++) words[k] |= m.words[k];
+}
+
+
+int64_t BitMask::count (const BitMask *excl) const
+{
+  int64_t nb = 0;
+  if (excl == NULL)
+    for (size_t k = 0; k < words.size (); k++) nb += popCount (words[k]);
+  else
+    for (size_t k = 0; k < words.size (); k++)
+      nb += popCount (words[k] & ~excl->words[k]);
+  return nb;
+}
+
+
+int64_t BitMask::countAnd (const BitMask &m, const BitMask *excl) const
+{
+  int64_t nb = 0;
+  if (excl == NULL)
+    for (size_t k = 0; k < words.size (); k++)
+      nb += popCount (words[k] & m.words[k]);
+  else
+    for (size_t k = 0; k < words.size (); k++)
+      nb += popCount (words[k] & m.words[k] & ~excl->words[k]);
+  return nb;
+}
+
+
+void BitMask::encodeRuns (std::vector<unsigned char> &out) const
+{
+  for (int j = 0; j < mh; j++)
+  {
+    int i = 0;
+    if (mw != 0 && get (0, j)) putVarint (out, 0);
+    while (i < mw)
+    {
+      int e = runEnd (j, i);
+      putVarint (out, (uint32_t) (e - i));
+      i = e;
+    }
+  }
+}
+
+
+bool BitMask::decodeRuns (const unsigned char *&in, const unsigned char *end)
+{
+  clear ();
+  for (int j = 0; j < mh; j++)
+  {
+    int i = 0;
+    bool on = false;
+    while (i < mw)
+    {
+      uint32_t len = 0;
+      if (! getVarint (in, end, len) || len > (uint32_t) (mw - i))
+        return false;
+      if (on) setSpan (j, i, i + (int) len);
+      i += (int) len;
+      on = ! on;
+    }
+  }
+  return true;
+}
+
+
+int BitMask::runEnd (int j, int i) const
+{
+  const uint64_t *r = row (j);
+  int k = i >> 6;
+  // Words are complemented for runs of pixels on
+  uint64_t flip = (((r[k] >> (i & 63)) & 1) ? ~((uint64_t) 0) : 0);
+  uint64_t w = (r[k] ^ flip) & ((~((uint64_t) 0)) << (i & 63));
+  while (w == 0)
+  {
+    if (++k == wpr) return mw;
+    w = r[k] ^ flip;
+  }
+  int b = 0;
+  while (((w >> b) & 1) == 0) b ++;
+  int e = (k << 6) + b;
+  return (e < mw ? e : mw);
+}
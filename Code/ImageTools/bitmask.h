@@ -0,0 +1,243 @@
+/*  Copyright 2021 Philippe Even and Phuc Ngo,
+      authors of paper:
+      Even, P., and Ngo, P., 2021,
+      Automatic forest road extraction fromLiDAR data of mountainous areas.
+      In the First International Joint Conference of Discrete Geometry
+      and Mathematical Morphology (Springer LNCS 12708), pp. 93-106.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef BIT_MASK_H
+#define BIT_MASK_H
+
+#include <cstddef>
+#include <vector>
+#include <inttypes.h>
+
+
+/** 
+ * @class BitMask bitmask.h
+ * \brief Binary image packed in 64-bit words.
+ * Each row starts on a new word, unused bits at the end of rows stay off.
+ * Pixel counts on combined masks are performed word by word.
+ */
+class BitMask
+{
+public:
+
+  /**
+   * \brief Creates an empty mask.
+   */
+  BitMask ();
+
+  /**
+   * \brief Creates a mask with all pixels off.
+   * @param w Mask width.
+   * @param h Mask height.
+   */
+  BitMask (int w, int h);
+
+  /**
+   * \brief Deletes the mask.
+   */
+  ~BitMask ();
+
+  /**
+   * \brief Changes the mask size and sets all pixels off.
+   * @param w New mask width.
+   * @param h New mask height.
+   */
+  void resize (int w, int h);
+
+  /**
+   * \brief Sets all pixels off.
+   */
+  void clear ();
+
+  /**
+   * \brief Returns the mask width.
+   */
+  inline int width () const { return mw; }
+
+  /**
+   * \brief Returns the mask height.
+   */
+  inline int height () const { return mh; }
+
+  /**
+   * \brief Returns the count of words per row.
+   */
+  inline int wordsPerRow () const { return wpr; }
+
+  /**
+   * \brief Returns a row of words.
+   * @param j Row index.
+   */
+  inline uint64_t *row (int j) { return (&(words[j * wpr])); }
+
+  /**
+   * \brief Returns a row of words.
+   * @param j Row index.
+   */
+  inline const uint64_t *row (int j) const { return (&(words[j * wpr])); }
+
+  /**
+   * \brief Returns whether a pixel is on.
+   * @param i Pixel column.
+   * @param j Pixel row.
+   */
+  inline bool get (int i, int j) const {
+    return ((words[j * wpr + (i >> 6)] >> (i & 63)) & 1); }
+
+  /**
+   * \brief Sets a pixel on.
+   * @param i Pixel column.
+   * @param j Pixel row.
+   */
+  inline void set (int i, int j) {
+    words[j * wpr + (i >> 6)] |= ((uint64_t) 1) << (i & 63); }
+
+  /**
+   * \brief Sets a pixel off.
+   * @param i Pixel column.
+   * @param j Pixel row.
+   */
+  inline void reset (int i, int j) {
+    words[j * wpr + (i >> 6)] &= ~(((uint64_t) 1) << (i & 63)); }
+
+  /**
+   * \brief Sets on pixels of a row span clipped to the mask.
+   * @param j Row index.
+   * @param imin Left column.
+   * @param imax Right column + 1.
+   */
+  void setSpan (int j, int imin, int imax);
+
+  /**
+   * \brief Sets on all pixels of a rectangle clipped to the mask.
+   * @param imin Left column.
+   * @param jmin Top row.
+   * @param imax Right column + 1.
+   * @param jmax Bottom row + 1.
+   */
+  void setRect (int imin, int jmin, int imax, int jmax);
+
+  /**
+   * \brief Sets on the pixels of a one pixel wide digital segment.
+   * Pixels outside the mask are ignored.
+   * @param x1 Start point column.
+   * @param y1 Start point row.
+   * @param x2 End point column.
+   * @param y2 End point row.
+   */
+  void drawLine (int x1, int y1, int x2, int y2);
+
+  /**
+   * \brief Sets on the pixels of a thick segment with round caps.
+   * Pixels with center closer to the segment than half the width are set.
+   * Successive segments of a polyline thus get round joins.
+   * Pixels outside the mask are ignored.
+   * @param x1 Start point column.
+   * @param y1 Start point row.
+   * @param x2 End point column.
+   * @param y2 End point row.
+   * @param width Segment width.
+   */
+  void drawThickLine (int x1, int y1, int x2, int y2, float width);
+
+  /**
+   * \brief Keeps pixels that are on in both masks.
+   * @param m Mask of same size.
+   */
+  void intersect (const BitMask &m);
+
+  /**
+   * \brief Sets off pixels that are on in another mask.
+   * @param m Mask of same size.
+   */
+  void subtract (const BitMask &m);
+
+  /**
+   * \brief Sets on pixels that are on in another mask.
+   * @param m Mask of same size.
+   */
+  void unite (const BitMask &m);
+
+  /**
+   * \brief Returns the count of pixels on.
+   * @param excl Mask of pixels not to count (same size, optional).
+   */
+  int64_t count (const BitMask *excl = NULL) const;
+
+  /**
+   * \brief Returns the count of pixels on in both masks.
+   * @param m Mask of same size.
+   * @param excl Mask of pixels not to count (same size, optional).
+   */
+  int64_t countAnd (const BitMask &m, const BitMask *excl = NULL) const;
+
+  /**
+   * \brief Appends the run-length encoding of the mask to a byte array.
+   * Each row is coded as alternate lengths of off and on runs, starting
+   *   with an off run, stored as variable length integers.
+   * @param out Byte array to complete.
+   */
+  void encodeRuns (std::vector<unsigned char> &out) const;
+
+  /**
+   * \brief Sets the mask pixels from a run-length encoding.
+   * Returns false if the code is truncated or does not fit the mask size.
+   * @param in Code start, moved to the end of the mask code.
+   * @param end End of the available code.
+   */
+  bool decodeRuns (const unsigned char *&in, const unsigned char *end);
+
+  /**
+   * \brief Returns the count of bits on in a word.
+   * @param w Word.
+   */
+  static inline int popCount (uint64_t w) {
+#ifdef __GNUC__
+    return (__builtin_popcountll (w));
+#else
+    w = w - ((w >> 1) & 0x5555555555555555ULL);
+    w = (w & 0x3333333333333333ULL) + ((w >> 2) & 0x3333333333333333ULL);
+    w = (w + (w >> 4)) & 0x0f0f0f0f0f0f0f0fULL;
+    return ((int) ((w * 0x0101010101010101ULL) >> 56));
+#endif
+  }
+
+
+private:
+
+  /** Mask width. */
+  int mw;
+  /** Mask height. */
+  int mh;
+  /** Count of words per row. */
+  int wpr;
+  /** Mask words, row by row. */
+  std::vector<uint64_t> words;
+
+
+  /**
+   * \brief Returns the end of the run of same pixel values in a row.
+   * @param j Row index.
+   * @param i Run start column.
+   */
+  int runEnd (int j, int i) const;
+
+};
+#endif
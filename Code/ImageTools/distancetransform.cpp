@@ -0,0 +1,114 @@
+/*  Copyright 2021 Philippe Even and Phuc Ngo,
+      authors of paper:
+      Even, P., and Ngo, P., 2021,
+      Automatic forest road extraction fromLiDAR data of mountainous areas.
+      In the First International Joint Conference of Discrete Geometry
+      and Mathematical Morphology (Springer LNCS 12708), pp. 93-106.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <cmath>
+#include "distancetransform.h"
+#include "asparallel.h"
+
+const uint32_t DistanceTransform::INFINITE = 0xffffffff;
+const int DistanceTransform::MIN_BAND = 64;
+
+
+void DistanceTransform::squaredDistances (const BitMask &mask,
+                                          std::vector<uint32_t> &d2)
+{
+  int w = mask.width (), h = mask.height ();
+  d2.assign ((size_t) w * h, INFINITE);
+  if (w == 0 || h == 0) return;
+
+  // Vertical distances to nearest pixel on, scanning bands of columns
+  uint32_t far = (uint32_t) (w + h);
+  ASParallel::forBands (w, MIN_BAND, [&] (int start, int stop) {
+    for (int i = start; i < stop; i++)
+      d2[i] = (mask.get (i, 0) ? 0 : far);
+    for (int j = 1; j < h; j++)
+    {
+      uint32_t *cur = d2.data () + (size_t) j * w;
+      const uint32_t *prev = cur - w;
+      for (int i = start; i < stop; i++)
+        cur[i] = (mask.get (i, j) ? 0 : (prev[i] < far ? prev[i] + 1 : far));
+    }
+    for (int j = h - 2; j >= 0; j--)
+    {
+      uint32_t *cur = d2.data () + (size_t) j * w;
+      const uint32_t *next = cur + w;
+      for (int i = start; i < stop; i++)
+        if (next[i] + 1 < cur[i]) cur[i] = next[i] + 1;
+    }
+  });
+
+  // Squared distances along rows
+  ASParallel::forBands (h, MIN_BAND, [&] (int start, int stop) {
+    std::vector<int> v (w);
+    std::vector<double> z (w + 1);
+    std::vector<uint32_t> out (w);
+    for (int j = start; j < stop; j++)
+    {
+      uint32_t *f = d2.data () + (size_t) j * w;
+      for (int i = 0; i < w; i++)
+        f[i] = (f[i] >= far ? INFINITE : f[i] * f[i]);
+      envelope (f, w, v.data (), z.data (), out.data ());
+    }
+  });
+}
+
+
+void DistanceTransform::envelope (uint32_t *f, int n, int *v, double *z,
+                                  uint32_t *out)
+{
+  // Only finite parabolas enter the envelope
+  int k = -1;
+  for (int q = 0; q < n; q++)
+  {
+    if (f[q] == INFINITE) continue;
+    if (k < 0)
+    {
+      k = 0;
+      v[0] = q;
+      z[0] = - HUGE_VAL;
+      z[1] = HUGE_VAL;
+      continue;
+    }
+    int p = v[k];
+    double s = (((double) f[q] + (double) q * q)
+                - ((double) f[p] + (double) p * p)) / (2.0 * (q - p));
+    while (s <= z[k])
+    {
+      p = v[--k];
+      s = (((double) f[q] + (double) q * q)
+           - ((double) f[p] + (double) p * p)) / (2.0 * (q - p));
+    }
+    k ++;
+    v[k] = q;
+    z[k] = s;
+    z[k + 1] = HUGE_VAL;
+  }
+  if (k < 0) return;
+
+  int l = 0;
+  for (int q = 0; q < n; q++)
+  {
+    while (z[l + 1] < q) l ++;
+    int64_t dq = q - v[l];
+    out[q] = (uint32_t) (dq * dq + f[v[l]]);
+  }
+  for (int q = 0; q < n; q++) f[q] = out[q];
+}
@@ -0,0 +1,71 @@
+/*  Copyright 2021 Philippe Even and Phuc Ngo,
+      authors of paper:
+      Even, P., and Ngo, P., 2021,
+      Automatic forest road extraction fromLiDAR data of mountainous areas.
+      In the First International Joint Conference of Discrete Geometry
+      and Mathematical Morphology (Springer LNCS 12708), pp. 93-106.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef DISTANCE_TRANSFORM_H
+#define DISTANCE_TRANSFORM_H
+
+#include <vector>
+#include <inttypes.h>
+#include "bitmask.h"
+
+
+/** 
+ * @class DistanceTransform distancetransform.h
+ * \brief Exact Euclidean distance transform of a binary mask.
+ * Squared distances are computed in two separable passes (column scans,
+ *   then lower envelopes of parabolas along rows), following
+ *   Felzenszwalb and Huttenlocher, Distance transforms of sampled
+ *   functions, Theory of Computing 8(19), 2012.
+ * Both passes are shared between hardware threads.
+ */
+class DistanceTransform
+{
+public:
+
+  /** Squared distance of pixels when the mask is empty. */
+  static const uint32_t INFINITE;
+
+  /**
+   * \brief Computes squared distances to the nearest pixel on in a mask.
+   * @param mask Input mask.
+   * @param d2 Row-ordered squared distances to fill in.
+   */
+  static void squaredDistances (const BitMask &mask,
+                                std::vector<uint32_t> &d2);
+
+
+private:
+
+  /** Minimal count of columns or rows processed by a thread. */
+  static const int MIN_BAND;
+
+  /**
+   * \brief Computes the lower envelope of parabolas along a row.
+   * @param f Squared column distances of the row, replaced by the output.
+   * @param n Row length.
+   * @param v Parabola locations buffer (n values).
+   * @param z Envelope boundaries buffer (n + 1 values).
+   * @param out Output buffer (n values).
+   */
+  static void envelope (uint32_t *f, int n, int *v, double *z,
+                        uint32_t *out);
+};
+#endif
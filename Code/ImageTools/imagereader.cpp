@@ -0,0 +1,693 @@
+/*  Copyright 2021 Philippe Even and Phuc Ngo,
+      authors of paper:
+      Even, P., and Ngo, P., 2021,
+      Automatic forest road extraction fromLiDAR data of mountainous areas.
+      In the First International Joint Conference of Discrete Geometry
+      and Mathematical Morphology (Springer LNCS 12708), pp. 93-106.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <iostream>
+#include <cstring>
+#include "imagereader.h"
+
+const int ImageReader::WINDOW_SIZE = 32768;
+const int ImageReader::BUFFER_SIZE = 65536;
+
+#define PNG_IHDR 0x49484452
+#define PNG_PLTE 0x504c5445
+#define PNG_IDAT 0x49444154
+#define PNG_IEND 0x49454e44
+
+/** Deflate length code bases. */
+static const uint16_t LENGTH_BASE[29] = {
+  3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+  35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+/** Deflate length code extra bits. */
+static const uint8_t LENGTH_EXTRA[29] = {
+  0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+  3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+/** Deflate distance code bases. */
+static const uint16_t DIST_BASE[30] = {
+  1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+  257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145,
+  8193, 12289, 16385, 24577};
+/** Deflate distance code extra bits. */
+static const uint8_t DIST_EXTRA[30] = {
+  0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+  7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+/** Order of code length code lengths in dynamic blocks. */
+static const uint8_t CODE_ORDER[19] = {
+  16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+
+
+ImageReader::ImageReader ()
+{
+  iw = 0;
+  ih = 0;
+  rows_read = 0;
+  png = false;
+  channels = 1;
+  depth = 8;
+  color_type = 0;
+  max_val = 255;
+  bpp = 1;
+  row_bytes = 0;
+  buf_pos = 0;
+  buf_end = 0;
+  idat_left = 0;
+  idat_end = true;
+  bitbuf = 0;
+  bitcnt = 0;
+  win_pos = 0;
+  last_block = false;
+  block_type = -1;
+  stored_left = 0;
+  match_left = 0;
+  match_dist = 1;
+}
+
+
+ImageReader::~ImageReader ()
+{
+  close ();
+}
+
+
+bool ImageReader::open (const std::string &name)
+{
+  close ();
+  in.open (name.c_str (), std::ios::in | std::ios::binary);
+  if (! in) return false;
+  buf.resize (BUFFER_SIZE);
+  buf_pos = 0;
+  buf_end = 0;
+  rows_read = 0;
+  palette.clear ();
+
+  int c1 = nextByte ();
+  int c2 = nextByte ();
+  if (c1 == 'P' && (c2 == '5' || c2 == '6'))
+  {
+    png = false;
+    channels = (c2 == '5' ? 1 : 3);
+    if (! readPnmHeader (name))
+    {
+      close ();
+      return false;
+    }
+    return true;
+  }
+  static const int sig[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+  bool ok = (c1 == sig[0] && c2 == sig[1]);
+  for (int k = 2; ok && k < 8; k++) ok = (nextByte () == sig[k]);
+  if (! ok)
+  {
+    std::cout << name << ": unknown image format" << std::endl;
+    close ();
+    return false;
+  }
+  png = true;
+  if (! readPngHeader (name))
+  {
+    close ();
+    return false;
+  }
+  return true;
+}
+
+
+void ImageReader::close ()
+{
+  if (in.is_open ()) in.close ();
+  in.clear ();
+  iw = 0;
+  ih = 0;
+}
+
+
+bool ImageReader::readRow (uint32_t *rgb)
+{
+  if (! in.is_open () || rows_read >= ih) return false;
+  if (png)
+  {
+    if (! inflate (cur_row.data (), row_bytes + 1) || ! unfilter ())
+      return false;
+    convertPngRow (rgb);
+    std::copy (cur_row.begin () + 1, cur_row.end (), prev_row.begin ());
+  }
+  else
+  {
+    unsigned char *d = cur_row.data ();
+    for (int k = 0; k < row_bytes; k++)
+    {
+      int b = nextByte ();
+      if (b < 0) return false;
+      d[k] = (unsigned char) b;
+    }
+    int ss = (depth == 16 ? 2 : 1);
+    for (int i = 0; i < iw; i++)
+    {
+      int v[3] = {0, 0, 0};
+      for (int c = 0; c < channels; c++)
+      {
+        const unsigned char *s = d + (i * channels + c) * ss;
+        int val = (ss == 2 ? (s[0] << 8) | s[1] : s[0]);
+        v[c] = (val >= max_val ? 255 : (val * 255) / max_val);
+      }
+      if (channels == 1) v[1] = v[2] = v[0];
+      rgb[i] = 0xff000000 | (v[0] << 16) | (v[1] << 8) | v[2];
+    }
+  }
+  rows_read ++;
+  return true;
+}
+
+
+bool ImageReader::fillBuffer ()
+{
+  if (! in) return false;
+  in.read ((char *) buf.data (), BUFFER_SIZE);
+  buf_pos = 0;
+  buf_end = (int) in.gcount ();
+  return (buf_end > 0);
+}
+
+
+bool ImageReader::readUInt32 (uint32_t &val)
+{
+  val = 0;
+  for (int k = 0; k < 4; k++)
+  {
+    int b = nextByte ();
+    if (b < 0) return false;
+    val = (val << 8) | (uint32_t) b;
+  }
+  return true;
+}
+
+
+bool ImageReader::skip (uint32_t n)
+{
+  while (n != 0)
+  {
+    if (buf_pos == buf_end && ! fillBuffer ()) return false;
+    uint32_t av = (uint32_t) (buf_end - buf_pos);
+    if (av > n) av = n;
+    buf_pos += (int) av;
+    n -= av;
+  }
+  return true;
+}
+
+
+bool ImageReader::readPngHeader (const std::string &name)
+{
+  bool ihdr = false;
+  uint32_t data_len = 0;
+  while (true)
+  {
+    uint32_t len = 0, type = 0;
+    if (! readUInt32 (len) || ! readUInt32 (type))
+    {
+      std::cout << name << ": no image data" << std::endl;
+      return false;
+    }
+    if (type == PNG_IHDR)
+    {
+      uint32_t w = 0, h = 0;
+      if (len != 13 || ! readUInt32 (w) || ! readUInt32 (h))
+      {
+        std::cout << name << ": bad PNG header" << std::endl;
+        return false;
+      }
+      depth = nextByte ();
+      color_type = nextByte ();
+      int comp = nextByte ();
+      int filt = nextByte ();
+      int inter = nextByte ();
+      if (w == 0 || h == 0 || w > 0x7fffffff || h > 0x7fffffff
+          || comp != 0 || filt != 0 || ! skip (4))
+      {
+        std::cout << name << ": bad PNG header" << std::endl;
+        return false;
+      }
+      if (inter != 0)
+      {
+        std::cout << name << ": interlaced PNG not supported" << std::endl;
+        return false;
+      }
+      switch (color_type)
+      {
+        case 0 : channels = 1; break;
+        case 2 : channels = 3; break;
+        case 3 : channels = 1; break;
+        case 4 : channels = 2; break;
+        case 6 : channels = 4; break;
+        default : channels = 0;
+      }
+      bool okd = (depth == 8
+                  || (depth == 16 && color_type != 3)
+                  || ((depth == 1 || depth == 2 || depth == 4)
+                      && (color_type == 0 || color_type == 3)));
+      if (channels == 0 || ! okd)
+      {
+        std::cout << name << ": unsupported PNG color type or depth"
+                  << std::endl;
+        return false;
+      }
+      iw = (int) w;
+      ih = (int) h;
+      ihdr = true;
+    }
+    else if (type == PNG_PLTE)
+    {
+      for (uint32_t k = 0; k < len / 3; k++)
+      {
+        int r = nextByte ();
+        int g = nextByte ();
+        int b = nextByte ();
+        palette.push_back (0xff000000 | (r << 16) | (g << 8) | b);
+      }
+      if (! skip (len % 3 + 4)) return false;
+    }
+    else if (type == PNG_IDAT)
+    {
+      if (! ihdr || (color_type == 3 && palette.empty ()))
+      {
+        std::cout << name << ": bad PNG header" << std::endl;
+        return false;
+      }
+      data_len = len;
+      break;
+    }
+    else if (type == PNG_IEND)
+    {
+      std::cout << name << ": no image data" << std::endl;
+      return false;
+    }
+    else if (! skip (len + 4)) return false;
+  }
+
+  // Sets the inflater up at first image data chunk
+  idat_left = data_len;
+  idat_end = (data_len == 0 && ! skip (4));
+  bitbuf = 0;
+  bitcnt = 0;
+  window.assign (WINDOW_SIZE, 0);
+  win_pos = 0;
+  last_block = false;
+  block_type = -1;
+  stored_left = 0;
+  match_left = 0;
+  match_dist = 1;
+  bpp = (channels * depth) / 8;
+  if (bpp == 0) bpp = 1;
+  row_bytes = (int) (((int64_t) iw * channels * depth + 7) / 8);
+  cur_row.assign (row_bytes + 1, 0);
+  prev_row.assign (row_bytes, 0);
+
+  int cmf = getBits (8);
+  int flg = getBits (8);
+  if (cmf < 0 || flg < 0 || (cmf & 0x0f) != 8
+      || ((cmf << 8) | flg) % 31 != 0 || (flg & 0x20) != 0)
+  {
+    std::cout << name << ": bad PNG compression header" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+
+bool ImageReader::readPnmHeader (const std::string &name)
+{
+  iw = readPnmValue ();
+  ih = readPnmValue ();
+  max_val = readPnmValue ();
+  if (iw <= 0 || ih <= 0 || max_val <= 0 || max_val > 65535)
+  {
+    std::cout << name << ": bad PNM header" << std::endl;
+    iw = 0;
+    ih = 0;
+    return false;
+  }
+  depth = (max_val > 255 ? 16 : 8);
+  row_bytes = iw * channels * (depth / 8);
+  cur_row.assign (row_bytes, 0);
+  return true;
+}
+
+
+int ImageReader::readPnmValue ()
+{
+  int c = nextByte ();
+  while (c == '#' || c == ' ' || c == '\t' || c == '\r' || c == '\n')
+  {
+    if (c == '#') while (c >= 0 && c != '\n') c = nextByte ();
+    c = nextByte ();
+  }
+  if (c < '0' || c > '9') return (-1);
+  int val = 0;
+  while (c >= '0' && c <= '9')
+  {
+    if (val > 0x7ffffff) return (-1);
+    val = val * 10 + (c - '0');
+    c = nextByte ();
+  }
+  return val;
+}
+
+
+int ImageReader::nextDataByte ()
+{
+  while (idat_left == 0)
+  {
+    if (idat_end) return (-1);
+    uint32_t len = 0, type = 0;
+    if (! readUInt32 (len) || ! readUInt32 (type) || type != PNG_IDAT)
+    {
+      idat_end = true;
+      return (-1);
+    }
+    idat_left = len;
+    // CRC of this chunk is skipped with the next chunk header
+    if (len == 0 && ! skip (4)) idat_end = true;
+  }
+  int b = nextByte ();
+  if (--idat_left == 0 && ! skip (4)) idat_end = true;
+  return b;
+}
+
+
+bool ImageReader::needBits (int n)
+{
+  while (bitcnt < n)
+  {
+    int b = nextDataByte ();
+    if (b < 0) return false;
+    bitbuf |= ((uint64_t) b) << bitcnt;
+    bitcnt += 8;
+  }
+  return true;
+}
+
+
+int ImageReader::getBits (int n)
+{
+  if (! needBits (n)) return (-1);
+  int val = (int) (bitbuf & ((((uint64_t) 1) << n) - 1));
+  bitbuf >>= n;
+  bitcnt -= n;
+  return val;
+}
+
+
+bool ImageReader::buildCode (Huffman &h, const uint8_t *lengths, int n)
+{
+  for (int len = 0; len <= MAX_BITS; len++) h.count[len] = 0;
+  for (int s = 0; s < n; s++) h.count[lengths[s]] ++;
+  h.count[0] = 0;
+  int left = 1;
+  for (int len = 1; len <= MAX_BITS; len++)
+  {
+    left <<= 1;
+    left -= h.count[len];
+    if (left < 0) return false;
+  }
+  int offs[MAX_BITS + 2];
+  offs[1] = 0;
+  for (int len = 1; len <= MAX_BITS; len++)
+    offs[len + 1] = offs[len] + h.count[len];
+  for (int s = 0; s < n; s++)
+    if (lengths[s] != 0) h.symbol[offs[lengths[s]]++] = (uint16_t) s;
+
+  // Fast lookup of short codes, stored with reversed bit order
+  memset (h.fast, 0, sizeof (h.fast));
+  int code = 0, index = 0;
+  for (int len = 1; len <= FAST_BITS; len++)
+  {
+    for (int k = 0; k < h.count[len]; k++)
+    {
+      int rev = 0;
+      for (int b = 0; b < len; b++) rev |= ((code >> b) & 1) << (len - 1 - b);
+      for (int f = rev; f < (1 << FAST_BITS); f += (1 << len))
+        h.fast[f] = (uint16_t) ((len << 9) | h.symbol[index]);
+      code ++;
+      index ++;
+    }
+    code <<= 1;
+  }
+  return true;
+}
+
+
+int ImageReader::decodeSymbol (const Huffman &h)
+{
+  needBits (FAST_BITS);
+  int e = h.fast[bitbuf & ((1 << FAST_BITS) - 1)];
+  if (e != 0 && (e >> 9) <= bitcnt)
+  {
+    bitbuf >>= (e >> 9);
+    bitcnt -= (e >> 9);
+    return (e & 511);
+  }
+  int code = 0, first = 0, index = 0;
+  for (int len = 1; len <= MAX_BITS; len++)
+  {
+    int b = getBits (1);
+    if (b < 0) return (-1);
+    code |= b;
+    int cnt = h.count[len];
+    if (code - cnt < first) return (h.symbol[index + (code - first)]);
+    index += cnt;
+    first += cnt;
+    first <<= 1;
+    code <<= 1;
+  }
+  return (-1);
+}
+
+
+bool ImageReader::startBlock ()
+{
+  int hdr = getBits (3);
+  if (hdr < 0) return false;
+  last_block = ((hdr & 1) != 0);
+  block_type = hdr >> 1;
+  if (block_type == 0)
+  {
+    bitbuf >>= (bitcnt & 7);
+    bitcnt -= (bitcnt & 7);
+    int len = getBits (16);
+    int nlen = getBits (16);
+    if (len < 0 || nlen < 0 || len != (~nlen & 0xffff)) return false;
+    stored_left = len;
+    return true;
+  }
+  if (block_type == 1)
+  {
+    uint8_t lengths[288];
+    for (int s = 0; s < 288; s++)
+      lengths[s] = (s < 144 ? 8 : (s < 256 ? 9 : (s < 280 ? 7 : 8)));
+    buildCode (lencode, lengths, 288);
+    for (int s = 0; s < 30; s++) lengths[s] = 5;
+    buildCode (distcode, lengths, 30);
+    return true;
+  }
+  if (block_type == 2) return readDynamicCodes ();
+  return false;
+}
+
+
+bool ImageReader::readDynamicCodes ()
+{
+  int nlen = getBits (5);
+  int ndist = getBits (5);
+  int ncode = getBits (4);
+  if (nlen < 0 || ndist < 0 || ncode < 0) return false;
+  nlen += 257;
+  ndist += 1;
+  ncode += 4;
+  if (nlen > 286 || ndist > 30) return false;
+
+  uint8_t lengths[320];
+  for (int k = 0; k < 19; k++) lengths[k] = 0;
+  for (int k = 0; k < ncode; k++)
+  {
+    int len = getBits (3);
+    if (len < 0) return false;
+    lengths[CODE_ORDER[k]] = (uint8_t) len;
+  }
+  if (! buildCode (lencode, lengths, 19)) return false;
+
+  int k = 0;
+  while (k < nlen + ndist)
+  {
+    int sym = decodeSymbol (lencode);
+    if (sym < 0) return false;
+    if (sym < 16) lengths[k++] = (uint8_t) sym;
+    else
+    {
+      int len = 0, rep = 0;
+      if (sym == 16)
+      {
+        if (k == 0) return false;
+        len = lengths[k - 1];
+        rep = getBits (2) + 3;
+      }
+      else if (sym == 17) rep = getBits (3) + 3;
+      else rep = getBits (7) + 11;
+      if (rep < 3 || k + rep > nlen + ndist) return false;
+      while (rep--) lengths[k++] = (uint8_t) len;
+    }
+  }
+  if (lengths[256] == 0) return false;
+  return (buildCode (lencode, lengths, nlen)
+          && buildCode (distcode, lengths + nlen, ndist));
+}
+
+
+bool ImageReader::inflate (unsigned char *out, int n)
+{
+  int k = 0;
+  while (k < n)
+  {
+    if (match_left > 0)
+    {
+      int m = (match_left < n - k ? match_left : n - k);
+      match_left -= m;
+      while (m--)
+      {
+        unsigned char b = window[(win_pos - match_dist) & (WINDOW_SIZE - 1)];
+        window[win_pos] = b;
+        win_pos = (win_pos + 1) & (WINDOW_SIZE - 1);
+        out[k++] = b;
+      }
+    }
+    else if (block_type < 0)
+    {
+      if (last_block || ! startBlock ()) return false;
+    }
+    else if (block_type == 0)
+    {
+      if (stored_left == 0) block_type = -1;
+      else
+      {
+        int b = getBits (8);
+        if (b < 0) return false;
+        stored_left --;
+        window[win_pos] = (unsigned char) b;
+        win_pos = (win_pos + 1) & (WINDOW_SIZE - 1);
+        out[k++] = (unsigned char) b;
+      }
+    }
+    else
+    {
+      int sym = decodeSymbol (lencode);
+      if (sym < 0) return false;
+      if (sym < 256)
+      {
+        window[win_pos] = (unsigned char) sym;
+        win_pos = (win_pos + 1) & (WINDOW_SIZE - 1);
+        out[k++] = (unsigned char) sym;
+      }
+      else if (sym == 256) block_type = -1;
+      else
+      {
+        sym -= 257;
+        if (sym >= 29) return false;
+        int len = getBits (LENGTH_EXTRA[sym]);
+        int dsym = decodeSymbol (distcode);
+        if (len < 0 || dsym < 0 || dsym >= 30) return false;
+        int dist = getBits (DIST_EXTRA[dsym]);
+        if (dist < 0) return false;
+        match_left = LENGTH_BASE[sym] + len;
+        match_dist = DIST_BASE[dsym] + dist;
+      }
+    }
+  }
+  return true;
+}
+
+
+bool ImageReader::unfilter ()
+{
+  unsigned char *d = cur_row.data () + 1;
+  const unsigned char *p = prev_row.data ();
+  switch (cur_row[0])
+  {
+    case 0 :
+      break;
+    case 1 :
+      for (int i = bpp; i < row_bytes; i++) d[i] += d[i - bpp];
+      break;
+    case 2 :
+      for (int i = 0; i < row_bytes; i++) d[i] += p[i];
+      break;
+    case 3 :
+      for (int i = 0; i < bpp; i++) d[i] += p[i] >> 1;
+      for (int i = bpp; i < row_bytes; i++)
+        d[i] += (unsigned char) ((d[i - bpp] + p[i]) >> 1);
+      break;
+    case 4 :
+      for (int i = 0; i < bpp; i++) d[i] += p[i];
+      for (int i = bpp; i < row_bytes; i++)
+      {
+        int a = d[i - bpp], b = p[i], c = p[i - bpp];
+        int pa = (b > c ? b - c : c - b);
+        int pb = (a > c ? a - c : c - a);
+        int pc = (a + b > 2 * c ? a + b - 2 * c : 2 * c - a - b);
+        d[i] += (unsigned char) (pa <= pb && pa <= pc ? a : (pb <= pc ? b : c));
+      }
+      break;
+    default :
+      return false;
+  }
+  return true;
+}
+
+
+void ImageReader::convertPngRow (uint32_t *rgb) const
+{
+  int maxv = (1 << (depth < 8 ? depth : 8)) - 1;
+  for (int i = 0; i < iw; i++)
+  {
+    if (color_type == 3)
+    {
+      int idx = sample (i);
+      rgb[i] = (idx < (int) palette.size () ? palette[idx] : 0xff000000);
+    }
+    else if (channels < 3)
+    {
+      int g = sample (i * channels);
+      if (maxv != 255) g = (g * 255) / maxv;
+      rgb[i] = 0xff000000 | (g << 16) | (g << 8) | g;
+    }
+    else
+      rgb[i] = 0xff000000 | (sample (i * channels) << 16)
+               | (sample (i * channels + 1) << 8) | sample (i * channels + 2);
+  }
+}
+
+
+int ImageReader::sample (int k) const
+{
+  const unsigned char *d = cur_row.data () + 1;
+  if (depth == 8) return (d[k]);
+  if (depth == 16) return (d[2 * k]);
+  int per = 8 / depth;
+  int shift = 8 - depth * (k % per + 1);
+  return ((d[k / per] >> shift) & ((1 << depth) - 1));
+}
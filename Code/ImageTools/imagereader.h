@@ -0,0 +1,290 @@
+/*  Copyright 2021 Philippe Even and Phuc Ngo,
+      authors of paper:
+      Even, P., and Ngo, P., 2021,
+      Automatic forest road extraction fromLiDAR data of mountainous areas.
+      In the First International Joint Conference of Discrete Geometry
+      and Mathematical Morphology (Springer LNCS 12708), pp. 93-106.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef IMAGE_READER_H
+#define IMAGE_READER_H
+
+#include <string>
+#include <fstream>
+#include <vector>
+#include <inttypes.h>
+
+
+/** 
+ * @class ImageReader imagereader.h
+ * \brief Row by row image file reader without any GUI library.
+ * Accepts non-interlaced PNG files (any color type and bit depth)
+ *   and binary PGM or PPM files.
+ * PNG data are inflated on the fly, so that only a few rows and the
+ *   compression window are kept in memory.
+ * Chunk CRC and stream checksums are not checked.
+ */
+class ImageReader
+{
+public:
+
+  /**
+   * \brief Creates an image reader.
+   */
+  ImageReader ();
+
+  /**
+   * \brief Deletes the image reader.
+   */
+  ~ImageReader ();
+
+  /**
+   * \brief Opens an image file and reads its header.
+   * Returns false if the file can not be opened or decoded.
+   * @param name Image file name.
+   */
+  bool open (const std::string &name);
+
+  /**
+   * \brief Closes the image file.
+   */
+  void close ();
+
+  /**
+   * \brief Returns the image width.
+   */
+  inline int width () const { return iw; }
+
+  /**
+   * \brief Returns the image height.
+   */
+  inline int height () const { return ih; }
+
+  /**
+   * \brief Reads next image row.
+   * Pixels are returned as 0xffRRGGBB values, alpha is ignored.
+   * Returns false on error or after the last row.
+   * @param rgb Array of image width values to fill in.
+   */
+  bool readRow (uint32_t *rgb);
+
+
+private:
+
+  /** Size of the compression window. */
+  static const int WINDOW_SIZE;
+  /** Bits of the fast Huffman code lookup tables. */
+  static const int FAST_BITS = 9;
+  /** Maximal Huffman code length. */
+  static const int MAX_BITS = 15;
+  /** Input buffer size. */
+  static const int BUFFER_SIZE;
+
+  /** Canonical Huffman code. */
+  struct Huffman
+  {
+    /** Code counts per length. */
+    uint16_t count[MAX_BITS + 1];
+    /** Symbols ordered by code. */
+    uint16_t symbol[320];
+    /** Length and symbol of codes starting with a given bit sequence. */
+    uint16_t fast[1 << FAST_BITS];
+  };
+
+  /** Image file. */
+  std::ifstream in;
+  /** Input buffer. */
+  std::vector<unsigned char> buf;
+  /** Position of next byte in input buffer. */
+  int buf_pos;
+  /** Count of bytes in input buffer. */
+  int buf_end;
+  /** Image width. */
+  int iw;
+  /** Image height. */
+  int ih;
+  /** Count of rows already read. */
+  int rows_read;
+  /** PNG format (or else PNM). */
+  bool png;
+  /** Count of color channels. */
+  int channels;
+  /** Bit depth of each channel. */
+  int depth;
+  /** PNG color type. */
+  int color_type;
+  /** PNM maximal sample value. */
+  int max_val;
+  /** PNG palette. */
+  std::vector<uint32_t> palette;
+  /** Count of bytes per pixel used by PNG filters (at least 1). */
+  int bpp;
+  /** Count of bytes per row. */
+  int row_bytes;
+  /** Current filtered row (with filter type byte). */
+  std::vector<unsigned char> cur_row;
+  /** Previous unfiltered row. */
+  std::vector<unsigned char> prev_row;
+
+  /** Remaining bytes of current IDAT chunk. */
+  uint32_t idat_left;
+  /** End of image data reached. */
+  bool idat_end;
+  /** Bit input buffer. */
+  uint64_t bitbuf;
+  /** Count of bits in bit input buffer. */
+  int bitcnt;
+  /** Compression window. */
+  std::vector<unsigned char> window;
+  /** Position of next output byte in compression window. */
+  int win_pos;
+  /** Current block is the last one. */
+  bool last_block;
+  /** Current block type (-1 if none). */
+  int block_type;
+  /** Remaining bytes of current stored block. */
+  int stored_left;
+  /** Remaining bytes of current match. */
+  int match_left;
+  /** Distance of current match. */
+  int match_dist;
+  /** Literal and length code. */
+  Huffman lencode;
+  /** Distance code. */
+  Huffman distcode;
+
+
+  /**
+   * \brief Returns next byte of the file, or -1 at end of file.
+   */
+  inline int nextByte () {
+    if (buf_pos == buf_end && ! fillBuffer ()) return (-1);
+    return (buf[buf_pos++]); }
+
+  /**
+   * \brief Refills the input buffer.
+   * Returns false at end of file.
+   */
+  bool fillBuffer ();
+
+  /**
+   * \brief Reads a big endian 32 bit value.
+   * Returns false at end of file.
+   * @param val Read value.
+   */
+  bool readUInt32 (uint32_t &val);
+
+  /**
+   * \brief Skips bytes of the file.
+   * Returns false at end of file.
+   * @param n Count of bytes to skip.
+   */
+  bool skip (uint32_t n);
+
+  /**
+   * \brief Reads PNG header chunks until first image data chunk.
+   * Returns false if the image can not be decoded.
+   * @param name Image file name (for messages).
+   */
+  bool readPngHeader (const std::string &name);
+
+  /**
+   * \brief Reads PNM header.
+   * Returns false if the image can not be decoded.
+   * @param name Image file name (for messages).
+   */
+  bool readPnmHeader (const std::string &name);
+
+  /**
+   * \brief Reads next PNM header token as a positive integer.
+   * Returns -1 on error.
+   */
+  int readPnmValue ();
+
+  /**
+   * \brief Returns next byte of image data, or -1 at end of data.
+   */
+  int nextDataByte ();
+
+  /**
+   * \brief Ensures that the bit input buffer holds enough bits.
+   * Returns false if the data end is reached.
+   * @param n Required count of bits.
+   */
+  bool needBits (int n);
+
+  /**
+   * \brief Extracts bits from the bit input buffer.
+   * Returns -1 if the data end is reached.
+   * @param n Count of bits.
+   */
+  int getBits (int n);
+
+  /**
+   * \brief Builds a canonical Huffman code from code lengths.
+   * Returns false if the code is over-subscribed.
+   * @param h Code to build.
+   * @param lengths Code length of each symbol.
+   * @param n Count of symbols.
+   */
+  static bool buildCode (Huffman &h, const uint8_t *lengths, int n);
+
+  /**
+   * \brief Decodes a symbol.
+   * Returns -1 on error.
+   * @param h Huffman code.
+   */
+  int decodeSymbol (const Huffman &h);
+
+  /**
+   * \brief Starts a new compressed block.
+   * Returns false on error.
+   */
+  bool startBlock ();
+
+  /**
+   * \brief Reads dynamic Huffman codes of a block.
+   * Returns false on error.
+   */
+  bool readDynamicCodes ();
+
+  /**
+   * \brief Inflates image data.
+   * Returns false if data are missing or corrupted.
+   * @param out Array to fill in.
+   * @param n Count of bytes to inflate.
+   */
+  bool inflate (unsigned char *out, int n);
+
+  /**
+   * \brief Reverses PNG filtering of current row.
+   * Returns false if filter type is unknown.
+   */
+  bool unfilter ();
+
+  /**
+   * \brief Converts current unfiltered PNG row to RGB values.
+   * @param rgb Array to fill in.
+   */
+  void convertPngRow (uint32_t *rgb) const;
+
+  /**
+   * \brief Returns a sample of current unfiltered PNG row scaled to 8 bits.
+   * @param k Sample index in the row.
+   */
+  int sample (int k) const;
+};
+#endif
@@ -0,0 +1,107 @@
+/*  Copyright 2021 Philippe Even and Phuc Ngo,
+      authors of paper:
+      Even, P., and Ngo, P., 2021,
+      Automatic forest road extraction fromLiDAR data of mountainous areas.
+      In the First International Joint Conference of Discrete Geometry
+      and Mathematical Morphology (Springer LNCS 12708), pp. 93-106.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "labelmap.h"
+#include "varint.h"
+
+
+LabelMap::LabelMap ()
+{
+  mw = 0;
+  mh = 0;
+}
+
+
+void LabelMap::resize (int w, int h)
+{
+  mw = w;
+  mh = h;
+  labels.assign ((size_t) w * h, 0);
+}
+
+
+void LabelMap::clear ()
+{
+  labels.assign (labels.size (), 0);
+}
+
+
+void LabelMap::drawLine (int x1, int y1, int x2, int y2, uint16_t lab)
+{
+  int dx = (x2 > x1 ? x2 - x1 : x1 - x2);
+  int dy = (y2 > y1 ? y2 - y1 : y1 - y2);
+  int sx = (x2 > x1 ? 1 : -1);
+  int sy = (y2 > y1 ? 1 : -1);
+  int err = dx - dy;
+  while (true)
+  {
+    if (x1 >= 0 && x1 < mw && y1 >= 0 && y1 < mh) set (x1, y1, lab);
+    if (x1 == x2 && y1 == y2) break;
+    int e2 = 2 * err;
+    if (e2 > - dy)
+    {
+      err -= dy;
+      x1 += sx;
+    }
+    if (e2 < dx)
+    {
+      err += dx;
+      y1 += sy;
+    }
+  }
+}
+
+
+void LabelMap::encodeRuns (std::vector<unsigned char> &out) const
+{
+  for (int j = 0; j < mh; j++)
+  {
+    const uint16_t *r = row (j);
+    int i = 0;
+    while (i < mw)
+    {
+      int e = i + 1;
+      while (e < mw && r[e] == r[i]) e ++;
+      putVarint (out, r[i]);
+      putVarint (out, (uint32_t) (e - i));
+      i = e;
+    }
+  }
+}
+
+
+bool LabelMap::decodeRuns (const unsigned char *&in, const unsigned char *end)
+{
+  for (int j = 0; j < mh; j++)
+  {
+    uint16_t *r = &(labels[(size_t) j * mw]);
+    int i = 0;
+    while (i < mw)
+    {
+      uint32_t lab = 0, len = 0;
+      if (! getVarint (in, end, lab) || ! getVarint (in, end, len)
+          || lab > 0xffff || len == 0 || len > (uint32_t) (mw - i))
+        return false;
+      for (uint32_t k = 0; k < len; k++) r[i++] = (uint16_t) lab;
+    }
+  }
+  return true;
+}
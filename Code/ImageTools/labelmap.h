@@ -0,0 +1,127 @@
+/*  Copyright 2021 Philippe Even and Phuc Ngo,
+      authors of paper:
+      Even, P., and Ngo, P., 2021,
+      Automatic forest road extraction fromLiDAR data of mountainous areas.
+      In the First International Joint Conference of Discrete Geometry
+      and Mathematical Morphology (Springer LNCS 12708), pp. 93-106.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef LABEL_MAP_H
+#define LABEL_MAP_H
+
+#include <cstddef>
+#include <vector>
+#include <inttypes.h>
+
+
+/** 
+ * @class LabelMap labelmap.h
+ * \brief Raster of 16 bit labels, 0 standing for no label.
+ */
+class LabelMap
+{
+public:
+
+  /**
+   * \brief Creates an empty label map.
+   */
+  LabelMap ();
+
+  /**
+   * \brief Changes the map size and clears all labels.
+   * @param w New map width.
+   * @param h New map height.
+   */
+  void resize (int w, int h);
+
+  /**
+   * \brief Clears all labels.
+   */
+  void clear ();
+
+  /**
+   * \brief Returns the map width.
+   */
+  inline int width () const { return mw; }
+
+  /**
+   * \brief Returns the map height.
+   */
+  inline int height () const { return mh; }
+
+  /**
+   * \brief Returns a row of labels.
+   * @param j Row index.
+   */
+  inline const uint16_t *row (int j) const {
+    return (&(labels[(size_t) j * mw])); }
+
+  /**
+   * \brief Returns the label of a pixel.
+   * @param i Pixel column.
+   * @param j Pixel row.
+   */
+  inline uint16_t get (int i, int j) const {
+    return (labels[(size_t) j * mw + i]); }
+
+  /**
+   * \brief Sets the label of a pixel.
+   * @param i Pixel column.
+   * @param j Pixel row.
+   * @param lab New label.
+   */
+  inline void set (int i, int j, uint16_t lab) {
+    labels[(size_t) j * mw + i] = lab; }
+
+  /**
+   * \brief Labels the pixels of a one pixel wide digital segment.
+   * Pixels are the same as those set by BitMask::drawLine.
+   * Pixels outside the map are ignored.
+   * @param x1 Start point column.
+   * @param y1 Start point row.
+   * @param x2 End point column.
+   * @param y2 End point row.
+   * @param lab Label to set.
+   */
+  void drawLine (int x1, int y1, int x2, int y2, uint16_t lab);
+
+  /**
+   * \brief Appends the run-length encoding of the map to a byte array.
+   * Each row is coded as pairs of label and run length, stored as
+   *   variable length integers.
+   * @param out Byte array to complete.
+   */
+  void encodeRuns (std::vector<unsigned char> &out) const;
+
+  /**
+   * \brief Sets the map labels from a run-length encoding.
+   * Returns false if the code is truncated or does not fit the map size.
+   * @param in Code start, moved to the end of the map code.
+   * @param end End of the available code.
+   */
+  bool decodeRuns (const unsigned char *&in, const unsigned char *end);
+
+
+private:
+
+  /** Map width. */
+  int mw;
+  /** Map height. */
+  int mh;
+  /** Row-ordered labels. */
+  std::vector<uint16_t> labels;
+};
+#endif
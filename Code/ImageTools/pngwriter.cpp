@@ -0,0 +1,360 @@
+/*  Copyright 2021 Philippe Even and Phuc Ngo,
+      authors of paper:
+      Even, P., and Ngo, P., 2021,
+      Automatic forest road extraction fromLiDAR data of mountainous areas.
+      In the First International Joint Conference of Discrete Geometry
+      and Mathematical Morphology (Springer LNCS 12708), pp. 93-106.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "pngwriter.h"
+#include "asparallel.h"
+
+const int PngWriter::CHUNK_SIZE = 65536;
+const int PngWriter::MIN_RUN = 3;
+const int PngWriter::MAX_RUN = 258;
+const int PngWriter::ADLER_SPAN = 5552;
+const int PngWriter::BAND_ROWS = 128;
+
+/** Deflate length code bases. */
+static const uint16_t LENGTH_BASE[29] = {
+  3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+  35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+/** Deflate length code extra bits. */
+static const uint8_t LENGTH_EXTRA[29] = {
+  0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+  3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+
+
+PngWriter::PngWriter ()
+{
+  iw = 0;
+  ih = 0;
+  rows_written = 0;
+  bitbuf = 0;
+  bitcnt = 0;
+  last = -1;
+  run = 0;
+  adler_a = 1;
+  adler_b = 0;
+  adler_n = 0;
+}
+
+
+PngWriter::~PngWriter ()
+{
+  if (out.is_open ()) close ();
+}
+
+
+bool PngWriter::open (const std::string &name, int width, int height,
+                      const std::vector<uint32_t> &palette)
+{
+  if (out.is_open ()) close ();
+  out.open (name.c_str (), std::ios::out | std::ios::binary);
+  if (! out) return false;
+  iw = width;
+  ih = height;
+  rows_written = 0;
+  data.clear ();
+  bitbuf = 0;
+  bitcnt = 0;
+  last = -1;
+  run = 0;
+  adler_a = 1;
+  adler_b = 0;
+  adler_n = 0;
+  writeHeader (palette);
+
+  // Zlib header, then a single final block with fixed Huffman codes
+  data.push_back (0x78);
+  data.push_back (0x01);
+  putBits (3, 3);
+  return (bool) out;
+}
+
+
+bool PngWriter::writeRow (const unsigned char *pix)
+{
+  if (! out.is_open () || rows_written >= ih) return false;
+  deflateRow (pix);
+  rows_written ++;
+  return (bool) out;
+}
+
+
+bool PngWriter::close ()
+{
+  if (! out.is_open ()) return false;
+  flushRun ();
+  putCode (0, 7);
+  if (bitcnt != 0) putBits (0, 8 - bitcnt);
+  uint32_t sum = adler ();
+  for (int k = 3; k >= 0; k--)
+    data.push_back ((unsigned char) (sum >> (8 * k)));
+  writeChunk ("IDAT", data.data (), data.size ());
+  data.clear ();
+  writeChunk ("IEND", NULL, 0);
+  bool ok = (bool) out && rows_written == ih;
+  out.close ();
+  return ok;
+}
+
+
+bool PngWriter::save (const std::string &name, int width, int height,
+                      const std::vector<uint32_t> &palette,
+                      const std::function<void (int, unsigned char *)> &rows)
+{
+  // Compresses bands in parallel, each ending on a byte boundary
+  int nb = (height + BAND_ROWS - 1) / BAND_ROWS;
+  std::vector<std::vector<unsigned char> > codes (nb);
+  std::vector<uint32_t> sums (nb, 1);
+  ASParallel::forTasks (nb, 0, [&] (int k) {
+    PngWriter enc;
+    enc.iw = width;
+    enc.putBits (2, 3);
+    std::vector<unsigned char> pix (width);
+    int stop = ((k + 1) * BAND_ROWS < height ? (k + 1) * BAND_ROWS : height);
+    for (int j = k * BAND_ROWS; j < stop; j++)
+    {
+      rows (j, pix.data ());
+      enc.deflateRow (pix.data ());
+    }
+    enc.alignBlock ();
+    codes[k].swap (enc.data);
+    sums[k] = enc.adler ();
+  });
+
+  // Concatenates bands between zlib header and an empty final block
+  PngWriter w;
+  w.out.open (name.c_str (), std::ios::out | std::ios::binary);
+  if (! w.out) return false;
+  w.iw = width;
+  w.ih = height;
+  w.writeHeader (palette);
+  w.data.push_back (0x78);
+  w.data.push_back (0x01);
+  uint32_t sum = 1;
+  for (int k = 0; k < nb; k++)
+  {
+    w.data.insert (w.data.end (), codes[k].begin (), codes[k].end ());
+    std::vector<unsigned char> ().swap (codes[k]);
+    if ((int) w.data.size () >= CHUNK_SIZE)
+    {
+      w.writeChunk ("IDAT", w.data.data (), w.data.size ());
+      w.data.clear ();
+    }
+    int brows = ((k + 1) * BAND_ROWS < height ? BAND_ROWS
+                                                : height - k * BAND_ROWS);
+    sum = adlerCombine (sum, sums[k], (int64_t) brows * (width + 1));
+  }
+  w.putBits (3, 3);
+  w.putCode (0, 7);
+  if (w.bitcnt != 0) w.putBits (0, 8 - w.bitcnt);
+  for (int k = 3; k >= 0; k--)
+    w.data.push_back ((unsigned char) (sum >> (8 * k)));
+  w.writeChunk ("IDAT", w.data.data (), w.data.size ());
+  w.writeChunk ("IEND", NULL, 0);
+  bool ok = (bool) w.out;
+  w.out.close ();
+  return ok;
+}
+
+
+void PngWriter::writeHeader (const std::vector<uint32_t> &palette)
+{
+  static const unsigned char sig[8] = {0x89, 'P', 'N', 'G',
+                                       '\r', '\n', 0x1a, '\n'};
+  out.write ((const char *) sig, 8);
+  unsigned char hdr[13] = {
+    (unsigned char) (iw >> 24), (unsigned char) (iw >> 16),
+    (unsigned char) (iw >> 8), (unsigned char) iw,
+    (unsigned char) (ih >> 24), (unsigned char) (ih >> 16),
+    (unsigned char) (ih >> 8), (unsigned char) ih,
+    8, (unsigned char) (palette.empty () ? 0 : 3), 0, 0, 0};
+  writeChunk ("IHDR", hdr, 13);
+  if (! palette.empty ())
+  {
+    std::vector<unsigned char> pal;
+    std::vector<uint32_t>::const_iterator it = palette.begin ();
+    while (it != palette.end ())
+    {
+      pal.push_back ((unsigned char) (*it >> 16));
+      pal.push_back ((unsigned char) (*it >> 8));
+      pal.push_back ((unsigned char) *it++);
+    }
+    writeChunk ("PLTE", pal.data (), pal.size ());
+  }
+}
+
+
+void PngWriter::deflateRow (const unsigned char *pix)
+{
+  deflateByte (0);
+  for (int i = 0; i < iw; i++) deflateByte (pix[i]);
+}
+
+
+void PngWriter::alignBlock ()
+{
+  flushRun ();
+  putCode (0, 7);
+  putBits (0, 3);
+  if (bitcnt != 0) putBits (0, 8 - bitcnt);
+  data.push_back (0x00);
+  data.push_back (0x00);
+  data.push_back (0xff);
+  data.push_back (0xff);
+}
+
+
+uint32_t PngWriter::adler () const
+{
+  return (((adler_b % 65521) << 16) | (adler_a % 65521));
+}
+
+
+uint32_t PngWriter::adlerCombine (uint32_t adler1, uint32_t adler2,
+                                  int64_t len2)
+{
+  uint32_t rem = (uint32_t) (len2 % 65521);
+  uint32_t a1 = adler1 & 0xffff, b1 = adler1 >> 16;
+  uint32_t a2 = adler2 & 0xffff, b2 = adler2 >> 16;
+  uint32_t a = (a1 + a2 + 65520) % 65521;
+  uint32_t b = (uint32_t) (((uint64_t) rem * a1 + b1 + b2
+                            + 65521 - rem) % 65521);
+  return ((b << 16) | a);
+}
+
+
+void PngWriter::writeChunk (const char *type, const unsigned char *buf,
+                            size_t len)
+{
+  unsigned char head[8] = {
+    (unsigned char) (len >> 24), (unsigned char) (len >> 16),
+    (unsigned char) (len >> 8), (unsigned char) len,
+    (unsigned char) type[0], (unsigned char) type[1],
+    (unsigned char) type[2], (unsigned char) type[3]};
+  out.write ((const char *) head, 8);
+  if (len != 0) out.write ((const char *) buf, len);
+  uint32_t crc = crc32 (0, head + 4, 4);
+  if (len != 0) crc = crc32 (crc, buf, len);
+  unsigned char tail[4] = {
+    (unsigned char) (crc >> 24), (unsigned char) (crc >> 16),
+    (unsigned char) (crc >> 8), (unsigned char) crc};
+  out.write ((const char *) tail, 4);
+}
+
+
+void PngWriter::putBits (uint32_t val, int n)
+{
+  bitbuf |= val << bitcnt;
+  bitcnt += n;
+  while (bitcnt >= 8)
+  {
+    data.push_back ((unsigned char) bitbuf);
+    bitbuf >>= 8;
+    bitcnt -= 8;
+  }
+  if (out.is_open () && (int) data.size () >= CHUNK_SIZE)
+  {
+    writeChunk ("IDAT", data.data (), data.size ());
+    data.clear ();
+  }
+}
+
+
+void PngWriter::putCode (uint32_t code, int n)
+{
+  uint32_t rev = 0;
+  for (int k = 0; k < n; k++) rev |= ((code >> k) & 1) << (n - 1 - k);
+  putBits (rev, n);
+}
+
+
+void PngWriter::putLiteral (int b)
+{
+  if (b < 144) putCode (0x30 + b, 8);
+  else putCode (0x190 + b - 144, 9);
+}
+
+
+void PngWriter::deflateByte (int b)
+{
+  adler_a += b;
+  adler_b += adler_a;
+  if (++adler_n == ADLER_SPAN)
+  {
+    adler_a %= 65521;
+    adler_b %= 65521;
+    adler_n = 0;
+  }
+  if (b == last)
+  {
+    if (++run == MAX_RUN) flushRun ();
+  }
+  else
+  {
+    flushRun ();
+    putLiteral (b);
+    last = b;
+  }
+}
+
+
+void PngWriter::flushRun ()
+{
+  if (run >= MIN_RUN)
+  {
+    // Match at distance 1 (distance code 0 has no extra bit)
+    int sym = 28;
+    while (LENGTH_BASE[sym] > run) sym --;
+    if (sym < 23) putCode (sym + 1, 7);
+    else putCode (0xc0 + sym - 23, 8);
+    putBits (run - LENGTH_BASE[sym], LENGTH_EXTRA[sym]);
+    putCode (0, 5);
+  }
+  else while (run > 0)
+  {
+    putLiteral (last);
+    run --;
+  }
+  run = 0;
+}
+
+
+std::vector<uint32_t> PngWriter::crcTable ()
+{
+  std::vector<uint32_t> table (256);
+  for (uint32_t n = 0; n < 256; n++)
+  {
+    uint32_t c = n;
+    for (int k = 0; k < 8; k++)
+      c = (c & 1 ? 0xedb88320 ^ (c >> 1) : c >> 1);
+    table[n] = c;
+  }
+  return table;
+}
+
+
+uint32_t PngWriter::crc32 (uint32_t crc, const unsigned char *buf,
+                           size_t len)
+{
+  static const std::vector<uint32_t> table = crcTable ();
+  crc = ~crc;
+  for (size_t k = 0; k < len; k++)
+    crc = table[(crc ^ buf[k]) & 0xff] ^ (crc >> 8);
+  return ~crc;
+}
@@ -0,0 +1,217 @@
+/*  Copyright 2021 Philippe Even and Phuc Ngo,
+      authors of paper:
+      Even, P., and Ngo, P., 2021,
+      Automatic forest road extraction fromLiDAR data of mountainous areas.
+      In the First International Joint Conference of Discrete Geometry
+      and Mathematical Morphology (Springer LNCS 12708), pp. 93-106.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef PNG_WRITER_H
+#define PNG_WRITER_H
+
+#include <string>
+#include <fstream>
+#include <vector>
+#include <functional>
+#include <inttypes.h>
+
+
+/** 
+ * @class PngWriter pngwriter.h
+ * \brief Row by row PNG file writer without any GUI library.
+ * Writes 8 bit grey level or indexed color images.
+ * Data are compressed with fixed Huffman codes and runs of identical
+ *   bytes, which suits well maps with few colors and large uniform areas.
+ * Whole images can also be compressed by bands of rows in parallel.
+ */
+class PngWriter
+{
+public:
+
+  /**
+   * \brief Creates a PNG writer.
+   */
+  PngWriter ();
+
+  /**
+   * \brief Deletes the PNG writer.
+   */
+  ~PngWriter ();
+
+  /**
+   * \brief Opens a PNG file and writes its header.
+   * Returns false if the file can not be created.
+   * @param name Image file name.
+   * @param width Image width.
+   * @param height Image height.
+   * @param palette 0xRRGGBB colors, or grey level image if empty.
+   */
+  bool open (const std::string &name, int width, int height,
+             const std::vector<uint32_t> &palette);
+
+  /**
+   * \brief Writes next image row.
+   * Returns false on write error.
+   * @param pix Array of image width grey levels or palette indices.
+   */
+  bool writeRow (const unsigned char *pix);
+
+  /**
+   * \brief Terminates and closes the PNG file.
+   * Returns false on write error.
+   */
+  bool close ();
+
+  /**
+   * \brief Saves a whole image, compressing bands of rows in parallel.
+   * Each band is coded as independent deflate blocks.
+   * Returns false if the file can not be written.
+   * @param name Image file name.
+   * @param width Image width.
+   * @param height Image height.
+   * @param palette 0xRRGGBB colors, or grey level image if empty.
+   * @param rows Function filling the pixels of a row from its index,
+   *   called concurrently for distinct rows.
+   */
+  static bool save (const std::string &name, int width, int height,
+                    const std::vector<uint32_t> &palette,
+                    const std::function<void (int, unsigned char *)> &rows);
+
+
+private:
+
+  /** Image data chunk size. */
+  static const int CHUNK_SIZE;
+  /** Minimal length of a run of identical bytes to code as a match. */
+  static const int MIN_RUN;
+  /** Maximal length of a match. */
+  static const int MAX_RUN;
+  /** Count of bytes summed before reducing Adler-32 sums. */
+  static const int ADLER_SPAN;
+  /** Count of rows of the bands compressed in parallel. */
+  static const int BAND_ROWS;
+
+  /** Image file. */
+  std::ofstream out;
+  /** Image width. */
+  int iw;
+  /** Image height. */
+  int ih;
+  /** Count of rows already written. */
+  int rows_written;
+  /** Pending compressed data. */
+  std::vector<unsigned char> data;
+  /** Bit output buffer. */
+  uint32_t bitbuf;
+  /** Count of bits in bit output buffer. */
+  int bitcnt;
+  /** Last output byte. */
+  int last;
+  /** Count of pending repetitions of last byte. */
+  int run;
+  /** Adler-32 checksum of uncompressed data (low part). */
+  uint32_t adler_a;
+  /** Adler-32 checksum of uncompressed data (high part). */
+  uint32_t adler_b;
+  /** Count of bytes summed since last reduction of Adler-32 sums. */
+  int adler_n;
+
+
+  /**
+   * \brief Writes the PNG signature and header chunks.
+   * @param palette 0xRRGGBB colors, or grey level image if empty.
+   */
+  void writeHeader (const std::vector<uint32_t> &palette);
+
+  /**
+   * \brief Compresses a row, with its filter type byte.
+   * @param pix Array of image width grey levels or palette indices.
+   */
+  void deflateRow (const unsigned char *pix);
+
+  /**
+   * \brief Terminates the compressed data on a byte boundary.
+   * The current block is closed and followed by an empty stored block.
+   */
+  void alignBlock ();
+
+  /**
+   * \brief Returns the Adler-32 checksum of uncompressed data.
+   */
+  uint32_t adler () const;
+
+  /**
+   * \brief Returns the Adler-32 checksum of two concatenated sequences.
+   * @param adler1 Checksum of the first sequence.
+   * @param adler2 Checksum of the second sequence.
+   * @param len2 Length of the second sequence.
+   */
+  static uint32_t adlerCombine (uint32_t adler1, uint32_t adler2,
+                                int64_t len2);
+
+  /**
+   * \brief Writes a chunk to the file.
+   * @param type Chunk type.
+   * @param buf Chunk data.
+   * @param len Chunk data length.
+   */
+  void writeChunk (const char *type, const unsigned char *buf, size_t len);
+
+  /**
+   * \brief Appends bits to the compressed data.
+   * @param val Bits, first one as lowest.
+   * @param n Count of bits.
+   */
+  void putBits (uint32_t val, int n);
+
+  /**
+   * \brief Appends a Huffman code to the compressed data.
+   * @param code Code, first bit as highest.
+   * @param n Code length.
+   */
+  void putCode (uint32_t code, int n);
+
+  /**
+   * \brief Appends a literal byte to the compressed data.
+   * @param b Byte value.
+   */
+  void putLiteral (int b);
+
+  /**
+   * \brief Compresses an uncompressed byte.
+   * @param b Byte value.
+   */
+  void deflateByte (int b);
+
+  /**
+   * \brief Outputs pending repetitions of last byte.
+   */
+  void flushRun ();
+
+  /**
+   * \brief Returns the CRC-32 of chunk data.
+   * @param crc Previous CRC value.
+   * @param buf Data.
+   * @param len Data length.
+   */
+  static uint32_t crc32 (uint32_t crc, const unsigned char *buf, size_t len);
+
+  /**
+   * \brief Returns the CRC-32 table of byte remainders.
+   */
+  static std::vector<uint32_t> crcTable ();
+};
+#endif
@@ -0,0 +1,148 @@
+/*  Copyright 2021 Philippe Even and Phuc Ngo,
+      authors of paper:
+      Even, P., and Ngo, P., 2021,
+      Automatic forest road extraction fromLiDAR data of mountainous areas.
+      In the First International Joint Conference of Discrete Geometry
+      and Mathematical Morphology (Springer LNCS 12708), pp. 93-106.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <cmath>
+#include "spanmask.h"
+
+
+SpanMask::SpanMask ()
+{
+  mw = 0;
+  mh = 0;
+}
+
+
+void SpanMask::resize (int w, int h)
+{
+  mw = (w < 0 ? 0 : w);
+  mh = (h < 0 ? 0 : h);
+  spans.assign (mh, std::vector<int> ());
+}
+
+
+void SpanMask::clear ()
+{
+  std::vector<std::vector<int> >::iterator it = spans.begin ();
+  while (it != spans.end ()) (it++)->clear ();
+}
+
+
+bool SpanMask::empty () const
+{
+  std::vector<std::vector<int> >::const_iterator it = spans.begin ();
+  while (it != spans.end ()) if (! (it++)->empty ()) return false;
+  return true;
+}
+
+
+void SpanMask::addSpan (int j, int imin, int imax)
+{
+  if (j < 0 || j >= mh) return;
+  if (imin < 0) imin = 0;
+  if (imax > mw) imax = mw;
+  if (imin >= imax) return;
+  std::vector<int> &r = spans[j];
+
+  // First and last spans touching the new one
+  int k0 = 0, nb = (int) r.size ();
+  while (k0 < nb && r[k0 + 1] < imin) k0 += 2;
+  int k1 = k0;
+  while (k1 < nb && r[k1] <= imax) k1 += 2;
+  if (k1 != k0)
+  {
+    if (r[k0] < imin) imin = r[k0];
+    if (r[k1 - 1] > imax) imax = r[k1 - 1];
+    r.erase (r.begin () + k0, r.begin () + k1);
+  }
+  int bounds[2] = {imin, imax};
+  r.insert (r.begin () + k0, bounds, bounds + 2);
+}
+
+
+void SpanMask::addRect (int imin, int jmin, int imax, int jmax)
+{
+  if (jmin < 0) jmin = 0;
+  if (jmax > mh) jmax = mh;
+  for (int j = jmin; j < jmax; j++) addSpan (j, imin, imax);
+}
+
+
+void SpanMask::addPolygon (const std::vector<Pt2i> &pts)
+{
+  int nb = (int) pts.size ();
+  if (nb < 3) return;
+  int ymin = pts[0].y (), ymax = pts[0].y ();
+  for (int k = 1; k < nb; k++)
+  {
+    if (pts[k].y () < ymin) ymin = pts[k].y ();
+    else if (pts[k].y () > ymax) ymax = pts[k].y ();
+  }
+  if (ymin < 0) ymin = 0;
+  if (ymax > mh) ymax = mh;
+
+  // Scan lines through pixel centers
+  std::vector<double> cross;
+  for (int j = ymin; j < ymax; j++)
+  {
+    double yc = j + 0.5;
+    cross.clear ();
+    for (int k = 0; k < nb; k++)
+    {
+      const Pt2i &a = pts[k];
+      const Pt2i &b = pts[k + 1 < nb ? k + 1 : 0];
+      if ((a.y () <= yc) != (b.y () <= yc))
+        cross.push_back (a.x () + (yc - a.y ()) * (b.x () - a.x ())
+                                  / (double) (b.y () - a.y ()));
+    }
+    std::sort (cross.begin (), cross.end ());
+    for (int k = 0; k + 1 < (int) cross.size (); k += 2)
+      addSpan (j, (int) ceil (cross[k] - 0.5),
+                  (int) ceil (cross[k + 1] - 0.5));
+  }
+}
+
+
+int64_t SpanMask::count () const
+{
+  int64_t nb = 0;
+  std::vector<std::vector<int> >::const_iterator it = spans.begin ();
+  while (it != spans.end ())
+  {
+    for (int k = 0; k < (int) it->size (); k += 2)
+      nb += (*it)[k + 1] - (*it)[k];
+    it ++;
+  }
+  return nb;
+}
+
+
+void SpanMask::fill (BitMask &mask, int top) const
+{
+  mask.clear ();
+  for (int j = 0; j < mask.height (); j++)
+  {
+    if (top + j < 0 || top + j >= mh) continue;
+    const std::vector<int> &r = spans[top + j];
+    for (int k = 0; k < (int) r.size (); k += 2)
+      mask.setSpan (j, r[k], r[k + 1]);
+  }
+}
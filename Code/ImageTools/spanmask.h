@@ -0,0 +1,130 @@
+/*  Copyright 2021 Philippe Even and Phuc Ngo,
+      authors of paper:
+      Even, P., and Ngo, P., 2021,
+      Automatic forest road extraction fromLiDAR data of mountainous areas.
+      In the First International Joint Conference of Discrete Geometry
+      and Mathematical Morphology (Springer LNCS 12708), pp. 93-106.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef SPAN_MASK_H
+#define SPAN_MASK_H
+
+#include <vector>
+#include <inttypes.h>
+#include "pt2i.h"
+#include "bitmask.h"
+
+
+/** 
+ * @class SpanMask spanmask.h
+ * \brief Binary mask stored as sorted lists of disjoint spans per row.
+ * Large regions are stored at no per pixel cost.
+ * Spans are half-open [start, end) column intervals.
+ */
+class SpanMask
+{
+public:
+
+  /**
+   * \brief Creates an empty span mask.
+   */
+  SpanMask ();
+
+  /**
+   * \brief Changes the mask size and clears all spans.
+   * @param w New mask width.
+   * @param h New mask height.
+   */
+  void resize (int w, int h);
+
+  /**
+   * \brief Clears all spans.
+   */
+  void clear ();
+
+  /**
+   * \brief Returns the mask width.
+   */
+  inline int width () const { return mw; }
+
+  /**
+   * \brief Returns the mask height.
+   */
+  inline int height () const { return mh; }
+
+  /**
+   * \brief Returns the spans of a row as (start, end) successive values.
+   * @param j Row index.
+   */
+  inline const std::vector<int> &row (int j) const { return spans[j]; }
+
+  /**
+   * \brief Returns whether the mask has no span.
+   */
+  bool empty () const;
+
+  /**
+   * \brief Adds a span on a row, merging it with overlapping spans.
+   * The span is clipped to the mask width.
+   * @param j Row index.
+   * @param imin Span first column.
+   * @param imax Column following the span.
+   */
+  void addSpan (int j, int imin, int imax);
+
+  /**
+   * \brief Adds a rectangle.
+   * @param imin Left column.
+   * @param jmin Top row.
+   * @param imax Column following the right side.
+   * @param jmax Row following the bottom side.
+   */
+  void addRect (int imin, int jmin, int imax, int jmax);
+
+  /**
+   * \brief Adds a polygon.
+   * Pixels with their center inside the polygon (even-odd rule) are set,
+   *   so that a polygon on rectangle corners covers the same pixels
+   *   as the rectangle.
+   * @param pts Polygon vertices (in pixel coordinates).
+   */
+  void addPolygon (const std::vector<Pt2i> &pts);
+
+  /**
+   * \brief Returns the count of pixels in the mask.
+   */
+  int64_t count () const;
+
+  /**
+   * \brief Sets the mask pixels in a bit mask.
+   * The bit mask may cover a horizontal strip of the span mask.
+   * @param mask Bit mask to fill in.
+   * @param top Row of the span mask matching the bit mask first row.
+   */
+  void fill (BitMask &mask, int top = 0) const;
+
+
+private:
+
+  /** Mask width. */
+  int mw;
+  /** Mask height. */
+  int mh;
+  /** Sorted span bounds, row by row. */
+  std::vector<std::vector<int> > spans;
+
+};
+#endif
@@ -0,0 +1,65 @@
+/*  Copyright 2021 Philippe Even and Phuc Ngo,
+      authors of paper:
+      Even, P., and Ngo, P., 2021,
+      Automatic forest road extraction fromLiDAR data of mountainous areas.
+      In the First International Joint Conference of Discrete Geometry
+      and Mathematical Morphology (Springer LNCS 12708), pp. 93-106.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef VARINT_H
+#define VARINT_H
+
+#include <vector>
+#include <inttypes.h>
+
+
+/**
+ * \brief Appends a variable length unsigned integer to a byte array.
+ * @param out Byte array.
+ * @param val Value to append.
+ */
+inline void putVarint (std::vector<unsigned char> &out, uint32_t val)
+{
+  while (val >= 0x80)
+  {
+    out.push_back ((unsigned char) (val | 0x80));
+    val >>= 7;
+  }
+  out.push_back ((unsigned char) val);
+}
+
+/**
+ * \brief Reads a variable length unsigned integer.
+ * Returns false if the byte array is truncated.
+ * @param in Current position in the byte array, moved past the value.
+ * @param end End of the byte array.
+ * @param val Read value.
+ */
+inline bool getVarint (const unsigned char *&in, const unsigned char *end,
+                       uint32_t &val)
+{
+  val = 0;
+  for (int shift = 0; in != end && shift < 35; shift += 7)
+  {
+    unsigned char b = *in++;
+    val |= ((uint32_t) (b & 0x7f)) << shift;
+    if ((b & 0x80) == 0) return true;
+  }
+  return false;
+}
+
+#endif
@@ -21,6 +21,7 @@
 
 #include <iostream>
 #include <fstream>
+#include <cstdlib>
 #include <inttypes.h>
 #include "asarea.h"
 
@@ -57,6 +58,12 @@ void ASArea::addCorner (int x, int y)
 }
 
 
+void ASArea::addPolygon (const std::vector<Pt2i> &pts)
+{
+  if (pts.size () >= 3) polygons.push_back (pts);
+}
+
+
 void ASArea::save (int64_t xref, int64_t yref, int64_t tomm) const
 {
   save ("tracks/area.txt", xref, yref, tomm);
@@ -66,7 +73,7 @@ void ASArea::save (int64_t xref, int64_t yref, int64_t tomm) const
 void ASArea::save (std::string name,
                    int64_t xref, int64_t yref, int64_t tomm) const
 {
-  if (! corners.empty ())
+  if (! (corners.empty () && polygons.empty ()))
   {
     std::ofstream outf (name, std::ios::out);
     std::vector<Pt2i>::const_iterator it = corners.begin ();
@@ -79,6 +86,15 @@ void ASArea::save (std::string name,
            << yref + (it->y () * tomm) << std::endl;
       it ++;
     }
+    std::vector<std::vector<Pt2i> >::const_iterator pit = polygons.begin ();
+    while (pit != polygons.end ())
+    {
+      outf << "P " << pit->size () << std::endl;
+      for (it = pit->begin (); it != pit->end (); it++)
+        outf << xref + (it->x () * tomm) << " "
+             << yref + (it->y () * tomm) << std::endl;
+      pit ++;
+    }
     outf.close ();
   }
 }
@@ -91,9 +107,23 @@ bool ASArea::load (std::string name, int64_t xref, int64_t yref, int64_t tomm)
 
   int64_t x, y;
   Pt2i c1;
-  input >> x;
+  std::string tok;
+  input >> tok;
   while (! input.eof ())
   {
+    if (tok == "P")
+    {
+      int nb = 0;
+      input >> nb;
+      std::vector<Pt2i> pts;
+      for (int i = 0; i < nb && input >> x >> y; i++)
+        pts.push_back (Pt2i ((int) ((x - xref) / tomm),
+                             (int) ((y - yref) / tomm)));
+      addPolygon (pts);
+      input >> tok;
+      continue;
+    }
+    x = (int64_t) atoll (tok.c_str ());
     input >> y;
     if (start_p)
     {
@@ -103,7 +133,7 @@ bool ASArea::load (std::string name, int64_t xref, int64_t yref, int64_t tomm)
     }
     else c1.set ((int) ((x - xref) / tomm), (int) ((y - yref) / tomm));
     start_p = ! start_p;
-    input >> x;
+    input >> tok;
   }
   input.close ();
   start_p = false;
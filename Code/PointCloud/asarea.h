@@ -27,7 +27,9 @@
 
 /** 
  * @class ASArea asarea.h
- * \brief Area composed of rectangles.
+ * \brief Area composed of rectangles and polygons.
+ * In area files, rectangles are given by two corner lines "x y",
+ *   and polygons by a "P n" line followed by n vertex lines "x y".
  */
 class ASArea
 {
@@ -49,6 +51,12 @@ public:
    */
   inline const std::vector<Pt2i> *getCorners () const { return &corners; }
 
+  /**
+   * \brief Returns the area polygons.
+   */
+  inline const std::vector<std::vector<Pt2i> > *getPolygons () const {
+    return &polygons; }
+
   /**
    * \brief Returns whether a first corner is defined.
    */
@@ -71,6 +79,12 @@ public:
    */
   void addCorner (int x, int y);
 
+  /**
+   * \brief Adds a polygon.
+   * @param pts Polygon vertices.
+   */
+  void addPolygon (const std::vector<Pt2i> &pts);
+
   /**
    * \brief Saves the area in default file.
    * @param xref Leftmost coordinate (in millimeters).
@@ -102,6 +116,8 @@ private:
 
   /** Sequence of rectangle corners (xmin, ymin), (xmax, ymax). */
   std::vector<Pt2i> corners;
+  /** Sequence of polygons. */
+  std::vector<std::vector<Pt2i> > polygons;
   /** Selection status (first corner selected or not). */
   bool start_p;
   /** First corner X coordinate. */
@@ -0,0 +1,100 @@
+/*  Copyright 2021 Philippe Even and Phuc Ngo,
+      authors of paper:
+      Even, P., and Ngo, P., 2021,
+      Automatic forest road extraction fromLiDAR data of mountainous areas.
+      In the First International Joint Conference of Discrete Geometry
+      and Mathematical Morphology (Springer LNCS 12708), pp. 93-106.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef AS_PARALLEL_H
+#define AS_PARALLEL_H
+
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <functional>
+#include <inttypes.h>
+
+
+/** 
+ * @class ASParallel asparallel.h
+ * \brief Light tools to share array processing between hardware threads.
+ */
+class ASParallel
+{
+public:
+
+  /**
+   * \brief Returns the count of available hardware threads.
+   */
+  static inline int threadCount () {
+    unsigned int n = std::thread::hardware_concurrency ();
+    return (n == 0 ? 1 : (int) n); }
+
+  /**
+   * \brief Splits an index range in contiguous bands processed in parallel.
+   * The job is called once per band with the band bounds [start, stop).
+   * The calling thread processes the first band.
+   * @param n Size of the index range.
+   * @param minband Minimal band size.
+   * @param job Band processing function.
+   */
+  static void forBands (int n, int minband,
+                        const std::function<void (int, int)> &job)
+  {
+    int nt = threadCount ();
+    if (minband < 1) minband = 1;
+    if (nt > n / minband) nt = n / minband;
+    if (nt <= 1)
+    {
+      if (n > 0) job (0, n);
+      return;
+    }
+    std::vector<std::thread> workers;
+    for (int t = 1; t < nt; t++)
+      workers.push_back (std::thread (job, (int) (((int64_t) n * t) / nt),
+                                      (int) (((int64_t) n * (t + 1)) / nt)));
+    job (0, n / nt);
+    for (std::vector<std::thread>::iterator it = workers.begin ();
+         it != workers.end (); it++) it->join ();
+  }
+
+  /**
+   * \brief Processes independent tasks on a bounded count of threads.
+   * Each thread picks the next unprocessed task until none remains,
+   *   so that tasks of unequal durations are balanced.
+   * The calling thread also processes tasks.
+   * @param n Count of tasks.
+   * @param nthreads Maximal count of threads (hardware count if 0).
+   * @param task Task processing function, called with the task index.
+   */
+  static void forTasks (int n, int nthreads,
+                        const std::function<void (int)> &task)
+  {
+    int nt = (nthreads <= 0 ? threadCount () : nthreads);
+    if (nt > n) nt = n;
+    std::atomic<int> next (0);
+    std::function<void ()> worker = [&next, n, &task] () {
+      for (int k = next++; k < n; k = next++) task (k); };
+    std::vector<std::thread> workers;
+    for (int t = 1; t < nt; t++) workers.push_back (std::thread (worker));
+    worker ();
+    for (std::vector<std::thread>::iterator it = workers.begin ();
+         it != workers.end (); it++) it->join ();
+  }
+};
+
+#endif
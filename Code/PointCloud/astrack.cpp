@@ -135,6 +135,12 @@ void ASTrack::unselect ()
 }
 
 
+void ASTrack::activate (int num)
+{
+  cur = (num >= 0 && num < (int) pts.size () ? num : -1);
+}
+
+
 bool ASTrack::selectPoint (int x, int y)
 {
   int num = 0;
@@ -176,6 +182,14 @@ std::vector<Pt2i> ASTrack::points ()
 }
 
 
+void ASTrack::movePoints (const std::vector<Pt2i> &newpts)
+{
+  if (newpts.size () == pts.size ())
+    for (int i = 0; i < (int) pts.size (); i++)
+      pts[i].set (newpts[i].x (), newpts[i].y ());
+}
+
+
 std::vector<Pt2i> ASTrack::cutPoints ()
 {
   return cuts;
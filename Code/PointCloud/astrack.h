@@ -72,6 +72,12 @@ public:
    */
   void unselect ();
 
+  /**
+   * \brief Activates a track point.
+   * @param num Point index, or -1 to unselect.
+   */
+  void activate (int num);
+
   /**
    * \brief Selects a point to activate.
    * Returns whether a point was activated.
@@ -91,6 +97,13 @@ public:
    */
   std::vector<Pt2i> points ();
 
+  /**
+   * \brief Moves all the points of the track.
+   * Nothing is done if the count of points differs.
+   * @param newpts New positions of the track points.
+   */
+  void movePoints (const std::vector<Pt2i> &newpts);
+
   /**
    * \brief Returns the cut points of the track.
    */
@@ -106,6 +119,12 @@ public:
    */
   bool isActive () const;
 
+  /**
+   * \brief Returns the active point index, or -1 if none.
+   * In cut edition mode, the index refers to the cut points.
+   */
+  inline int activeIndex () const { return (cut_mode ? ccur : cur); }
+
   /**
    * \brief Returns whether cuts edition mode is on.
    */
@@ -0,0 +1,168 @@
+/*  Copyright 2021 Philippe Even and Phuc Ngo,
+      authors of paper:
+      Even, P., and Ngo, P., 2021,
+      Automatic forest road extraction fromLiDAR data of mountainous areas.
+      In the First International Joint Conference of Discrete Geometry
+      and Mathematical Morphology (Springer LNCS 12708), pp. 93-106.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+#include <cmath>
+#include "astrackindex.h"
+
+const int ASTrackIndex::CELL_SIZE = 64;
+
+
+ASTrackIndex::ASTrackIndex ()
+{
+}
+
+
+void ASTrackIndex::clear ()
+{
+  tracks.clear ();
+  cells.clear ();
+}
+
+
+void ASTrackIndex::setTrack (int t, const std::vector<Pt2i> &pts)
+{
+  if (t < 0) return;
+  if (t < (int) tracks.size ()) indexSegments (t, false);
+  else tracks.resize (t + 1);
+  tracks[t] = pts;
+  indexSegments (t, true);
+}
+
+
+bool ASTrackIndex::nearest (int x, int y, int tol,
+                            int &track, int &seg, int &vertex) const
+{
+  double best = (double) tol * tol;
+  track = -1;
+  for (int cy = cellOf (y - tol); cy <= cellOf (y + tol); cy++)
+    for (int cx = cellOf (x - tol); cx <= cellOf (x + tol); cx++)
+    {
+      std::unordered_map<int64_t, std::vector<Entry> >::const_iterator cit
+        = cells.find (cellKey (cx, cy));
+      if (cit == cells.end ()) continue;
+      std::vector<Entry>::const_iterator it = cit->second.begin ();
+      while (it != cit->second.end ())
+      {
+        const std::vector<Pt2i> &pts = tracks[it->track];
+        const Pt2i &a = pts[it->seg];
+        const Pt2i &b = pts[it->seg + 1 < (int) pts.size () ?
+                            it->seg + 1 : it->seg];
+        double d2 = distance2 (x, y, a, b);
+        if (d2 <= best)
+        {
+          best = d2;
+          track = it->track;
+          seg = it->seg;
+        }
+        it ++;
+      }
+    }
+  if (track == -1) return false;
+
+  // Nearest segment end within the tolerance
+  const std::vector<Pt2i> &pts = tracks[track];
+  int nxt = (seg + 1 < (int) pts.size () ? seg + 1 : seg);
+  double da = distance2 (x, y, pts[seg], pts[seg]);
+  double db = distance2 (x, y, pts[nxt], pts[nxt]);
+  vertex = (db < da ? nxt : seg);
+  if ((db < da ? db : da) > (double) tol * tol) vertex = -1;
+  return true;
+}
+
+
+void ASTrackIndex::indexSegments (int t, bool insert)
+{
+  const std::vector<Pt2i> &pts = tracks[t];
+  int nbs = (pts.size () > 1 ? (int) pts.size () - 1 : (int) pts.size ());
+  for (int k = 0; k < nbs; k++)
+  {
+    const Pt2i &a = pts[k];
+    const Pt2i &b = pts[k + 1 < (int) pts.size () ? k + 1 : k];
+
+    // Cells crossed on each row of cells
+    int cy1 = cellOf (a.y () < b.y () ? a.y () : b.y ());
+    int cy2 = cellOf (a.y () < b.y () ? b.y () : a.y ());
+    for (int cy = cy1; cy <= cy2; cy++)
+    {
+      double xa = a.x (), xb = b.x ();
+      if (a.y () != b.y ())
+      {
+        double ylo = cy * CELL_SIZE - 0.5, yhi = (cy + 1) * CELL_SIZE - 0.5;
+        double ta = (ylo - a.y ()) / (b.y () - a.y ());
+        double tb = (yhi - a.y ()) / (b.y () - a.y ());
+        if (ta > tb)
+        {
+          double tmp = ta;
+          ta = tb;
+          tb = tmp;
+        }
+        if (ta < 0.) ta = 0.;
+        if (tb > 1.) tb = 1.;
+        xa = a.x () + ta * (b.x () - a.x ());
+        xb = a.x () + tb * (b.x () - a.x ());
+      }
+      int cx1 = cellOf ((int) floor ((xa < xb ? xa : xb) + 0.5));
+      int cx2 = cellOf ((int) floor ((xa < xb ? xb : xa) + 0.5));
+      for (int cx = cx1; cx <= cx2; cx++)
+      {
+        std::vector<Entry> &cell = cells[cellKey (cx, cy)];
+        if (insert)
+        {
+          Entry e;
+          e.track = t;
+          e.seg = k;
+          cell.push_back (e);
+        }
+        else
+        {
+          for (int i = 0; i < (int) cell.size (); i++)
+            if (cell[i].track == t && cell[i].seg == k)
+            {
+              cell[i] = cell.back ();
+              cell.pop_back ();
+              break;
+            }
+          if (cell.empty ()) cells.erase (cellKey (cx, cy));
+        }
+      }
+    }
+  }
+}
+
+
+double ASTrackIndex::distance2 (int x, int y, const Pt2i &a, const Pt2i &b)
+{
+  double ex = b.x () - a.x (), ey = b.y () - a.y ();
+  double px = x - a.x (), py = y - a.y ();
+  double l2 = ex * ex + ey * ey;
+  if (l2 > 0.)
+  {
+    double t = (px * ex + py * ey) / l2;
+    if (t > 1.) t = 1.;
+    if (t > 0.)
+    {
+      px -= t * ex;
+      py -= t * ey;
+    }
+  }
+  return (px * px + py * py);
+}
@@ -0,0 +1,127 @@
+/*  Copyright 2021 Philippe Even and Phuc Ngo,
+      authors of paper:
+      Even, P., and Ngo, P., 2021,
+      Automatic forest road extraction fromLiDAR data of mountainous areas.
+      In the First International Joint Conference of Discrete Geometry
+      and Mathematical Morphology (Springer LNCS 12708), pp. 93-106.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef AS_TRACK_INDEX_H
+#define AS_TRACK_INDEX_H
+
+#include <vector>
+#include <unordered_map>
+#include <inttypes.h>
+#include "pt2i.h"
+
+
+/** 
+ * @class ASTrackIndex astrackindex.h
+ * \brief Uniform grid index of track segments for picking.
+ * Each grid cell lists the segments crossing it, so that picking only
+ *   visits the few cells around the picked point.
+ * Only occupied cells are stored.
+ */
+class ASTrackIndex
+{
+public:
+
+  /**
+   * \brief Creates an empty index.
+   */
+  ASTrackIndex ();
+
+  /**
+   * \brief Removes all tracks.
+   */
+  void clear ();
+
+  /**
+   * \brief Sets or replaces the polyline of a track.
+   * Only the segments of this track are updated.
+   * @param t Track index.
+   * @param pts Track points.
+   */
+  void setTrack (int t, const std::vector<Pt2i> &pts);
+
+  /**
+   * \brief Looks for the track segment nearest to a point.
+   * Returns false if no segment lies within the tolerance.
+   * @param x Point X-coordinate.
+   * @param y Point Y-coordinate.
+   * @param tol Distance tolerance.
+   * @param track Index of the found track.
+   * @param seg Index of the found segment start point.
+   * @param vertex Index of the found segment end nearest to the point,
+   *   or -1 if both ends are beyond the tolerance.
+   */
+  bool nearest (int x, int y, int tol,
+                int &track, int &seg, int &vertex) const;
+
+  /**
+   * \brief Returns the squared distance from a point to a segment.
+   * @param x Point X-coordinate.
+   * @param y Point Y-coordinate.
+   * @param a Segment start.
+   * @param b Segment end.
+   */
+  static double distance2 (int x, int y, const Pt2i &a, const Pt2i &b);
+
+
+private:
+
+  /** Grid cell size (in pixels). */
+  static const int CELL_SIZE;
+
+  /** Indexed segment. */
+  struct Entry
+  {
+    /** Track index. */
+    int track;
+    /** Segment start point index. */
+    int seg;
+  };
+
+  /** Indexed track polylines. */
+  std::vector<std::vector<Pt2i> > tracks;
+  /** Occupied grid cells. */
+  std::unordered_map<int64_t, std::vector<Entry> > cells;
+
+
+  /**
+   * \brief Returns the key of a grid cell.
+   * @param cx Cell column.
+   * @param cy Cell row.
+   */
+  static inline int64_t cellKey (int cx, int cy) {
+    return ((((int64_t) cx) << 32) | (uint32_t) cy); }
+
+  /**
+   * \brief Returns the grid cell coordinate of a pixel coordinate.
+   * @param v Pixel coordinate.
+   */
+  static inline int cellOf (int v) {
+    return (v >= 0 ? v / CELL_SIZE : - ((- v - 1) / CELL_SIZE) - 1); }
+
+  /**
+   * \brief Inserts or removes the segments of a track in crossed cells.
+   * @param t Track index.
+   * @param insert Insertion if true, removal otherwise.
+   */
+  void indexSegments (int t, bool insert);
+};
+#endif
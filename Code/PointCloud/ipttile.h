@@ -266,6 +266,12 @@ public:
    */
   inline int *getCellsArray () { return cells; }
 
+  /**
+   * \brief Returns the point label array (NULL if labels are not set).
+   */
+  inline const unsigned char *getLabelsArray () const {
+    return (labelling ? labels : NULL); }
+
   /**
    * \brief Returns whether poînts are loaded in the tile.
    */
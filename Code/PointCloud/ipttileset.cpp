@@ -26,6 +26,8 @@ const int IPtTileSet::DEFAULT_BUF_SIZE = 3;
 
 const float IPtTileSet::MM2M = 0.001f;
 
+const int IPtTileSet::CORRIDOR_CACHE_SIZE = 16384;
+
 
 IPtTileSet::IPtTileSet (int buffer_size)
 {
@@ -45,6 +47,7 @@ IPtTileSet::IPtTileSet (int buffer_size)
   buf_np = 0;
   buf_ni = 0;
   buf_step = 0;
+  corridor_stamp = 0;
 }
 
 
@@ -74,6 +77,7 @@ void IPtTileSet::clear ()
     tiles = NULL;
   }
   vectiles.clear ();
+  clearCorridorCache ();
 }
 
 
@@ -462,6 +466,73 @@ void IPtTileSet::collectUnsortedPoints (std::vector<Pt3f> &pts,
 }
 
 
+int IPtTileSet::collectCorridor (std::vector<Pt3f> &pts,
+                                 const std::vector<std::vector<Pt2i> > &scans)
+{
+  if (tiles == NULL) return 0;
+  int fetched = 0;
+  int ncols = tcols * twidth, nrows = trows * theight;
+  corridor_stamp ++;
+  for (std::vector<std::vector<Pt2i> >::const_iterator scan = scans.begin ();
+       scan != scans.end (); scan ++)
+  {
+    for (std::vector<Pt2i>::const_iterator it = scan->begin ();
+         it != scan->end (); it ++)
+    {
+      int i = it->x (), j = it->y ();
+      if (i < 0 || i >= ncols || j < 0 || j >= nrows) continue;
+      int64_t key = ((int64_t) j) * ncols + i;
+      std::unordered_map<int64_t, std::pair<int, std::vector<Pt3f> > >
+        ::iterator cell = corridor_cells.find (key);
+      if (cell == corridor_cells.end ())
+      {
+        // Cells of tiles not loaded yet are not cached
+        int itile = i / twidth, jtile = j / theight;
+        IPtTile *tile = tiles[jtile * tcols + itile];
+        if (tile == NULL || tile->unloaded ()) continue;
+        cell = corridor_cells.insert (std::make_pair (key,
+                 std::make_pair (0, std::vector<Pt3f> ()))).first;
+        int icell = i - itile * twidth, jcell = j - jtile * theight;
+        int nbpts = tile->cellSize (icell, jcell);
+        Pt3i *pt = tile->cellStartPt (icell, jcell);
+        for (int k = 0; k < nbpts; k++)
+        {
+          cell->second.second.push_back (
+            Pt3f (((float) (txspread * itile + pt->x ())) * MM2M,
+                  ((float) (tyspread * jtile + pt->y ())) * MM2M,
+                  ((float) pt->z ()) * MM2M));
+          pt ++;
+        }
+        fetched ++;
+      }
+      cell->second.first = corridor_stamp;
+      pts.insert (pts.end (), cell->second.second.begin (),
+                  cell->second.second.end ());
+    }
+  }
+
+  // Cells out of this request released when the cache is full
+  if ((int) corridor_cells.size () > CORRIDOR_CACHE_SIZE)
+  {
+    std::unordered_map<int64_t, std::pair<int, std::vector<Pt3f> > >
+      ::iterator cell = corridor_cells.begin ();
+    while (cell != corridor_cells.end ())
+    {
+      if (cell->second.first != corridor_stamp)
+        cell = corridor_cells.erase (cell);
+      else cell ++;
+    }
+  }
+  return fetched;
+}
+
+
+void IPtTileSet::clearCorridorCache ()
+{
+  corridor_cells.clear ();
+}
+
+
 int IPtTileSet::cellMaxSize () const
 {
   int max = 0;
@@ -22,6 +22,7 @@
 #ifndef IPT_TILE_SET_H
 #define IPT_TILE_SET_H
 
+#include <unordered_map>
 #include "ipttile.h"
 #include "pt3f.h"
 #include "pt2i.h"
@@ -96,6 +97,15 @@ public:
   inline bool isLoaded (int num) const {
     return (tiles != NULL && num < tcols * trows && tiles[num] != NULL); }
 
+  /**
+   * \brief Returns a tile of the set, or NULL if absent.
+   * @param i Tile column.
+   * @param j Tile row.
+   */
+  inline const IPtTile *getTile (int i, int j) const {
+    return ((tiles != NULL && i >= 0 && i < tcols && j >= 0 && j < trows) ?
+            tiles[j * tcols + i] : NULL); }
+
   /**
    * \brief Updates access type of the tiles.
    * @param oldtype Previous access type.
@@ -269,6 +279,26 @@ public:
    */
   void collectUnsortedPoints (std::vector<Pt3f> &pts, int i, int j) const;
 
+  /**
+   * \brief Pushes the points of tile cells crossed by a corridor.
+   *   The corridor is given as a set of scans of tile cells, for instance
+   *   parallel scans obtained with Pt2i::drawOrtho.
+   *   Tile cell coordinates are in tileXSpread / tileWidth units.
+   *   Points are transfered in meter unit.
+   *   Points of fetched cells are kept in a cache, so that overlapping
+   *   corridors of successive requests only fetch new cells.
+   * Returns the count of cells fetched from the tiles.
+   * @param pts Provided vector of points.
+   * @param scans Scans of tile cells.
+   */
+  int collectCorridor (std::vector<Pt3f> &pts,
+                       const std::vector<std::vector<Pt2i> > &scans);
+
+  /**
+   * \brief Releases the cells kept by corridor requests.
+   */
+  void clearCorridorCache ();
+
   /**
    * \brief Returns the count of points in the most populated subcell.
    */
@@ -403,6 +433,8 @@ private:
 
   /** Conversion ratio from millimeters to meters. */
   static const float MM2M;
+  /** Count of cells kept in the corridor cache beyond the last request. */
+  static const int CORRIDOR_CACHE_SIZE;
 
 
   /** X offset. */
@@ -452,6 +484,12 @@ private:
   int *buf_ind;
   /** Current step of tile set traversal. */
   int buf_step;
+
+  /** Cached corridor cells : last request number and points (in meters). */
+  std::unordered_map<int64_t, std::pair<int, std::vector<Pt3f> > >
+    corridor_cells;
+  /** Count of corridor requests. */
+  int corridor_stamp;
 };
 
 #endif
@@ -0,0 +1,72 @@
+/*  Copyright 2021 Philippe Even and Phuc Ngo,
+      authors of paper:
+      Even, P., and Ngo, P., 2021,
+      Automatic forest road extraction fromLiDAR data of mountainous areas.
+      In the First International Joint Conference of Discrete Geometry
+      and Mathematical Morphology (Springer LNCS 12708), pp. 93-106.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "onormal.h"
+
+
+ONormal::ONormal ()
+{
+  up = 0;
+  vp = 0;
+}
+
+
+ONormal::ONormal (const Pt3f &n)
+{
+  set (n.x (), n.y (), n.z ());
+}
+
+
+void ONormal::set (const Pt3f &n)
+{
+  set (n.x (), n.y (), n.z ());
+}
+
+
+void ONormal::set (float x, float y, float z)
+{
+  float l1 = (x < 0.0f ? - x : x) + (y < 0.0f ? - y : y)
+             + (z < 0.0f ? - z : z);
+  if (l1 == 0.0f)
+  {
+    up = 0;
+    vp = 0;
+    return;
+  }
+  float fx = x / l1, fy = y / l1;
+  if (z < 0.0f)
+  {
+    float ox = 1.0f - (fy < 0.0f ? - fy : fy);
+    float oy = 1.0f - (fx < 0.0f ? - fx : fx);
+    fx = (fx < 0.0f ? - ox : ox);
+    fy = (fy < 0.0f ? - oy : oy);
+  }
+  up = (short) (fx * RANGE + (fx < 0.0f ? - 0.5f : 0.5f));
+  vp = (short) (fy * RANGE + (fy < 0.0f ? - 0.5f : 0.5f));
+}
+
+
+Pt3f ONormal::vector () const
+{
+  float x, y, z;
+  get (x, y, z);
+  return (Pt3f (x, y, z));
+}
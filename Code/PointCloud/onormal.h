@@ -0,0 +1,127 @@
+/*  Copyright 2021 Philippe Even and Phuc Ngo,
+      authors of paper:
+      Even, P., and Ngo, P., 2021,
+      Automatic forest road extraction fromLiDAR data of mountainous areas.
+      In the First International Joint Conference of Discrete Geometry
+      and Mathematical Morphology (Springer LNCS 12708), pp. 93-106.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef O_NORMAL_H
+#define O_NORMAL_H
+
+#include <cmath>
+#include "pt3f.h"
+
+
+/** 
+ * @class ONormal onormal.h
+ * \brief Compact unit normal vector.
+ * The vector is projected on the unit octahedron and the two projection
+ *   coordinates are stored on 16 bits integers (octahedral encoding).
+ */
+class ONormal
+{
+public:
+
+  /** Quantization range of the octahedral coordinates. */
+  static const int RANGE = 32767;
+
+
+  /**
+   * \brief Creates a vertical unit normal vector.
+   */
+  ONormal ();
+
+  /**
+   * \brief Creates a compact normal from a unit vector.
+   * @param n Unit vector to encode.
+   */
+  ONormal (const Pt3f &n);
+
+  /**
+   * \brief Deletes the compact normal.
+   */
+  ~ONormal () { }
+
+  /**
+   * \brief Returns the first octahedral coordinate.
+   */
+  inline short u () const { return up; }
+
+  /**
+   * \brief Returns the second octahedral coordinate.
+   */
+  inline short v () const { return vp; }
+
+  /**
+   * \brief Encodes the given unit vector.
+   * @param n Unit vector to encode.
+   */
+  void set (const Pt3f &n);
+
+  /**
+   * \brief Encodes the given unit vector.
+   * @param x Vector X-coordinate.
+   * @param y Vector Y-coordinate.
+   * @param z Vector Z-coordinate.
+   */
+  void set (float x, float y, float z);
+
+  /**
+   * \brief Decodes the unit vector coordinates.
+   * @param x Returned X-coordinate.
+   * @param y Returned Y-coordinate.
+   * @param z Returned Z-coordinate.
+   */
+  inline void get (float &x, float &y, float &z) const {
+    float fx = up * (1.0f / RANGE), fy = vp * (1.0f / RANGE);
+    float fz = 1.0f - (fx < 0.0f ? - fx : fx) - (fy < 0.0f ? - fy : fy);
+    float t = (fz < 0.0f ? - fz : 0.0f);
+    fx += (fx < 0.0f ? t : - t);
+    fy += (fy < 0.0f ? t : - t);
+    float n = 1.0f / std::sqrt (fx * fx + fy * fy + fz * fz);
+    x = fx * n;
+    y = fy * n;
+    z = fz * n; }
+
+  /**
+   * \brief Returns the decoded unit vector.
+   */
+  Pt3f vector () const;
+
+  /**
+   * \brief Returns the squared norm of the vector horizontal component.
+   * This is the squared sine of the slope angle.
+   */
+  inline float slope2 () const {
+    float fx = up * (1.0f / RANGE), fy = vp * (1.0f / RANGE);
+    float fz = 1.0f - (fx < 0.0f ? - fx : fx) - (fy < 0.0f ? - fy : fy);
+    float t = (fz < 0.0f ? - fz : 0.0f);
+    fx += (fx < 0.0f ? t : - t);
+    fy += (fy < 0.0f ? t : - t);
+    float h2 = fx * fx + fy * fy;
+    return (h2 / (h2 + fz * fz)); }
+
+
+private:
+
+  /** First octahedral coordinate. */
+  short up;
+  /** Second octahedral coordinate. */
+  short vp;
+};
+
+#endif
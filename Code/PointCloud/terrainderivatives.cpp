@@ -0,0 +1,422 @@
+/*  Copyright 2021 Philippe Even and Phuc Ngo,
+      authors of paper:
+      Even, P., and Ngo, P., 2021,
+      Automatic forest road extraction fromLiDAR data of mountainous areas.
+      In the First International Joint Conference of Discrete Geometry
+      and Mathematical Morphology (Springer LNCS 12708), pp. 93-106.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <cmath>
+#include <vector>
+#include "terrainderivatives.h"
+#include "asparallel.h"
+#include "asmath.h"
+
+
+const int TerrainDerivatives::SLOPE = 0;
+const int TerrainDerivatives::ASPECT = 1;
+const int TerrainDerivatives::PROFILE_CURVATURE = 2;
+const int TerrainDerivatives::PLAN_CURVATURE = 3;
+const int TerrainDerivatives::OPENNESS = 4;
+const int TerrainDerivatives::LOCAL_RELIEF = 5;
+const int TerrainDerivatives::DEFAULT_OPENNESS_RADIUS = 20;
+const int TerrainDerivatives::DEFAULT_RELIEF_RADIUS = 15;
+
+const float TerrainDerivatives::CURVATURE_RANGE = 0.5f;
+const float TerrainDerivatives::OPENNESS_MIN = 60.0f;
+const float TerrainDerivatives::OPENNESS_MAX = 120.0f;
+const float TerrainDerivatives::RELIEF_RANGE = 1.0f;
+const float TerrainDerivatives::FLAT_GRADIENT2 = 0.000001f;
+const int TerrainDerivatives::RENDER_MIN_BAND = 32;
+
+
+TerrainDerivatives::TerrainDerivatives ()
+{
+  dtm = NULL;
+  for (int k = 0; k < NB_TYPES; k++) rasters[k] = NULL;
+  open_rad = DEFAULT_OPENNESS_RADIUS;
+  relief_rad = DEFAULT_RELIEF_RADIUS;
+}
+
+
+TerrainDerivatives::~TerrainDerivatives ()
+{
+  clear ();
+}
+
+
+void TerrainDerivatives::setMap (const TerrainMap *map)
+{
+  clear ();
+  dtm = map;
+}
+
+
+void TerrainDerivatives::clear ()
+{
+  for (int k = 0; k < NB_TYPES; k++)
+  {
+    if (rasters[k] != NULL) delete [] rasters[k];
+    rasters[k] = NULL;
+  }
+}
+
+
+std::string TerrainDerivatives::name (int type)
+{
+  if (type == SLOPE) return (std::string ("slope"));
+  if (type == ASPECT) return (std::string ("aspect"));
+  if (type == PROFILE_CURVATURE) return (std::string ("profile curvature"));
+  if (type == PLAN_CURVATURE) return (std::string ("plan curvature"));
+  if (type == OPENNESS) return (std::string ("positive openness"));
+  if (type == LOCAL_RELIEF) return (std::string ("local relief"));
+  return (std::string ("unknown"));
+}
+
+
+bool TerrainDerivatives::available (int type) const
+{
+  if (type < 0 || type >= NB_TYPES || dtm == NULL
+      || dtm->normals () == NULL || dtm->tileWidth () == 0) return false;
+  return ((type != OPENNESS && type != LOCAL_RELIEF) || dtm->hasHeights ());
+}
+
+
+void TerrainDerivatives::setOpennessRadius (int val)
+{
+  if (val < 1) val = 1;
+  if (val != open_rad && rasters[OPENNESS] != NULL)
+  {
+    delete [] rasters[OPENNESS];
+    rasters[OPENNESS] = NULL;
+  }
+  open_rad = val;
+}
+
+
+void TerrainDerivatives::setReliefRadius (int val)
+{
+  if (val < 1) val = 1;
+  if (val != relief_rad && rasters[LOCAL_RELIEF] != NULL)
+  {
+    delete [] rasters[LOCAL_RELIEF];
+    rasters[LOCAL_RELIEF] = NULL;
+  }
+  relief_rad = val;
+}
+
+
+const float *TerrainDerivatives::raster (int type)
+{
+  if (! available (type)) return NULL;
+  if (rasters[type] != NULL) return rasters[type];
+
+  int w = dtm->width (), h = dtm->height ();
+  int tw = dtm->tileWidth (), th = dtm->tileHeight ();
+  int cols = w / tw, rows = h / th;
+  float *res = new float[(size_t) w * h];
+  if (type == OPENNESS || type == LOCAL_RELIEF)
+  {
+    // Tile heights are read once, and kept while the tile rows processed
+    //   need them, so that tile halos are sliced from them
+    int rad = (type == OPENNESS ? open_rad : relief_rad);
+    int nr = (rad + th - 1) / th;
+    std::vector<std::vector<float> > tiles (cols * rows);
+    std::vector<char> read (cols * rows, 1);
+    for (int ty = 0; ty < rows; ty++)
+    {
+      if (ty - nr - 1 >= 0)
+        for (int k = (ty - nr - 1) * cols; k < (ty - nr) * cols; k++)
+          std::vector<float> ().swap (tiles[k]);
+      int first = (ty == 0 ? 0 : ty + nr);
+      int last = (ty + nr < rows ? ty + nr : rows - 1);
+      if (first <= last)
+      {
+        ASParallel::forBands ((last + 1 - first) * cols, 1,
+          [&] (int start, int stop)
+          {
+            for (int k = first * cols + start; k < first * cols + stop; k++)
+            {
+              tiles[k].resize (tw * th);
+              if (! dtm->getHeights ((k % cols) * tw, (k / cols) * th,
+                                     tw, th, tiles[k].data ()))
+                read[k] = 0;
+            }
+          });
+        for (int k = first * cols; k < (last + 1) * cols; k++)
+        {
+          if (! read[k])
+          {
+            delete [] res;
+            return NULL;
+          }
+        }
+      }
+      ASParallel::forBands (cols, 1,
+        [&] (int start, int stop)
+        {
+          std::vector<float> hts ((tw + 2 * rad) * (th + 2 * rad));
+          std::vector<double> sums (type == OPENNESS ? 0 :
+                                  2 * (tw + 2 * rad + 1) * (th + 2 * rad + 1));
+          for (int tx = start; tx < stop; tx++)
+            setHeightDerivative (type, tx, ty, tiles, hts.data (),
+                                 sums.data (), res);
+        });
+    }
+  }
+  else
+    ASParallel::forBands (cols * rows, 1,
+      [&] (int start, int stop)
+      {
+        std::vector<float> grad (2 * (tw + 2) * (th + 2));
+        for (int k = start; k < stop; k++)
+          setNormalDerivative (type, k % cols, k / cols, grad.data (), res);
+      });
+  rasters[type] = res;
+  return res;
+}
+
+
+float TerrainDerivatives::value (int type, int i, int j)
+{
+  const float *res = raster (type);
+  return (res == NULL ? NAN : res[(size_t) j * dtm->width () + i]);
+}
+
+
+bool TerrainDerivatives::render (int type, uint32_t *buf, int stride)
+{
+  const float *res = raster (type);
+  if (res == NULL) return false;
+  int w = dtm->width ();
+  ASParallel::forBands (dtm->height (), RENDER_MIN_BAND,
+    [&] (int start, int stop)
+    {
+      for (int j = start; j < stop; j++)
+      {
+        const float *val = res + (size_t) j * w;
+        uint32_t *out = buf + (size_t) j * stride;
+        for (int i = 0; i < w; i++)
+          out[i] = 0xff000000 | ((uint32_t) grey (type, val[i]) * 0x010101);
+      }
+    });
+  return true;
+}
+
+
+void TerrainDerivatives::setNormalDerivative (int type, int tx, int ty,
+                                              float *grad, float *out) const
+{
+  int w = dtm->width (), h = dtm->height ();
+  int tw = dtm->tileWidth (), th = dtm->tileHeight ();
+  int x0 = tx * tw, y0 = ty * th;
+  int bw = tw + 2;
+  const ONormal *nmap = dtm->normals ();
+  float cs = dtm->cellSize ();
+  float gfact = 1.0f / (2 * cs * TerrainMap::reliefAmplification ());
+
+  // Height gradients (eastwards, northwards) of the tile and its halo
+  float *g = grad;
+  for (int bj = 0; bj < th + 2; bj++)
+  {
+    int j = y0 - 1 + bj;
+    if (j < 0) j = 0;
+    else if (j >= h) j = h - 1;
+    for (int bi = 0; bi < bw; bi++)
+    {
+      int i = x0 - 1 + bi;
+      if (i < 0) i = 0;
+      else if (i >= w) i = w - 1;
+      float nx, ny, nz;
+      nmap[(size_t) j * w + i].get (nx, ny, nz);
+      *g++ = - nx / nz * gfact;
+      *g++ = ny / nz * gfact;
+    }
+  }
+
+  for (int j = 0; j < th; j++)
+  {
+    const float *gc = grad + 2 * ((j + 1) * bw + 1);
+    float *res = out + (size_t) (y0 + j) * w + x0;
+    if (type == SLOPE)
+      for (int i = 0; i < tw; i++)
+        res[i] = atanf (sqrtf (gc[2*i] * gc[2*i] + gc[2*i+1] * gc[2*i+1]))
+                 * ASF_RAD2DEG;
+    else if (type == ASPECT)
+      for (int i = 0; i < tw; i++)
+      {
+        if (gc[2*i] == 0.0f && gc[2*i+1] == 0.0f) res[i] = -1.0f;
+        else
+        {
+          res[i] = atan2f (- gc[2*i], - gc[2*i+1]) * ASF_RAD2DEG;
+          if (res[i] < 0.0f) res[i] += 360.0f;
+        }
+      }
+    else
+    {
+      // Neighbours are closer on map borders
+      const float *gn = gc - 2 * bw;
+      const float *gs = gc + 2 * bw;
+      float dy = (y0 + j == 0 || y0 + j == h - 1 ? cs : 2 * cs);
+      for (int i = 0; i < tw; i++)
+      {
+        float dx = (x0 + i == 0 || x0 + i == w - 1 ? cs : 2 * cs);
+        float p = gc[2*i], q = gc[2*i+1];
+        float r = (gc[2*i+2] - gc[2*i-2]) / dx;
+        float t = (gn[2*i+1] - gs[2*i+1]) / dy;
+        float s = ((gn[2*i] - gs[2*i]) / dy + (gc[2*i+3] - gc[2*i-1]) / dx) / 2;
+        float p2 = p * p, q2 = q * q, g2 = p2 + q2;
+        if (g2 < FLAT_GRADIENT2) res[i] = 0.0f;
+        else if (type == PROFILE_CURVATURE)
+          res[i] = - (p2 * r + 2 * p * q * s + q2 * t)
+                   / (g2 * (1 + g2) * sqrtf (1 + g2));
+        else
+          res[i] = - (q2 * r - 2 * p * q * s + p2 * t) / (g2 * sqrtf (g2));
+      }
+    }
+  }
+}
+
+
+void TerrainDerivatives::setHeightDerivative (int type, int tx, int ty,
+                                const std::vector<std::vector<float> > &tiles,
+                                              float *hts, double *sums,
+                                              float *out) const
+{
+  int w = dtm->width (), h = dtm->height ();
+  int tw = dtm->tileWidth (), th = dtm->tileHeight ();
+  int x0 = tx * tw, y0 = ty * th;
+  int rad = (type == OPENNESS ? open_rad : relief_rad);
+  int bw = tw + 2 * rad, bh = th + 2 * rad;
+
+  // Heights of the tile and its halo (NaN outside the map)
+  for (int bj = 0; bj < bh; bj++)
+  {
+    int j = y0 - rad + bj;
+    float *hb = hts + bj * bw;
+    for (int bi = 0; bi < bw; bi++)
+    {
+      int i = x0 - rad + bi;
+      hb[bi] = (i < 0 || i >= w || j < 0 || j >= h ? NAN :
+                tiles[(j / th) * (w / tw) + i / tw][(j % th) * tw + i % tw]);
+    }
+  }
+
+  if (type == OPENNESS)
+  {
+    // Mean of the zenith angles of the highest horizon in eight directions
+    static const int dirs[8][2] = {{1, 0}, {1, 1}, {0, 1}, {-1, 1},
+                                   {-1, 0}, {-1, -1}, {0, -1}, {1, -1}};
+    std::vector<float> idist (2 * (rad + 1));
+    for (int k = 1; k <= rad; k++)
+    {
+      idist[k] = 1.0f / (k * dtm->cellSize ());
+      idist[rad + 1 + k] = idist[k] / ASF_SQRT2;
+    }
+    for (int j = 0; j < th; j++)
+    {
+      float *res = out + (size_t) (y0 + j) * w + x0;
+      for (int i = 0; i < tw; i++)
+      {
+        const float *hc = hts + (j + rad) * bw + i + rad;
+        if (std::isnan (*hc))
+        {
+          res[i] = NAN;
+          continue;
+        }
+        float sum = 0.0f;
+        int nbd = 0;
+        for (int d = 0; d < 8; d++)
+        {
+          int off = dirs[d][1] * bw + dirs[d][0];
+          const float *id = &(idist[d % 2 == 0 ? 0 : rad + 1]);
+          float maxt = 0.0f;
+          int k = 1;
+          while (k <= rad && ! std::isnan (hc[k * off]))
+          {
+            float tn = (hc[k * off] - *hc) * id[k];
+            if (k == 1 || tn > maxt) maxt = tn;
+            k++;
+          }
+          if (k > 1)
+          {
+            sum += 90.0f - atanf (maxt) * ASF_RAD2DEG;
+            nbd ++;
+          }
+        }
+        res[i] = (nbd == 0 ? NAN : sum / nbd);
+      }
+    }
+  }
+  else
+  {
+    // Summed-area tables of valid heights and their count
+    int sw = bw + 1;
+    for (int i = 0; i < 2 * sw; i++) sums[i] = 0.;
+    for (int j = 0; j < bh; j++)
+    {
+      double *s = sums + 2 * (j + 1) * sw;
+      s[0] = 0.;
+      s[1] = 0.;
+      double rsum = 0., rcount = 0.;
+      for (int i = 0; i < bw; i++)
+      {
+        float val = hts[j * bw + i];
+        if (! std::isnan (val))
+        {
+          rsum += val;
+          rcount += 1.;
+        }
+        s[2 * (i + 1)] = s[2 * (i + 1) - 2 * sw] + rsum;
+        s[2 * (i + 1) + 1] = s[2 * (i + 1) + 1 - 2 * sw] + rcount;
+      }
+    }
+    int ws = 2 * rad + 1;
+    for (int j = 0; j < th; j++)
+    {
+      float *res = out + (size_t) (y0 + j) * w + x0;
+      const double *s0 = sums + 2 * j * sw;
+      const double *s1 = sums + 2 * (j + ws) * sw;
+      for (int i = 0; i < tw; i++)
+      {
+        float val = hts[(j + rad) * bw + i + rad];
+        if (std::isnan (val)) res[i] = NAN;
+        else
+        {
+          double sum = s1[2 * (i + ws)] - s1[2 * i] - s0[2 * (i + ws)]
+                       + s0[2 * i];
+          double count = s1[2 * (i + ws) + 1] - s1[2 * i + 1]
+                         - s0[2 * (i + ws) + 1] + s0[2 * i + 1];
+          res[i] = (float) (val - sum / count);
+        }
+      }
+    }
+  }
+}
+
+
+int TerrainDerivatives::grey (int type, float val)
+{
+  if (std::isnan (val)) return 0;
+  float g = 0.0f;
+  if (type == SLOPE) g = 255.0f - val * 255.0f / 90.0f;
+  else if (type == ASPECT) g = (val < 0.0f ? 0.0f : 1.0f + val * 254.0f / 360.0f);
+  else if (type == OPENNESS)
+    g = (val - OPENNESS_MIN) * 255.0f / (OPENNESS_MAX - OPENNESS_MIN);
+  else g = 127.5f + val * 127.5f
+                    / (type == LOCAL_RELIEF ? RELIEF_RANGE : CURVATURE_RANGE);
+  return (g < 0.0f ? 0 : (g > 255.0f ? 255 : (int) g));
+}
@@ -0,0 +1,210 @@
+/*  Copyright 2021 Philippe Even and Phuc Ngo,
+      authors of paper:
+      Even, P., and Ngo, P., 2021,
+      Automatic forest road extraction fromLiDAR data of mountainous areas.
+      In the First International Joint Conference of Discrete Geometry
+      and Mathematical Morphology (Springer LNCS 12708), pp. 93-106.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef TERRAIN_DERIVATIVES_H
+#define TERRAIN_DERIVATIVES_H
+
+#include <string>
+#include <vector>
+#include <inttypes.h>
+#include "terrainmap.h"
+
+
+/** 
+ * @class TerrainDerivatives terrainderivatives.h
+ * \brief Rasters derived from a terrain map.
+ * Slope, aspect and curvatures are derived from the normal map,
+ *   openness and local relief from DTM heights (only available for maps
+ *   created from DTM files).
+ * Rasters are computed tile by tile in parallel on first request,
+ *   then kept until the map is changed.
+ */
+class TerrainDerivatives
+{
+public:
+
+  /** Slope raster type (in degrees). */
+  static const int SLOPE;
+  /** Aspect raster type (downslope direction in degrees from north,
+   *  clockwise, -1 on flat areas). */
+  static const int ASPECT;
+  /** Profile curvature raster type (in inverse meters, positive on
+   *  convex shapes). */
+  static const int PROFILE_CURVATURE;
+  /** Plan curvature raster type (in inverse meters, positive on
+   *  convex shapes). */
+  static const int PLAN_CURVATURE;
+  /** Positive openness raster type (in degrees). */
+  static const int OPENNESS;
+  /** Local relief model raster type (height above local mean, in meters). */
+  static const int LOCAL_RELIEF;
+  /** Count of raster types. */
+  static const int NB_TYPES = 6;
+  /** Default openness search radius (in pixels). */
+  static const int DEFAULT_OPENNESS_RADIUS;
+  /** Default local relief averaging radius (in pixels). */
+  static const int DEFAULT_RELIEF_RADIUS;
+
+
+  /**
+   * \brief Creates a derivative engine without terrain map.
+   */
+  TerrainDerivatives ();
+
+  /**
+   * \brief Deletes the derivative engine.
+   */
+  ~TerrainDerivatives ();
+
+  /**
+   * \brief Sets the terrain map and releases computed rasters.
+   * To be called again each time the terrain map is changed.
+   * @param map Terrain map.
+   */
+  void setMap (const TerrainMap *map);
+
+  /**
+   * \brief Releases computed rasters.
+   */
+  void clear ();
+
+  /**
+   * \brief Returns the name of a raster type.
+   * @param type Raster type.
+   */
+  static std::string name (int type);
+
+  /**
+   * \brief Returns whether a raster type can be computed for the map.
+   * @param type Raster type.
+   */
+  bool available (int type) const;
+
+  /**
+   * \brief Returns the openness search radius (in pixels).
+   */
+  inline int opennessRadius () const { return open_rad; }
+
+  /**
+   * \brief Sets the openness search radius and releases openness raster.
+   * @param val New radius (in pixels).
+   */
+  void setOpennessRadius (int val);
+
+  /**
+   * \brief Returns the local relief averaging radius (in pixels).
+   */
+  inline int reliefRadius () const { return relief_rad; }
+
+  /**
+   * \brief Sets the local relief averaging radius and releases relief raster.
+   * @param val New radius (in pixels).
+   */
+  void setReliefRadius (int val);
+
+  /**
+   * \brief Returns a raster (row by row from top), computed if required.
+   * Returns NULL if the raster type is not available.
+   * Lacking values are set to NaN.
+   * @param type Raster type.
+   */
+  const float *raster (int type);
+
+  /**
+   * \brief Returns a raster value, computing the raster if required.
+   * Returns NaN if the raster type is not available.
+   * @param type Raster type.
+   * @param i Pixel column.
+   * @param j Pixel row (from top).
+   */
+  float value (int type, int i, int j);
+
+  /**
+   * \brief Renders a raster as grey levels in an ARGB32 buffer.
+   * Returns false (buffer untouched) if the raster type is not available.
+   * @param type Raster type.
+   * @param buf Output buffer for the whole map.
+   * @param stride Count of pixels between two buffer rows.
+   */
+  bool render (int type, uint32_t *buf, int stride);
+
+
+private:
+
+  /** Curvature displayed as full black or white (in inverse meters). */
+  static const float CURVATURE_RANGE;
+  /** Openness displayed as full black (in degrees). */
+  static const float OPENNESS_MIN;
+  /** Openness displayed as full white (in degrees). */
+  static const float OPENNESS_MAX;
+  /** Local relief displayed as full black or white (in meters). */
+  static const float RELIEF_RANGE;
+  /** Squared gradient under which curvatures are set to zero. */
+  static const float FLAT_GRADIENT2;
+  /** Minimal count of rows rendered by a thread. */
+  static const int RENDER_MIN_BAND;
+
+  /** Terrain map. */
+  const TerrainMap *dtm;
+  /** Computed rasters (NULL if not computed yet). */
+  float *rasters[NB_TYPES];
+  /** Openness search radius (in pixels). */
+  int open_rad;
+  /** Local relief averaging radius (in pixels). */
+  int relief_rad;
+
+
+  /**
+   * \brief Computes a raster type for a tile from the normal map.
+   * Height gradients are also read from the one pixel wide tile halo.
+   * @param type Raster type (slope, aspect or curvature).
+   * @param tx Tile column.
+   * @param ty Tile row (from top).
+   * @param grad Gradient buffer for the tile with its halo.
+   * @param out Output raster.
+   */
+  void setNormalDerivative (int type, int tx, int ty,
+                            float *grad, float *out) const;
+
+  /**
+   * \brief Computes a raster type for a tile from DTM heights.
+   * @param type Raster type (openness or local relief).
+   * @param tx Tile column.
+   * @param ty Tile row (from top).
+   * @param tiles Height values of the tile and of its neighbours
+   *   (map tiles row by row from top, left empty where not read).
+   * @param hts Height buffer for the tile with its halo.
+   * @param sums Summed-area buffer for the tile with its halo.
+   * @param out Output raster.
+   */
+  void setHeightDerivative (int type, int tx, int ty,
+                            const std::vector<std::vector<float> > &tiles,
+                            float *hts, double *sums, float *out) const;
+
+  /**
+   * \brief Returns the grey level displaying a raster value.
+   * @param type Raster type.
+   * @param val Raster value.
+   */
+  static int grey (int type, float val);
+};
+
+#endif
@@ -23,8 +23,14 @@
 #include <fstream>
 #include <inttypes.h>
 #include <cmath>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <sys/stat.h>
+#include <chrono>
 #include "asmath.h"
 #include "terrainmap.h"
+#include "asparallel.h"
 
 const int TerrainMap::SHADE_HILL = 0;
 const int TerrainMap::SHADE_SLOPE = 1;
@@ -35,14 +41,18 @@ const float TerrainMap::LIGHT_ANGLE_INCREMENT = 0.03f;
 
 const int TerrainMap::DEFAULT_PAD_SIZE = 3;
 const std::string TerrainMap::NVM_SUFFIX = std::string (".nvm");
+const std::string TerrainMap::DTB_SUFFIX = std::string (".dtb");
 
 const float TerrainMap::MM2M = 0.001f;
 const double TerrainMap::EPS = 0.001;
+const int TerrainMap::NVM_V2_TAG = -2;
+const int TerrainMap::RENDER_MIN_BAND = 32;
 
 
 TerrainMap::TerrainMap ()
 {
   nmap = NULL;
+  nvm_version = 1;
   arr_files = NULL;
   iwidth = 0;
   iheight = 0;
@@ -52,6 +62,8 @@ TerrainMap::TerrainMap ()
   x_min = 0.0;
   y_min = 0.0;
   no_data = 0.0;
+  dtm_heights = false;
+  dtm_grid_ref = false;
   shading = SHADE_HILL;
   light_angle = 0.0f;
   light_v1.set (- ASF_SQRT2_2, 0.0f, ASF_SQRT2_2);
@@ -75,20 +87,23 @@ TerrainMap::~TerrainMap ()
 
 void TerrainMap::clear ()
 {
-  if (arr_files != NULL)
-  {
-    for (int i = 0; i < ts_cot * ts_rot; i ++)
-      if (arr_files[i] != NULL) delete arr_files[i];
-    delete [] arr_files;
-  }
+  clearPrefetch ();
+  // Arranged file names point to input_fullnames items
+  if (arr_files != NULL) delete [] arr_files;
   arr_files = NULL;
+  clearSlopeTables ();
   if (nmap != NULL) delete [] nmap;
   nmap = NULL;
   input_layout.clear ();
   input_fullnames.clear ();
   input_nicknames.clear ();
+  input_versions.clear ();
+  input_places.clear ();
   input_xmins.clear ();
   input_ymins.clear ();
+  input_offsets.clear ();
+  input_nodata.clear ();
+  dtm_heights = false;
 }
 
 
@@ -96,24 +111,21 @@ int TerrainMap::get (int i, int j) const
 { 
   if (shading == SHADE_HILL)
   {
-    float val1 = light_v1.scalar (nmap[j * iwidth + i]);
+    Pt3f nv (nmap[j * iwidth + i].vector ());
+    float val1 = light_v1.scalar (nv);
     if (val1 < 0.0f) val1 = 0.;
-    float val2 = light_v2.scalar (nmap[j * iwidth + i]);
+    float val2 = light_v2.scalar (nv);
     if (val2 < 0.0f) val2 = 0.;
-    float val3 = light_v3.scalar (nmap[j * iwidth + i]);
+    float val3 = light_v3.scalar (nv);
     if (val3 < 0.0f) val3 = 0.;
     float val = val1 + (val2 + val3) / 2;
     return (int) (val * 100);
   }
   else if (shading == SHADE_SLOPE)
-  {
-    Pt3f *pt = nmap + j * iwidth + i;
-    return (255 - (int) (sqrt (pt->x() * pt->x() + pt->y() * pt->y()) * 255));
-  }
+    return (255 - (int) (sqrt (nmap[j * iwidth + i].slope2 ()) * 255));
   else if (shading == SHADE_EXP_SLOPE)
   {
-    Pt3f *pt = nmap + j * iwidth + i;
-    double alph = 1. - pt->x () * pt->x () - pt->y () * pt->y ();
+    double alph = 1. - nmap[j * iwidth + i].slope2 ();
     for (int sl = slopiness; sl > 1; sl --) alph *= alph;
     return ((int) (alph * 255));
   }
@@ -125,24 +137,21 @@ int TerrainMap::get (int i, int j, int shading_type) const
 {
   if (shading_type == SHADE_HILL)
   {
-    float val1 = light_v1.scalar (nmap[j * iwidth + i]);
+    Pt3f nv (nmap[j * iwidth + i].vector ());
+    float val1 = light_v1.scalar (nv);
     if (val1 < 0.0f) val1 = 0.;
-    float val2 = light_v2.scalar (nmap[j * iwidth + i]);
+    float val2 = light_v2.scalar (nv);
     if (val2 < 0.0f) val2 = 0.;
-    float val3 = light_v3.scalar (nmap[j * iwidth + i]);
+    float val3 = light_v3.scalar (nv);
     if (val3 < 0.0f) val3 = 0.;
     float val = val1 + (val2 + val3) / 2;
     return (int) (val * 100);
   }
   else if (shading_type == SHADE_SLOPE)
-  {
-    Pt3f *pt = nmap + j * iwidth + i;
-    return (255 - (int) (sqrt (pt->x() * pt->x() + pt->y() * pt->y()) * 255));
-  }
+    return (255 - (int) (sqrt (nmap[j * iwidth + i].slope2 ()) * 255));
   else if (shading_type == SHADE_EXP_SLOPE)
   {
-    Pt3f *pt = nmap + j * iwidth + i;
-    double alph = 1. - pt->x () * pt->x () - pt->y () * pt->y ();
+    double alph = 1. - nmap[j * iwidth + i].slope2 ();
     if (alph < 0.) alph = 0.;  // saturation
     for (int sl = slopiness; sl > 1; sl --) alph *= alph;
     return ((int) (alph * 255));
@@ -153,14 +162,124 @@ int TerrainMap::get (int i, int j, int shading_type) const
 
 double TerrainMap::getSlopeFactor (int i, int j, int slp) const
 {
-  Pt3f *pt = nmap + j * iwidth + i;
-  double alph = 1. - pt->x () * pt->x () - pt->y () * pt->y ();
+  double alph = 1. - nmap[j * iwidth + i].slope2 ();
   if (alph < 0.) alph = 0.;  // saturation
   for (int sl = slp; sl > 1; sl --) alph *= alph;
   return (alph);
 }
 
 
+void TerrainMap::render (uint32_t *buf, int stride,
+                         int imin, int jmin, int w, int h) const
+{
+  render (buf, stride, imin, jmin, w, h, shading);
+}
+
+
+void TerrainMap::render (uint32_t *buf, int stride, int imin, int jmin,
+                         int w, int h, int shading_type) const
+{
+  Pt3f lights[3] = { light_v1, light_v2, light_v3 };
+  renderRegion (buf, stride, imin, jmin, w, h, shading_type,
+                lights, slopiness);
+}
+
+
+void TerrainMap::render (uint32_t *buf, int stride, int imin, int jmin,
+                         int w, int h, int shading_type,
+                         float angle, int slp) const
+{
+  if (angle < 0.0f) angle += ASF_2PI;
+  else if (angle >= ASF_2PI) angle -= ASF_2PI;
+  Pt3f lights[3];
+  setLights (angle, lights);
+  renderRegion (buf, stride, imin, jmin, w, h, shading_type,
+                lights, slp < 1 ? 1 : slp);
+}
+
+
+void TerrainMap::renderRegion (uint32_t *buf, int stride,
+                               int imin, int jmin, int w, int h,
+                               int shading_type,
+                               const Pt3f *lights, int slp) const
+{
+  if (nmap == NULL || imin < 0 || jmin < 0 || w <= 0 || h <= 0
+      || imin + w > iwidth || jmin + h > iheight) return;
+  ASParallel::forBands (h, RENDER_MIN_BAND,
+    [=] (int start, int stop)
+    {
+      for (int j = start; j < stop; j++)
+      {
+        uint32_t *out = buf + j * stride;
+        const ONormal *nv = nmap + (jmin + j) * iwidth + imin;
+        for (int i = 0; i < w; i += RENDER_CHUNK)
+          renderChunk (out + i, nv + i,
+                       (w - i < RENDER_CHUNK ? w - i : RENDER_CHUNK),
+                       shading_type, lights, slp);
+      }
+    });
+}
+
+
+void TerrainMap::renderChunk (uint32_t *out, const ONormal *nv, int n,
+                              int shading_type,
+                              const Pt3f *lights, int slp) const
+{
+  // Straight loops without data dependent branches, to be vectorized.
+  if (shading_type == SHADE_HILL)
+  {
+    float l1x = lights[0].x (), l1y = lights[0].y (), l1z = lights[0].z ();
+    float l2x = lights[1].x (), l2y = lights[1].y (), l2z = lights[1].z ();
+    float l3x = lights[2].x (), l3y = lights[2].y (), l3z = lights[2].z ();
+    for (int k = 0; k < n; k++)
+    {
+      float x, y, z;
+      nv[k].get (x, y, z);
+      float val1 = x * l1x + y * l1y + z * l1z;
+      float val2 = x * l2x + y * l2y + z * l2z;
+      float val3 = x * l3x + y * l3y + z * l3z;
+      val1 = (val1 < 0.0f ? 0.0f : val1);
+      val2 = (val2 < 0.0f ? 0.0f : val2);
+      val3 = (val3 < 0.0f ? 0.0f : val3);
+      uint32_t val = (uint32_t) (int) ((val1 + (val2 + val3) / 2) * 100);
+      out[k] = 0xff000000u | (val * 0x010101u);
+    }
+  }
+  else if (shading_type == SHADE_SLOPE)
+  {
+    for (int k = 0; k < n; k++)
+    {
+      uint32_t val = (uint32_t) (255
+                       - (int) (sqrt ((double) nv[k].slope2 ()) * 255));
+      out[k] = 0xff000000u | (val * 0x010101u);
+    }
+  }
+  else if (shading_type == SHADE_EXP_SLOPE)
+  {
+    double alph[RENDER_CHUNK];
+    for (int k = 0; k < n; k++)
+    {
+      double a = 1. - nv[k].slope2 ();
+      alph[k] = (a < 0. ? 0. : a);  // saturation
+    }
+    for (int sl = slp; sl > 1; sl --)
+      for (int k = 0; k < n; k++) alph[k] *= alph[k];
+    for (int k = 0; k < n; k++)
+    {
+      uint32_t val = (uint32_t) (int) (alph[k] * 255);
+      out[k] = 0xff000000u | (val * 0x010101u);
+    }
+  }
+  else for (int k = 0; k < n; k++) out[k] = 0xff000000u;
+}
+
+
+void TerrainMap::setNvmVersion (int val)
+{
+  if (val == 1 || val == 2) nvm_version = val;
+}
+
+
 void TerrainMap::toggleShadingType ()
 {
   if (++shading > SHADE_EXP_SLOPE) shading = SHADE_HILL;
@@ -173,15 +292,11 @@ void TerrainMap::incLightAngle (int val)
   if (light_angle < 0.0f) light_angle += ASF_2PI;
   else if (light_angle >= ASF_2PI) light_angle -= ASF_2PI;
 
-  float ang = light_angle;
-  light_v1.set (- (float) (cos (ang) * ASF_SQRT2_2),
-                - (float) (sin (ang) * ASF_SQRT2_2), ASF_SQRT2_2);
-  ang += ASF_2PI_3;
-  light_v2.set (- (float) (cos (ang) / 2),
-                - (float) (sin (ang) / 2), ASF_SQRT3_2);
-  ang += ASF_2PI_3;
-  light_v3.set (- (float) (cos (ang) / 2),
-                - (float) (sin (ang) / 2), ASF_SQRT3_2);
+  Pt3f lights[3];
+  setLights (light_angle, lights);
+  light_v1.set (lights[0]);
+  light_v2.set (lights[1]);
+  light_v3.set (lights[2]);
 }
 
 
@@ -191,15 +306,24 @@ void TerrainMap::setLightAngle (float val)
   if (light_angle < 0.0f) light_angle += ASF_2PI;
   else if (light_angle >= ASF_2PI) light_angle -= ASF_2PI;
 
-  float ang = light_angle;
-  light_v1.set (- (float) (cos (ang) * ASF_SQRT2_2),
-                - (float) (sin (ang) * ASF_SQRT2_2), ASF_SQRT2_2);
+  Pt3f lights[3];
+  setLights (light_angle, lights);
+  light_v1.set (lights[0]);
+  light_v2.set (lights[1]);
+  light_v3.set (lights[2]);
+}
+
+
+void TerrainMap::setLights (float ang, Pt3f *lights)
+{
+  lights[0].set (- (float) (cos (ang) * ASF_SQRT2_2),
+                 - (float) (sin (ang) * ASF_SQRT2_2), ASF_SQRT2_2);
   ang += ASF_2PI_3;
-  light_v2.set (- (float) (cos (ang) / 2),
-                - (float) (sin (ang) / 2), ASF_SQRT3_2);
+  lights[1].set (- (float) (cos (ang) / 2),
+                 - (float) (sin (ang) / 2), ASF_SQRT3_2);
   ang += ASF_2PI_3;
-  light_v3.set (- (float) (cos (ang) / 2),
-                - (float) (sin (ang) / 2), ASF_SQRT3_2);
+  lights[2].set (- (float) (cos (ang) / 2),
+                 - (float) (sin (ang) / 2), ASF_SQRT3_2);
 }
 
 
@@ -218,61 +342,169 @@ void TerrainMap::setSlopinessFactor (int val)
 
 Pt2i TerrainMap::closestFlatArea (const Pt2i &pt, int srad, int frad, int sfact)
 {
-  int sxmin = pt.x () - srad, sxmax = pt.x () + srad + 1;
-  int symin = pt.y () - srad, symax = pt.y () + srad + 1;
-  if (sxmin < 0) sxmin = 0;
-  if (symin < 0) symin = 0;
-  if (sxmax > iwidth) sxmax = iwidth;
-  if (symax > iheight) symax = iheight;
+  if (nmap == NULL) return pt;
+  std::vector<Pt2i> pts (1, pt);
+  return (flatAreaCenter (slopeTables (pts, srad + frad, sfact),
+                          pt, srad, frad));
+}
+
 
-  int fxmin = sxmin - frad, fxmax = sxmax + frad;
-  int fymin = symin - frad, fymax = symax + frad;
-  if (fxmin < 0) fxmin = 0;
-  if (fymin < 0) fymin = 0;
-  if (fxmax > iwidth) fxmax = iwidth;
-  if (fymax > iheight) fymax = iheight;
-
-  int sw = sxmax - sxmin, sh = symax - symin, swh = sw * sh;
-  double *val = new double[swh];
-  int *cpt = new int[swh];
-  for (int i = 0; i < swh; i++)
+void TerrainMap::closestFlatAreas (const std::vector<Pt2i> &pts,
+                                   int srad, int frad, int sfact,
+                                   std::vector<Pt2i> &res)
+{
+  res.assign (pts.begin (), pts.end ());
+  if (nmap == NULL || pts.empty ()) return;
+  const std::vector<double *> &sats = slopeTables (pts, srad + frad, sfact);
+  ASParallel::forBands ((int) pts.size (), 1,
+    [&] (int start, int stop)
+    {
+      for (int k = start; k < stop; k++)
+        res[k].set (flatAreaCenter (sats, pts[k], srad, frad));
+    });
+}
+
+
+void TerrainMap::clearSlopeTables ()
+{
+  std::map<int, std::vector<double *> >::iterator it = slope_tables.begin ();
+  while (it != slope_tables.end ())
   {
-    val[i] = 0.;
-    cpt[i] = 0;
+    std::vector<double *>::iterator sit = it->second.begin ();
+    while (sit != it->second.end ())
+    {
+      if (*sit != NULL) delete [] *sit;
+      sit ++;
+    }
+    it ++;
   }
+  slope_tables.clear ();
+}
+
 
-  for (int fi = fxmin; fi < fxmax; fi ++)
+const std::vector<double *> &TerrainMap::slopeTables (
+                   const std::vector<Pt2i> &pts, int rad, int sfact)
+{
+  int tcols = (iwidth + twidth - 1) / twidth;
+  int trows = (iheight + theight - 1) / theight;
+  std::vector<double *> &sats = slope_tables[sfact];
+  if (sats.empty ()) sats.assign (tcols * trows, (double *) NULL);
+
+  // Lists missing tables of tiles met by the search areas
+  std::vector<bool> needed (tcols * trows, false);
+  std::vector<int> missing;
+  std::vector<Pt2i>::const_iterator it = pts.begin ();
+  while (it != pts.end ())
   {
-    int lxmin = fi - frad - sxmin;
-    int lxmax = fi + frad + 1 - sxmin;
-    if (lxmin < 0) lxmin = 0;
-    if (lxmax > sw) lxmax = sw;
-    for (int fj = fymin; fj < fymax; fj ++)
-    {
-      double dval = getSlopeFactor (fi, iheight - 1 - fj, sfact);
-      int lymin = fj - frad - symin;
-      int lymax = fj + frad + 1 - symin;
-      if (lymin < 0) lymin = 0;
-      if (lymax > sh) lymax = sh;
-      for (int lj = lymin; lj < lymax; lj ++)
-        for (int li = lxmin; li < lxmax; li ++)
+    int c0 = it->x () - rad, c1 = it->x () + rad;
+    int r0 = iheight - 1 - it->y () - rad, r1 = iheight - 1 - it->y () + rad;
+    if (c0 < 0) c0 = 0;
+    if (r0 < 0) r0 = 0;
+    if (c1 >= iwidth) c1 = iwidth - 1;
+    if (r1 >= iheight) r1 = iheight - 1;
+    for (int ty = r0 / theight; ty <= r1 / theight; ty++)
+      for (int tx = c0 / twidth; tx <= c1 / twidth; tx++)
+        if (sats[ty * tcols + tx] == NULL && ! needed[ty * tcols + tx])
         {
-          val[lj * sw + li] += dval;
-          cpt[lj * sw + li] ++;
+          needed[ty * tcols + tx] = true;
+          missing.push_back (ty * tcols + tx);
         }
+    it ++;
+  }
+
+  ASParallel::forBands ((int) missing.size (), 1,
+    [&] (int start, int stop)
+    {
+      for (int k = start; k < stop; k++)
+        sats[missing[k]] = createSlopeTable (sfact, missing[k] % tcols,
+                                             missing[k] / tcols);
+    });
+  return sats;
+}
+
+
+double *TerrainMap::createSlopeTable (int sfact, int tx, int ty) const
+{
+  int c0 = tx * twidth, r0 = ty * theight;
+  int tw = (iwidth - c0 < twidth ? iwidth - c0 : twidth);
+  int th = (iheight - r0 < theight ? iheight - r0 : theight);
+  int sw = twidth + 1;
+  double *sat = new double[sw * (theight + 1)];
+  for (int i = 0; i < sw * (theight + 1); i++) sat[i] = 0.;
+  for (int r = 0; r < th; r++)
+  {
+    double rsum = 0.;
+    double *prev = sat + r * sw + 1, *cur = sat + (r + 1) * sw + 1;
+    for (int c = 0; c < tw; c++)
+    {
+      rsum += getSlopeFactor (c0 + c, r0 + r, sfact);
+      cur[c] = prev[c] + rsum;
     }
   }
+  return sat;
+}
+
+
+double TerrainMap::slopeSum (const std::vector<double *> &sats,
+                             int c0, int r0, int c1, int r1) const
+{
+  int tcols = (iwidth + twidth - 1) / twidth;
+  int sw = twidth + 1;
+  double sum = 0.;
+  for (int ty = r0 / theight; ty <= (r1 - 1) / theight; ty++)
+  {
+    int a = r0 - ty * theight, b = r1 - ty * theight;
+    if (a < 0) a = 0;
+    if (b > theight) b = theight;
+    for (int tx = c0 / twidth; tx <= (c1 - 1) / twidth; tx++)
+    {
+      int c = c0 - tx * twidth, d = c1 - tx * twidth;
+      if (c < 0) c = 0;
+      if (d > twidth) d = twidth;
+      const double *sat = sats[ty * tcols + tx];
+      sum += sat[b * sw + d] - sat[a * sw + d] - sat[b * sw + c]
+             + sat[a * sw + c];
+    }
+  }
+  return sum;
+}
+
+
+Pt2i TerrainMap::flatAreaCenter (const std::vector<double *> &sats,
+                                 const Pt2i &pt, int srad, int frad) const
+{
+  int sxmin = pt.x () - srad, sxmax = pt.x () + srad + 1;
+  int symin = pt.y () - srad, symax = pt.y () + srad + 1;
+  if (sxmin < 0) sxmin = 0;
+  if (symin < 0) symin = 0;
+  if (sxmax > iwidth) sxmax = iwidth;
+  if (symax > iheight) symax = iheight;
+  if (sxmin >= sxmax || symin >= symax) return pt;
 
-  int cmax = 0;
-  val[0] /= cpt[0];
-  for (int i = 1; i < swh; i ++)
+  // Search area scanned upwards, first best mean kept
+  double vmax = -1.;
+  int cx = sxmin, cy = symin;
+  for (int y = symin; y < symax; y++)
   {
-    val[i] /= cpt[i];
-    if (val[i] > val[cmax]) cmax = i;
+    int r0 = iheight - 1 - y - frad, r1 = iheight - y + frad;
+    if (r0 < 0) r0 = 0;
+    if (r1 > iheight) r1 = iheight;
+    for (int x = sxmin; x < sxmax; x++)
+    {
+      int c0 = x - frad, c1 = x + frad + 1;
+      if (c0 < 0) c0 = 0;
+      if (c1 > iwidth) c1 = iwidth;
+      double val = slopeSum (sats, c0, r0, c1, r1)
+                   / ((c1 - c0) * (r1 - r0));
+      if (val > vmax)
+      {
+        vmax = val;
+        cx = x;
+        cy = y;
+      }
+    }
   }
-  delete [] val;
-  delete [] cpt;
-  return (Pt2i (sxmin + cmax % sw, symin + cmax / sw));
+  return (Pt2i (cx, cy));
 }
 
 
@@ -287,10 +519,90 @@ bool TerrainMap::addNormalMapFile (const std::string &name)
 
 
 bool TerrainMap::assembleMap (int cols, int rows, int64_t xmin, int64_t ymin,
+                              bool padding, bool verb)
+{
+  std::chrono::steady_clock::time_point start_time
+    = std::chrono::steady_clock::now ();
+  if (! locateTiles (cols, rows, xmin, ymin, padding)) return false;
+  if (padding || twidth == 0) return true;
+
+  // Tiles read in parallel into disjoint map regions
+  clearSlopeTables ();
+  if (nmap != NULL) delete [] nmap;
+  nmap = new ONormal[iwidth * iheight];
+  int nbt = (int) input_fullnames.size ();
+  std::vector<double> durations (nbt, 0.);
+  ASParallel::forBands (nbt, 1,
+    [&] (int start, int stop)
+    {
+      for (int k = start; k < stop; k++)
+      {
+        std::chrono::steady_clock::time_point tile_time
+          = std::chrono::steady_clock::now ();
+        if (loadTile (k))
+          durations[k] = std::chrono::duration<double, std::milli> (
+                 std::chrono::steady_clock::now () - tile_time).count ();
+      }
+    });
+  if (verb)
+  {
+    for (int k = 0; k < nbt; k++)
+      if (input_versions[k] != -1)
+        std::cout << "Tile " << input_fullnames[k] << " read in "
+                  << durations[k] << " ms" << std::endl;
+    std::cout << "Map assembled in "
+              << std::chrono::duration<double, std::milli> (
+                   std::chrono::steady_clock::now () - start_time).count ()
+              << " ms" << std::endl;
+  }
+  return true;
+}
+
+
+bool TerrainMap::prepareMap (int cols, int rows, int64_t xmin, int64_t ymin)
+{
+  if (! locateTiles (cols, rows, xmin, ymin, false) || twidth == 0)
+    return false;
+  clearSlopeTables ();
+  if (nmap != NULL) delete [] nmap;
+  nmap = new ONormal[iwidth * iheight];
+  return true;
+}
+
+
+bool TerrainMap::loadTile (int k)
+{
+  if (nmap == NULL || k < 0 || k >= (int) input_versions.size ()
+      || input_versions[k] == -1) return false;
+  std::ifstream nvmf (input_fullnames[k].c_str (),
+                      std::ios::in | std::ifstream::binary);
+  if (! nvmf.is_open ()) return false;
+  int w = 0, h = 0;
+  float cs = 0.0f, xm = 0.0f, ym = 0.0f;
+  readNvmHeader (nvmf, w, h, cs, xm, ym);
+  ONormal *line = nmap + iwidth * (iheight - 1);
+  line -= input_places[k].y () * theight * iwidth;
+  line += input_places[k].x () * twidth;
+  readNvmTile (nvmf, input_versions[k], line, - iwidth);
+  nvmf.close ();
+  return true;
+}
+
+
+bool TerrainMap::tileRegion (int k, int &imin, int &jmin) const
+{
+  if (k < 0 || k >= (int) input_versions.size ()
+      || input_versions[k] == -1) return false;
+  imin = input_places[k].x () * twidth;
+  jmin = iheight - (input_places[k].y () + 1) * theight;
+  return true;
+}
+
+
+bool TerrainMap::locateTiles (int cols, int rows, int64_t xmin, int64_t ymin,
                               bool padding)
 {
-  int locw = 0, loch = 0, loci = 0, locj = 0;
-  float wmap = 0.0f, hmap = 0.0f, locs = 0.0f, locxmin = 0.0f, locymin = 0.0f;
+  float wmap = 0.0f, hmap = 0.0f;
   if (padding)
   {
     ts_cot = cols;
@@ -298,6 +610,7 @@ bool TerrainMap::assembleMap (int cols, int rows, int64_t xmin, int64_t ymin,
   }
   twidth = 0;
   theight = 0;
+  dtm_heights = false;
   x_min = (double) (xmin) * MM2M;
   y_min = (double) (ymin) * MM2M;
   if (padding)
@@ -305,92 +618,91 @@ bool TerrainMap::assembleMap (int cols, int rows, int64_t xmin, int64_t ymin,
     arr_files = new std::string *[cols * rows];
     for (int i = 0; i < cols * rows; i++) arr_files[i] = NULL;
   }
-  std::vector<std::string>::iterator it = input_fullnames.begin ();
-  while (it != input_fullnames.end ())
-  {
-    std::ifstream nvmf (it->c_str (), std::ios::in | std::ifstream::binary);
-    if (! nvmf.is_open ())
-      std::cout << "File " << *it << " can't be opened" << std::endl;
-    else
+
+  // Headers read in parallel (version -1 for unopened files)
+  int nbt = (int) input_fullnames.size ();
+  input_versions.assign (nbt, -1);
+  input_places.assign (nbt, Pt2i (0, 0));
+  std::vector<int> locw (nbt, 0), loch (nbt, 0);
+  std::vector<float> locs (nbt, 0.0f);
+  std::vector<float> locxmin (nbt, 0.0f), locymin (nbt, 0.0f);
+  ASParallel::forBands (nbt, 1,
+    [&] (int start, int stop)
     {
-      nvmf.read ((char *) (&locw), sizeof (int));
-      nvmf.read ((char *) (&loch), sizeof (int));
-      nvmf.read ((char *) (&locs), sizeof (float));
-      nvmf.read ((char *) (&locxmin), sizeof (float));
-      nvmf.read ((char *) (&locymin), sizeof (float));
-      if (twidth != 0)
+      for (int k = start; k < stop; k++)
       {
-        bool ok = true;
-        if (locw != twidth)
-        {
-          std::cout << *it << " : distinct width" << std::endl;
-          ok = false;
-        }
-        if (loch != theight)
-        {
-          std::cout << *it << " : distinct height" << std::endl;
-          ok = false;
-        }
-        if (locs != cell_size)
-        {
-          std::cout << *it << " : distinct cell size" << std::endl;
-          ok = false;
-        }
-        if (padding)
-        {
-          double dx = ((double) ((int) (locxmin + 0.5f))) - x_min;
-          if (dx < 0.0) dx = - dx;
-          if (((int) (dx + 0.5f)) % ((int) (wmap + 0.5f)) != 0)
-          {
-            std::cout << *it << " : X axis aperiodicity" << std::endl;
-            ok = false;
-          }
-          double dy = ((double) ((int) (locymin + 0.5f))) - y_min;
-          if (dy < 0.0) dy = - dy;
-          if (((int) (dy + 0.5f)) % ((int) (hmap + 0.5f)) != 0)
-          {
-            std::cout << *it << " : Y axis aperiodicity" << std::endl;
-            ok = false;
-          }
-        }
-        if (! ok)
+        std::ifstream nvmf (input_fullnames[k].c_str (),
+                            std::ios::in | std::ifstream::binary);
+        if (nvmf.is_open ())
         {
+          input_versions[k] = readNvmHeader (nvmf, locw[k], loch[k], locs[k],
+                                             locxmin[k], locymin[k]);
           nvmf.close ();
-          return false;
         }
       }
-      else
+    });
+
+  // Headers checked and tiles located in input order
+  for (int k = 0; k < nbt; k++)
+  {
+    const std::string &name = input_fullnames[k];
+    if (input_versions[k] == -1)
+    {
+      std::cout << "File " << name << " can't be opened" << std::endl;
+      continue;
+    }
+    if (twidth != 0)
+    {
+      bool ok = true;
+      if (locw[k] != twidth)
       {
-        twidth = locw;
-        theight = loch;
-        cell_size = locs;
-        iwidth = cols * twidth;
-        iheight = rows * theight;
-        if (! padding)
-        {
-          if (nmap != NULL) delete [] nmap;
-          nmap = new Pt3f[iwidth * iheight];
-        }
+        std::cout << name << " : distinct width" << std::endl;
+        ok = false;
       }
-      wmap = twidth * cell_size;
-      hmap = theight * cell_size;
-      loci = (int) ((locxmin - x_min + wmap / 2) / wmap);
-      locj = (int) ((locymin - y_min + hmap / 2) / hmap);
-      if (padding) arr_files[locj * cols + loci] = &(*it);
-      else
+      if (loch[k] != theight)
+      {
+        std::cout << name << " : distinct height" << std::endl;
+        ok = false;
+      }
+      if (locs[k] != cell_size)
+      {
+        std::cout << name << " : distinct cell size" << std::endl;
+        ok = false;
+      }
+      if (padding)
       {
-        Pt3f *line = nmap + iwidth * (iheight - 1);
-        line -= locj * theight * iwidth;
-        line += loci * twidth;
-        for (int j = 0; j < theight; j++)
+        double dx = ((double) ((int) (locxmin[k] + 0.5f))) - x_min;
+        if (dx < 0.0) dx = - dx;
+        if (((int) (dx + 0.5f)) % ((int) (wmap + 0.5f)) != 0)
         {
-          nvmf.read ((char *) line, twidth * sizeof (Pt3f));
-          line -= iwidth;
+          std::cout << name << " : X axis aperiodicity" << std::endl;
+          ok = false;
+        }
+        double dy = ((double) ((int) (locymin[k] + 0.5f))) - y_min;
+        if (dy < 0.0) dy = - dy;
+        if (((int) (dy + 0.5f)) % ((int) (hmap + 0.5f)) != 0)
+        {
+          std::cout << name << " : Y axis aperiodicity" << std::endl;
+          ok = false;
         }
       }
-      nvmf.close ();
+      if (! ok) return false;
     }
-    it ++;
+    else
+    {
+      twidth = locw[k];
+      theight = loch[k];
+      cell_size = locs[k];
+      iwidth = cols * twidth;
+      iheight = rows * theight;
+    }
+    wmap = twidth * cell_size;
+    hmap = theight * cell_size;
+    input_places[k].set ((int) ((locxmin[k] - x_min + wmap / 2) / wmap),
+                         (int) ((locymin[k] - y_min + hmap / 2) / hmap));
+    if (padding)
+      arr_files[input_places[k].y () * cols + input_places[k].x ()]
+        = &(input_fullnames[k]);
   }
   return true;
 }
@@ -405,11 +717,7 @@ bool TerrainMap::loadNormalMapInfo (const std::string &name)
     return false;
   }
   float x, y;
-  nvmf.read ((char *) (&twidth), sizeof (int));
-  nvmf.read ((char *) (&theight), sizeof (int));
-  nvmf.read ((char *) (&cell_size), sizeof (float));
-  nvmf.read ((char *) (&x), sizeof (float));
-  nvmf.read ((char *) (&y), sizeof (float));
+  readNvmHeader (nvmf, twidth, theight, cell_size, x, y);
   nvmf.close ();
   x_min = (double) (x + 0.5f);
   y_min = (double) (y + 0.5f);
@@ -439,148 +747,216 @@ void TerrainMap::adjustPadSize ()
 
 int TerrainMap::nextPad (unsigned char *map)
 {
-  if (pad_ref == -1)
+  std::vector<int> tiles;
+  std::vector<unsigned char *> dsts;
+  if (prefetcher.joinable ()) prefetcher.join ();
+  pad_ref = padStep (pad_ref, map, tiles, dsts);
+  ASParallel::forBands ((int) tiles.size (), 1,
+    [&] (int start, int stop)
+    {
+      for (int k = start; k < stop; k++) fetchPadTile (tiles[k], dsts[k]);
+    });
+  clearPrefetch ();
+  if (pad_ref != -1) startPrefetch ();
+  return pad_ref;
+}
+
+
+int TerrainMap::padStep (int ref, unsigned char *map, std::vector<int> &tiles,
+                         std::vector<unsigned char *> &dsts)
+{
+  int mw = pad_w * twidth;
+  if (ref == -1)
   {
-    pad_ref = 0;
-    if (nmap != NULL) delete [] nmap;
-    nmap = new Pt3f[twidth];
+    ref = 0;
+    if (map != NULL)
+    {
+      clearSlopeTables ();
+      if (nmap != NULL) delete [] nmap;
+      nmap = NULL;
+    }
     for (int j = 0; j < pad_h; j ++)
       for (int i = 0; i < pad_w; i ++)
-        loadMap (j * ts_cot + i,
-                 map + ((pad_h - j) * theight - 1) * (pad_w * twidth)
-                     + i * twidth);
+      {
+        tiles.push_back (j * ts_cot + i);
+        if (map != NULL)
+          dsts.push_back (map + ((pad_h - j) * theight - 1) * mw
+                              + i * twidth);
+      }
   }
-  else if (((pad_ref / ts_cot) / (pad_h - 2)) % 2 == 1)
+  else if (((ref / ts_cot) / (pad_h - 2)) % 2 == 1)
   {
-    if (pad_ref % ts_cot == 0)
+    if (ref % ts_cot == 0)
     {
-      if (pad_ref + ts_cot * pad_h >= ts_cot * ts_rot)
+      if (ref + ts_cot * pad_h >= ts_cot * ts_rot)
       {
         // getting out
-        pad_ref = -1;
-        if (nmap != NULL) delete [] nmap;
-        nmap = NULL;
+        ref = -1;
       }
       else
       {
         // climbing up on left side to next row
-        pad_ref += ts_cot * (pad_h - 2);
+        ref += ts_cot * (pad_h - 2);
         int pad_eh = pad_h;
-        if (pad_ref / ts_cot + pad_h > ts_rot)
-          pad_eh -= pad_ref / ts_cot + pad_h - ts_rot;
-        unsigned char *fmap = map + 2 * theight * pad_w * twidth;
-        unsigned char *tmap = map + pad_h * theight * pad_w * twidth;
-        for (int j = 0; j < 2 * theight; j ++)
-          for (int i = 0; i < pad_w * twidth; i ++) *--tmap = *--fmap;
+        if (ref / ts_cot + pad_h > ts_rot)
+          pad_eh -= ref / ts_cot + pad_h - ts_rot;
+        if (map != NULL)
+          memmove (map + (pad_h - 2) * theight * mw, map, 2 * theight * mw);
         for (int j = 2; j < pad_eh; j ++)
           for (int i = 0; i < pad_w; i ++)
-            loadMap ((pad_ref / ts_cot + j) * ts_cot + pad_ref % ts_cot + i,
-                     map + ((pad_h - j) * theight - 1) * (pad_w * twidth)
-                         + i * twidth);
-        for (int j = pad_eh; j < pad_h; j ++)
-          for (int i = 0; i < pad_w; i ++)
-            clearMap (map + ((pad_h - j) * theight - 1) * (pad_w * twidth)
-                         + i * twidth, pad_w, twidth, theight);
+          {
+            tiles.push_back ((ref / ts_cot + j) * ts_cot + ref % ts_cot + i);
+            if (map != NULL)
+              dsts.push_back (map + ((pad_h - j) * theight - 1) * mw
+                                  + i * twidth);
+          }
+        if (map != NULL)
+          for (int j = pad_eh; j < pad_h; j ++)
+            for (int i = 0; i < pad_w; i ++)
+              clearMap (map + ((pad_h - j) * theight - 1) * mw + i * twidth,
+                        pad_w, twidth, theight);
       }
     }
     else
     {
       // going left to next column
-      pad_ref -= pad_w - 2;
+      ref -= pad_w - 2;
       int pad_eh = pad_h;
-      if (pad_ref / ts_cot + pad_h > ts_rot)
-        pad_eh -= pad_ref / ts_cot + pad_h - ts_rot;
-      unsigned char *fmap = map + (pad_h - pad_eh) * theight * pad_w * twidth
-                                + 2 * twidth;
-      unsigned char *tmap = fmap + (pad_w - 2) * twidth;
-      for (int j = 0; j < pad_eh * theight; j ++)
+      if (ref / ts_cot + pad_h > ts_rot)
+        pad_eh -= ref / ts_cot + pad_h - ts_rot;
+      if (map != NULL)
       {
-        for (int i = 0; i < 2 * twidth; i ++) *--tmap = *--fmap;
-        fmap += (pad_w + 2) * twidth;
-        tmap += (pad_w + 2) * twidth;
+        unsigned char *row = map + (pad_h - pad_eh) * theight * mw;
+        for (int j = 0; j < pad_eh * theight; j ++, row += mw)
+          memmove (row + (pad_w - 2) * twidth, row, 2 * twidth);
       }
       for (int j = 0; j < pad_eh; j ++)
         for (int i = 0; i < pad_w - 2; i ++)
-          loadMap ((pad_ref / ts_cot + j) * ts_cot + pad_ref % ts_cot + i,
-                   map + ((pad_h - j) * theight - 1) * (pad_w * twidth)
-                       + i * twidth);
+        {
+          tiles.push_back ((ref / ts_cot + j) * ts_cot + ref % ts_cot + i);
+          if (map != NULL)
+            dsts.push_back (map + ((pad_h - j) * theight - 1) * mw
+                                + i * twidth);
+        }
     }
   }
   else
   {
-    if ((pad_ref % ts_cot) + pad_w >= ts_cot)
+    if ((ref % ts_cot) + pad_w >= ts_cot)
     {
-      if (pad_ref + ts_cot * pad_h >= ts_cot * ts_rot)
+      if (ref + ts_cot * pad_h >= ts_cot * ts_rot)
       {
         // getting out
-        pad_ref = -1;
-        if (nmap != NULL) delete [] nmap;
-        nmap = NULL;
+        ref = -1;
       }
       else
       {
         // climbing up on right side to next row
-        pad_ref += ts_cot * (pad_h - 2);
+        ref += ts_cot * (pad_h - 2);
         int pad_ew = pad_w;
-        if (pad_ref % ts_cot + pad_w > ts_cot)
-          pad_ew -= pad_ref % ts_cot + pad_w - ts_cot;
+        if (ref % ts_cot + pad_w > ts_cot)
+          pad_ew -= ref % ts_cot + pad_w - ts_cot;
         int pad_eh = pad_h;
-        if (pad_ref / ts_cot + pad_h > ts_rot)
-          pad_eh -= pad_ref / ts_cot + pad_h - ts_rot;
-        unsigned char *fmap = map + 2 * theight * pad_w * twidth;
-        unsigned char *tmap = map + pad_h * theight * pad_w * twidth;
-        for (int j = 0; j < 2 * theight; j ++)
-        {
-          fmap -= (pad_w - pad_ew) * twidth;
-          tmap -= (pad_w - pad_ew) * twidth;
-          for (int i = 0; i < pad_ew * twidth; i ++) *--tmap = *--fmap;
-        }
+        if (ref / ts_cot + pad_h > ts_rot)
+          pad_eh -= ref / ts_cot + pad_h - ts_rot;
+        if (map != NULL)
+          for (int j = 2 * theight - 1; j >= 0; j --)
+            memmove (map + ((pad_h - 2) * theight + j) * mw,
+                     map + j * mw, pad_ew * twidth);
         for (int j = 2; j < pad_eh; j ++)
           for (int i = 0; i < pad_ew; i ++)
-            loadMap ((pad_ref / ts_cot + j) * ts_cot + pad_ref % ts_cot + i,
-                     map + ((pad_h - j) * theight - 1) * (pad_w * twidth)
-                         + i * twidth);
-        for (int j = pad_eh; j < pad_h; j ++)
-          for (int i = 0; i < pad_ew; i ++)
-            clearMap (map + ((pad_h - j) * theight - 1) * (pad_w * twidth)
-                         + i * twidth, pad_w, twidth, theight);
+          {
+            tiles.push_back ((ref / ts_cot + j) * ts_cot + ref % ts_cot + i);
+            if (map != NULL)
+              dsts.push_back (map + ((pad_h - j) * theight - 1) * mw
+                                  + i * twidth);
+          }
+        if (map != NULL)
+          for (int j = pad_eh; j < pad_h; j ++)
+            for (int i = 0; i < pad_ew; i ++)
+              clearMap (map + ((pad_h - j) * theight - 1) * mw + i * twidth,
+                        pad_w, twidth, theight);
       }
     }
     else
     {
       // going right to next column
-      pad_ref += pad_w - 2;
+      ref += pad_w - 2;
       int pad_ew = pad_w;
-      if (pad_ref % ts_cot + pad_w > ts_cot)
-        pad_ew -= pad_ref % ts_cot + pad_w - ts_cot;
+      if (ref % ts_cot + pad_w > ts_cot)
+        pad_ew -= ref % ts_cot + pad_w - ts_cot;
       int pad_eh = pad_h;
-      if (pad_ref / ts_cot + pad_h > ts_rot)
-        pad_eh -= pad_ref / ts_cot + pad_h - ts_rot;
-      unsigned char *tmap = map + (pad_h - pad_eh) * theight * pad_w * twidth;
-      unsigned char *fmap = tmap + (pad_w - 2) * twidth;
-      for (int j = 0; j < pad_eh * theight; j ++)
+      if (ref / ts_cot + pad_h > ts_rot)
+        pad_eh -= ref / ts_cot + pad_h - ts_rot;
+      if (map != NULL)
       {
-        for (int i = 0; i < 2 * twidth; i ++) *tmap++ = *fmap++;
-        fmap += (pad_w - 2) * twidth;
-        tmap += (pad_w - 2) * twidth;
+        unsigned char *row = map + (pad_h - pad_eh) * theight * mw;
+        for (int j = 0; j < pad_eh * theight; j ++, row += mw)
+          memmove (row, row + (pad_w - 2) * twidth, 2 * twidth);
       }
       for (int j = 0; j < pad_eh; j ++)
       {
         for (int i = 2; i < pad_ew; i ++)
         {
-          loadMap ((pad_ref / ts_cot + j) * ts_cot + pad_ref % ts_cot + i,
-                   map + ((pad_h - j) * theight - 1) * (pad_w * twidth)
-                       + i * twidth);
-        }
-        for (int i = pad_ew; i < pad_w; i ++)
-        {
-          clearMap (map + ((pad_h - j) * theight - 1) * (pad_w * twidth)
-                        + i * twidth, pad_w, twidth, theight);
+          tiles.push_back ((ref / ts_cot + j) * ts_cot + ref % ts_cot + i);
+          if (map != NULL)
+            dsts.push_back (map + ((pad_h - j) * theight - 1) * mw
+                                + i * twidth);
         }
+        if (map != NULL)
+          for (int i = pad_ew; i < pad_w; i ++)
+            clearMap (map + ((pad_h - j) * theight - 1) * mw + i * twidth,
+                      pad_w, twidth, theight);
       }
     }
   }
-  return pad_ref;
+  return ref;
+}
+
+
+void TerrainMap::fetchPadTile (int k, unsigned char *submap)
+{
+  for (int n = 0; n < (int) prefetch_tiles.size (); n++)
+    if (prefetch_tiles[n] == k && prefetch_maps[n] != NULL)
+    {
+      for (int j = 0; j < theight; j++)
+        memcpy (submap - j * pad_w * twidth,
+                prefetch_maps[n] + j * twidth, twidth);
+      return;
+    }
+  loadMap (k, submap);
+}
+
+
+void TerrainMap::startPrefetch ()
+{
+  std::vector<unsigned char *> dsts;
+  padStep (pad_ref, NULL, prefetch_tiles, dsts);
+  for (int n = 0; n < (int) prefetch_tiles.size (); n++)
+    prefetch_maps.push_back (new unsigned char[twidth * theight]);
+  prefetcher = std::thread ([this] ()
+  {
+    ASParallel::forBands ((int) prefetch_tiles.size (), 1,
+      [this] (int start, int stop)
+      {
+        for (int n = start; n < stop; n++)
+          if (! decodeTile (prefetch_tiles[n], prefetch_maps[n], twidth))
+          {
+            delete [] prefetch_maps[n];
+            prefetch_maps[n] = NULL;
+          }
+      });
+  });
+}
+
+
+void TerrainMap::clearPrefetch ()
+{
+  if (prefetcher.joinable ()) prefetcher.join ();
+  for (int n = 0; n < (int) prefetch_maps.size (); n++)
+    if (prefetch_maps[n] != NULL) delete [] prefetch_maps[n];
+  prefetch_maps.clear ();
+  prefetch_tiles.clear ();
 }
 
 
@@ -605,6 +981,12 @@ bool TerrainMap::loadMap (int k, unsigned char *submap)
 {
 //  std::cout << "MTILE " << k << " : "
 //       << (arr_files[k] == NULL ? "NULL" : *arr_files[k]) << std::endl;
+  return (decodeTile (k, submap, - pad_w * twidth));
+}
+
+
+bool TerrainMap::decodeTile (int k, unsigned char *dst, int stride) const
+{
   int locw = 0, loch = 0;
   float locs = 0.0f, locxmin = 0.0f, locymin = 0.0f;
 
@@ -614,11 +996,7 @@ bool TerrainMap::loadMap (int k, unsigned char *submap)
                         std::ios::in | std::ifstream::binary);
     if (! nvmf.is_open ())
       std::cout << "File " << *arr_files[k] << " can't be opened" << std::endl;
-    nvmf.read ((char *) (&locw), sizeof (int));
-    nvmf.read ((char *) (&loch), sizeof (int));
-    nvmf.read ((char *) (&locs), sizeof (float));
-    nvmf.read ((char *) (&locxmin), sizeof (float));
-    nvmf.read ((char *) (&locymin), sizeof (float));
+    int version = readNvmHeader (nvmf, locw, loch, locs, locxmin, locymin);
     if (locw != twidth)
     {
       std::cout << "File " << *arr_files[k] << " inconsistent width"
@@ -641,33 +1019,49 @@ bool TerrainMap::loadMap (int k, unsigned char *submap)
       return false;
     }
 
-    unsigned char *pmap = submap;
-    for (int j = 0; j < theight; j++)
+    // Whole tile read at once
+    if (version == 1)
     {
-      nvmf.read ((char *) nmap, twidth * sizeof (Pt3f));
-      //traite la ligne nmap pour construire submap
-      for (int i = 0; i < twidth; i ++)
-      {
-        int val = 255 - (int) (sqrt (nmap[i].x () * nmap[i].x ()
-                                     + nmap[i].y () * nmap[i].y ()) * 255);
-        if (val < 0) val = 0;
-        if (val > 255) val = 255;
-        *pmap++ = val;
-      }
-      pmap -= (pad_w + 1) * twidth;
+      std::vector<Pt3f> vals (twidth * theight);
+      nvmf.read ((char *) vals.data (), twidth * theight * sizeof (Pt3f));
+      for (int j = 0; j < theight; j++)
+        slopeRow (vals.data () + j * twidth, dst + j * stride, twidth);
+    }
+    else
+    {
+      std::vector<ONormal> vals (twidth * theight);
+      nvmf.read ((char *) vals.data (), twidth * theight * sizeof (ONormal));
+      for (int j = 0; j < theight; j++)
+        slopeRow (vals.data () + j * twidth, dst + j * stride, twidth);
     }
     nvmf.close ();
   }
   else
+    for (int j = 0; j < theight; j++) memset (dst + j * stride, 0, twidth);
+  return true;
+}
+
+
+void TerrainMap::slopeRow (const Pt3f *nv, unsigned char *out, int n)
+{
+  for (int i = 0; i < n; i ++)
   {
-    unsigned char *pmap = submap;
-    for (int j = 0; j < theight; j++)
-    {
-      for (int i = 0; i < twidth; i ++) *pmap ++ = 0;
-      pmap -= (pad_w + 1) * twidth;
-    }
+    int val = 255 - (int) (sqrt ((double) (nv[i].x () * nv[i].x ()
+                                           + nv[i].y () * nv[i].y ())) * 255);
+    val = (val < 0 ? 0 : val);
+    out[i] = (unsigned char) (val > 255 ? 255 : val);
+  }
+}
+
+
+void TerrainMap::slopeRow (const ONormal *nv, unsigned char *out, int n)
+{
+  for (int i = 0; i < n; i ++)
+  {
+    int val = 255 - (int) (sqrt ((double) nv[i].slope2 ()) * 255);
+    val = (val < 0 ? 0 : val);
+    out[i] = (unsigned char) (val > 255 ? 255 : val);
   }
-  return true;
 }
 
 
@@ -688,20 +1082,15 @@ void TerrainMap::saveFirstNormalMap (const std::string &name) const
     std::cout << "File " << name << " can't be created" << std::endl;
   else
   {
-    nvmf.write ((char *) (&twidth), sizeof (int));
-    nvmf.write ((char *) (&theight), sizeof (int));
-    nvmf.write ((char *) (&cell_size), sizeof (float));
-    float fxm = (float) input_xmins.front ();
-    nvmf.write ((char *) (&fxm), sizeof (float));
-    float fym = (float) input_ymins.front ();
-    nvmf.write ((char *) (&fym), sizeof (float));
+    writeNvmHeader (nvmf, twidth, theight, (float) input_xmins.front (),
+                    (float) input_ymins.front ());
     Pt2i txy = input_layout.front ();
-    Pt3f *line = nmap + iwidth * (iheight - 1);
+    ONormal *line = nmap + iwidth * (iheight - 1);
     line -= txy.y () * theight * iwidth;
     line += txy.x () * twidth;
     for (int j = 0; j < theight; j++)
     {
-      nvmf.write ((char *) line, twidth * sizeof (Pt3f));
+      writeNvmRow (nvmf, line, twidth);
       line -= iwidth;
     }
     nvmf.close ();
@@ -723,20 +1112,14 @@ void TerrainMap::saveLoadedNormalMaps (const std::string &dir) const
       std::cout << "File " << name << " can't be created" << std::endl;
     else
     {
-      nvmf.write ((char *) (&twidth), sizeof (int));
-      nvmf.write ((char *) (&theight), sizeof (int));
-      nvmf.write ((char *) (&cell_size), sizeof (float));
-      float fxm = (float) (*xit);
-      nvmf.write ((char *) (&fxm), sizeof (float));
-      float fym = (float) (*yit);
-      nvmf.write ((char *) (&fym), sizeof (float));
+      writeNvmHeader (nvmf, twidth, theight, (float) (*xit), (float) (*yit));
       Pt2i txy (*lit);
-      Pt3f *line = nmap + iwidth * (iheight - 1);
+      ONormal *line = nmap + iwidth * (iheight - 1);
       line -= txy.y () * theight * iwidth;
       line += txy.x () * twidth;
       for (int j = 0; j < theight; j++)
       {
-        nvmf.write ((char *) line, twidth * sizeof (Pt3f));
+        writeNvmRow (nvmf, line, twidth);
         line -= iwidth;
       }
       nvmf.close ();
@@ -751,31 +1134,43 @@ void TerrainMap::saveLoadedNormalMaps (const std::string &dir) const
 
 bool TerrainMap::addDtmFile (const std::string &name, bool verb, bool grid_ref)
 {
-  std::ifstream dtmf (name.c_str (), std::ios::in);
-  if (! dtmf.is_open ())
-  {
-    if (verb) std::cout << "File " << name << " can't be opened" << std::endl;
-    return false;
-  }
-  char val[100];  // IGN
   int width = 0, height = 0;
   double xllc = 0., yllc = 0., nodata = 0.;
   float csize = 0.0f;
+  int64_t offset = -1;
 
-  dtmf >> val;
-  dtmf >> width;
-  if (grid_ref) width --;
-  dtmf >> val;
-  dtmf >> height;
-  if (grid_ref) height --;
-  dtmf >> val;
-  dtmf >> xllc;
-  xllc = (double) ((int) (xllc + 0.5f));
-  dtmf >> val;
-  dtmf >> yllc;
-  yllc = (double) ((int) (yllc + 0.5f));
-  dtmf >> val;
-  dtmf >> csize;
+  if (! readDtmSidecar (name, width, height, xllc, yllc, csize, nodata, NULL))
+  {
+    std::ifstream dtmf (name.c_str (), std::ios::in);
+    if (! dtmf.is_open ())
+    {
+      if (verb) std::cout << "File " << name << " can't be opened"
+                          << std::endl;
+      return false;
+    }
+    char val[100];  // IGN
+    dtmf >> val;
+    dtmf >> width;
+    dtmf >> val;
+    dtmf >> height;
+    dtmf >> val;
+    dtmf >> xllc;
+    xllc = (double) ((int) (xllc + 0.5f));
+    dtmf >> val;
+    dtmf >> yllc;
+    yllc = (double) ((int) (yllc + 0.5f));
+    dtmf >> val;
+    dtmf >> csize;
+    dtmf >> val;
+    dtmf >> nodata;
+    if (dtmf.good ()) offset = (int64_t) dtmf.tellg ();
+    dtmf.close ();
+  }
+  if (grid_ref)
+  {
+    width --;
+    height --;
+  }
 
   if (iwidth == 0)
   {
@@ -853,6 +1248,8 @@ bool TerrainMap::addDtmFile (const std::string &name, bool verb, bool grid_ref)
   input_fullnames.push_back (name);
   input_xmins.push_back (xllc);
   input_ymins.push_back (yllc);
+  input_offsets.push_back (offset);
+  input_nodata.push_back (nodata);
   return true;
 }
 
@@ -865,91 +1262,417 @@ void TerrainMap::addDtmName (const std::string &name)
 
 bool TerrainMap::createMapFromDtm (bool verb, bool grid_ref)
 {
-  int isz = (grid_ref ? (iwidth + 1) * (iheight + 1) : iwidth * iheight);
-  double *hval = new double[isz];
-  for (int i = 0; i < isz; i++) hval[i] = no_data;
-
-  std::vector<Pt2i>::iterator it = input_layout.begin ();
-  std::vector<std::string>::iterator itn = input_fullnames.begin ();
-  while (it != input_layout.end ())
-  {
-    int dx = it->x () * twidth;
-    int dy = (iheight / theight - 1 - it->y ()) * theight;
-    if (verb) std::cout << "Opening " << *itn << std::endl;
-    std::ifstream dtmf (itn->c_str (), std::ios::in);
-    if (! dtmf.is_open ()) return false;
-    char val[15];
-    double hv = 0.0, nodata = 0.0;
-    for (int i = 0; i < 11; i++) dtmf >> val;
-    dtmf >> nodata;
-
-    int loc_th = (grid_ref ? theight + 1 : theight);
-    int loc_tw = (grid_ref ? twidth + 1 : twidth);
-    for (int j = 0; j < loc_th; j++)
-      for (int i = 0; i < loc_tw; i++)
+  int loc_th = (grid_ref ? theight + 1 : theight);
+  int loc_tw = (grid_ref ? twidth + 1 : twidth);
+  int nbt = (int) input_layout.size ();
+  if (verb)
+    for (int k = 0; k < nbt; k++)
+      std::cout << "Opening " << input_fullnames[k] << std::endl;
+
+  // Map slots (row by row from top left) and their input file
+  int cols = iwidth / twidth;
+  int rows = iheight / theight;
+  int nbs = cols * rows;
+  std::vector<int> slot_tile (nbs, -1);
+  for (int k = 0; k < nbt; k++)
+    slot_tile[(rows - 1 - input_layout[k].y ()) * cols
+              + input_layout[k].x ()] = k;
+
+  // Tiles loaded and processed in parallel, edges kept for the borders
+  int esz = 4 * (twidth + theight);
+  std::vector<float> edges (grid_ref ? 0 : nbs * esz);
+  std::vector<char> loaded (nbs, 0);
+  ONormal *nval = new ONormal[iwidth * iheight];
+  ASParallel::forBands (nbs, 1,
+    [&] (int start, int stop)
+    {
+      std::vector<float> hts (loc_tw * loc_th);
+      for (int s = start; s < stop; s++)
       {
-        dtmf >> hv;
-        hval[(dy + j) * iwidth + dx + i] = (hv == nodata ? no_data : hv);
+        int k = slot_tile[s];
+        if (k == -1)
+          for (int i = 0; i < loc_tw * loc_th; i++) hts[i] = (float) no_data;
+        else if (! loadDtmTile (k, loc_tw, loc_th, &(hts[0]), verb)) continue;
+        loaded[s] = 1;
+
+        ONormal *out = nval + (s / cols) * theight * iwidth
+                            + (s % cols) * twidth;
+        if (grid_ref) setGridNormals (&(hts[0]), out);
+        else
+        {
+          setInnerNormals (&(hts[0]), out);
+          float *e = &(edges[s * esz]);
+          for (int i = 0; i < 2 * twidth; i++)
+          {
+            e[i] = hts[i];
+            e[2 * twidth + i] = hts[(theight - 2) * twidth + i];
+          }
+          e += 4 * twidth;
+          for (int j = 0; j < theight; j++)
+          {
+            e[j] = hts[j * twidth];
+            e[theight + j] = hts[j * twidth + 1];
+            e[2 * theight + j] = hts[j * twidth + twidth - 2];
+            e[3 * theight + j] = hts[j * twidth + twidth - 1];
+          }
+        }
       }
-    dtmf.close ();
-    it ++;
-    itn ++;
+    });
+
+  for (int s = 0; s < nbs; s++)
+  {
+    if (! loaded[s])
+    {
+      delete [] nval;
+      return false;
+    }
   }
+  if (! grid_ref)
+    ASParallel::forBands (nbs, 1,
+      [&] (int start, int stop)
+      {
+        for (int s = start; s < stop; s++)
+          setBorderNormals (edges, s, nval + (s / cols) * theight * iwidth
+                                           + (s % cols) * twidth);
+      });
 
+  clearSlopeTables ();
   if (nmap != NULL) delete [] nmap;
-  nmap = new Pt3f[iwidth * iheight];
-  Pt3f *nval = nmap;
-  double dhx, dhy;
-  if (grid_ref)
+  nmap = nval;
+  dtm_heights = true;
+  dtm_grid_ref = grid_ref;
+  return true;
+}
+
+
+bool TerrainMap::loadDtmTile (int k, int w, int h, float *heights,
+                              bool verb, bool save) const
+{
+  int sw = 0, sh = 0;
+  double sx = 0., sy = 0., snd = 0.;
+  float scs = 0.0f;
+  if (! (readDtmSidecar (input_fullnames[k], sw, sh, sx, sy, scs, snd, NULL)
+         && sw == w && sh == h
+         && readDtmSidecar (input_fullnames[k], sw, sh, sx, sy, scs, snd,
+                            heights)))
   {
-    for (int j = 0; j < iheight; j++)
+    int n = parseAscHeights (input_fullnames[k], input_offsets[k],
+                             w * h, heights);
+    if (n < 0) return false;
+    if (n < w * h)
     {
-      for (int i = 0; i < iwidth; i++)
+      if (verb) std::cout << "File " << input_fullnames[k]
+                          << " : lacking height values" << std::endl;
+      for (int i = n; i < w * h; i++) heights[i] = (float) input_nodata[k];
+    }
+    else if (save)
+      writeDtmSidecar (input_fullnames[k], w, h, input_xmins[k],
+                       input_ymins[k], cell_size, input_nodata[k], heights);
+  }
+  float nodata = (float) input_nodata[k];
+  for (int i = 0; i < w * h; i++)
+    if (heights[i] == nodata) heights[i] = (float) no_data;
+  return true;
+}
+
+
+bool TerrainMap::getHeights (int imin, int jmin, int w, int h,
+                             float *out) const
+{
+  if (! dtm_heights) return false;
+  for (int i = 0; i < w * h; i++) out[i] = NAN;
+  int loc_th = (dtm_grid_ref ? theight + 1 : theight);
+  int loc_tw = (dtm_grid_ref ? twidth + 1 : twidth);
+  std::vector<float> hts (loc_tw * loc_th);
+  for (int k = 0; k < (int) input_layout.size (); k++)
+  {
+    int dx = input_layout[k].x () * twidth;
+    int dy = (iheight / theight - 1 - input_layout[k].y ()) * theight;
+    int i0 = (imin > dx ? imin : dx);
+    int i1 = (imin + w < dx + twidth ? imin + w : dx + twidth);
+    int j0 = (jmin > dy ? jmin : dy);
+    int j1 = (jmin + h < dy + theight ? jmin + h : dy + theight);
+    if (i0 >= i1 || j0 >= j1) continue;
+
+    // Sidecar files are not written here, tiles may be read concurrently
+    if (! loadDtmTile (k, loc_tw, loc_th, &(hts[0]), false, false))
+      return false;
+    for (int j = j0; j < j1; j++)
+      for (int i = i0; i < i1; i++)
       {
-        dhy = (hval[(j+1) * iwidth + i] - hval[j * iwidth + i])
-                   * 2 * RELIEF_AMPLI;
-        dhx = (hval[j * iwidth + i + 1] - hval[j * iwidth + i])
-                   * 2 * RELIEF_AMPLI;
-        nval->set (- (float) dhx, - (float) dhy, 1.0f);
-        nval->normalize ();
-        nval++;
+        float val = hts[(j - dy) * loc_tw + i - dx];
+        out[(j - jmin) * w + i - imin] = (val == (float) no_data ? NAN : val);
       }
+  }
+  return true;
+}
+
+
+void TerrainMap::setInnerNormals (const float *hts, ONormal *out) const
+{
+  Pt3f nv;
+  for (int j = 1; j < theight - 1; j++)
+  {
+    const float *hup = hts + (j - 1) * twidth;
+    const float *hcur = hup + twidth;
+    const float *hdown = hcur + twidth;
+    ONormal *nval = out + j * iwidth;
+    for (int i = 1; i < twidth - 1; i++)
+    {
+      float dhy = (hdown[i] - hup[i]) * RELIEF_AMPLI;
+      float dhx = (hcur[i+1] - hcur[i-1]) * RELIEF_AMPLI;
+      nv.set (- dhx, - dhy, 1.0f);
+      nv.normalize ();
+      nval[i].set (nv);
     }
   }
-  else
+}
+
+
+void TerrainMap::setBorderNormals (const std::vector<float> &edges,
+                                   int slot, ONormal *out) const
+{
+  int cols = iwidth / twidth;
+  int rows = iheight / theight;
+  int esz = 4 * (twidth + theight);
+  int col = slot % cols, row = slot / cols;
+  bool top = (row == 0), bottom = (row == rows - 1);
+  bool left = (col == 0), right = (col == cols - 1);
+  const float *e = &(edges[slot * esz]);
+  const float *en = (top ? NULL : e - cols * esz);
+  const float *es = (bottom ? NULL : e + cols * esz);
+  const float *ew = (left ? NULL : e - esz);
+  const float *ee = (right ? NULL : e + esz);
+  int ecol = 4 * twidth;
+
+  // Height in the tile or just around (only accessed within the map)
+  auto height = [&] (int i, int j) -> float
   {
-    for (int j = 0; j < iheight; j++)
+    if (j < 0) return (en[3 * twidth + i]);
+    if (j >= theight) return (es[i]);
+    if (i < 0) return (ew[ecol + 3 * theight + j]);
+    if (i >= twidth) return (ee[ecol + j]);
+    if (j < 2) return (e[j * twidth + i]);
+    if (j >= theight - 2) return (e[(j - theight + 4) * twidth + i]);
+    if (i < 2) return (e[ecol + i * theight + j]);
+    return (e[ecol + (i - twidth + 4) * theight + j]);
+  };
+
+  Pt3f nv;
+  auto setNormal = [&] (int i, int j)
+  {
+    float dhy, dhx;
+    if (j == theight - 1 && bottom)
+      dhy = (height (i, j) - height (i, j-1)) * 2 * RELIEF_AMPLI;
+    else if (j == 0 && top)
+      dhy = (height (i, j+1) - height (i, j)) * 2 * RELIEF_AMPLI;
+    else dhy = (height (i, j+1) - height (i, j-1)) * RELIEF_AMPLI;
+    if (i == twidth - 1 && right)
+      dhx = (height (i, j) - height (i-1, j)) * 2 * RELIEF_AMPLI;
+    else if (i == 0 && left)
+      dhx = (height (i+1, j) - height (i, j)) * 2 * RELIEF_AMPLI;
+    else dhx = (height (i+1, j) - height (i-1, j)) * RELIEF_AMPLI;
+    nv.set (- dhx, - dhy, 1.0f);
+    nv.normalize ();
+    out[j * iwidth + i].set (nv);
+  };
+
+  for (int i = 0; i < twidth; i++)
+  {
+    setNormal (i, 0);
+    setNormal (i, theight - 1);
+  }
+  for (int j = 1; j < theight - 1; j++)
+  {
+    setNormal (0, j);
+    setNormal (twidth - 1, j);
+  }
+}
+
+
+void TerrainMap::setGridNormals (const float *hts, ONormal *out) const
+{
+  Pt3f nv;
+  int gw = twidth + 1;
+  for (int j = 0; j < theight; j++)
+  {
+    const float *hcur = hts + j * gw;
+    const float *hdown = hcur + gw;
+    ONormal *nval = out + j * iwidth;
+    for (int i = 0; i < twidth; i++)
     {
-      for (int i = 0; i < iwidth; i++)
-      {
-        if (j == iheight - 1)
-          dhy = (hval[j * iwidth + i] - hval[(j-1) * iwidth + i])
-                * 2 * RELIEF_AMPLI;
-        else if (j == 0)
-          dhy = (hval[(j+1) * iwidth + i] - hval[j * iwidth + i])
-                * 2 * RELIEF_AMPLI;
-        else dhy = (hval[(j+1) * iwidth + i] - hval[(j-1) * iwidth + i])
-                   * RELIEF_AMPLI;
-        if (i == iwidth - 1)
-          dhx = (hval[j * iwidth + i] - hval[j * iwidth + i-1])
-                * 2 * RELIEF_AMPLI;
-        else if (i == 0)
-          dhx = (hval[j * iwidth + i+1] - hval[j * iwidth + i])
-                * 2 * RELIEF_AMPLI;
-        else dhx = (hval[j * iwidth + i+1] - hval[j * iwidth + i-1])
-                   * RELIEF_AMPLI;
-
-        nval->set (- (float) dhx, - (float) dhy, 1.0f);
-        nval->normalize ();
-        nval++;
-      }
+      float dhy = (hdown[i] - hcur[i]) * 2 * RELIEF_AMPLI;
+      float dhx = (hcur[i+1] - hcur[i]) * 2 * RELIEF_AMPLI;
+      nv.set (- dhx, - dhy, 1.0f);
+      nv.normalize ();
+      nval[i].set (nv);
     }
   }
-  delete [] hval;
+}
+
+
+std::string TerrainMap::dtmSidecarName (const std::string &name)
+{
+  size_t pos = name.find_last_of ('.');
+  size_t sep = name.find_last_of ('/');
+  if (pos != std::string::npos && (sep == std::string::npos || pos > sep))
+    return (name.substr (0, pos) + DTB_SUFFIX);
+  return (name + DTB_SUFFIX);
+}
+
+
+bool TerrainMap::fileStamp (const std::string &name,
+                            int64_t &size, int64_t &mtime)
+{
+  struct stat st;
+  if (stat (name.c_str (), &st) != 0) return false;
+  size = (int64_t) st.st_size;
+  mtime = (int64_t) st.st_mtime;
   return true;
 }
 
 
+bool TerrainMap::readDtmSidecar (const std::string &name, int &w, int &h,
+                                 double &xllc, double &yllc, float &csize,
+                                 double &nodata, float *heights) const
+{
+  int64_t size = 0, mtime = 0, dsize = 0, dmtime = 0;
+  if (! fileStamp (name, size, mtime)) return false;
+  std::ifstream dtbf (dtmSidecarName(name).c_str (),
+                      std::ios::in | std::ifstream::binary);
+  if (! dtbf.is_open ()) return false;
+  char tag[4] = { 0, 0, 0, 0 };
+  dtbf.read (tag, 4);
+  dtbf.read ((char *) (&dsize), sizeof (int64_t));
+  dtbf.read ((char *) (&dmtime), sizeof (int64_t));
+  if ((! dtbf.good ()) || tag[0] != 'D' || tag[1] != 'T' || tag[2] != 'B'
+      || tag[3] != '1' || dsize != size || dmtime != mtime)
+  {
+    dtbf.close ();
+    return false;
+  }
+  dtbf.read ((char *) (&w), sizeof (int));
+  dtbf.read ((char *) (&h), sizeof (int));
+  dtbf.read ((char *) (&xllc), sizeof (double));
+  dtbf.read ((char *) (&yllc), sizeof (double));
+  dtbf.read ((char *) (&csize), sizeof (float));
+  dtbf.read ((char *) (&nodata), sizeof (double));
+  bool ok = dtbf.good () && w > 0 && h > 0;
+  if (ok && heights != NULL)
+  {
+    std::streamsize nb = (std::streamsize) w * h * sizeof (float);
+    dtbf.read ((char *) heights, nb);
+    ok = (dtbf.gcount () == nb);
+  }
+  dtbf.close ();
+  return ok;
+}
+
+
+bool TerrainMap::writeDtmSidecar (const std::string &name, int w, int h,
+                                  double xllc, double yllc, float csize,
+                                  double nodata, const float *heights) const
+{
+  int64_t size = 0, mtime = 0;
+  if (! fileStamp (name, size, mtime)) return false;
+  std::string dtbname = dtmSidecarName (name);
+  std::ofstream dtbf (dtbname.c_str (), std::ios::out | std::ofstream::binary);
+  if (! dtbf.is_open ()) return false;
+  dtbf.write ("DTB1", 4);
+  dtbf.write ((char *) (&size), sizeof (int64_t));
+  dtbf.write ((char *) (&mtime), sizeof (int64_t));
+  dtbf.write ((char *) (&w), sizeof (int));
+  dtbf.write ((char *) (&h), sizeof (int));
+  dtbf.write ((char *) (&xllc), sizeof (double));
+  dtbf.write ((char *) (&yllc), sizeof (double));
+  dtbf.write ((char *) (&csize), sizeof (float));
+  dtbf.write ((char *) (&nodata), sizeof (double));
+  dtbf.write ((const char *) heights, (std::streamsize) w * h * sizeof (float));
+  bool ok = dtbf.good ();
+  dtbf.close ();
+  if (! ok) remove (dtbname.c_str ());
+  return ok;
+}
+
+
+int TerrainMap::parseAscHeights (const std::string &name, int64_t offset,
+                                 int n, float *heights) const
+{
+  std::ifstream dtmf (name.c_str (), std::ios::in | std::ifstream::binary);
+  if (! dtmf.is_open ()) return -1;
+  dtmf.seekg (0, std::ios::end);
+  int64_t fsize = (int64_t) dtmf.tellg ();
+  int64_t start = (offset < 0 ? 0 : (offset > fsize ? fsize : offset));
+  std::vector<char> buf ((size_t) (fsize - start + 1));
+  dtmf.seekg ((std::streamoff) start);
+  dtmf.read (&(buf[0]), (std::streamsize) (fsize - start));
+  dtmf.close ();
+  buf[fsize - start] = '\0';
+
+  const char *s = &(buf[0]), *end = s + (fsize - start);
+  if (offset < 0)  // skips the six header lines (label and value)
+    for (int i = 0; i < 12; i++)
+    {
+      while (s != end && (*s == ' ' || *s == '\t' || *s == '\n'
+                          || *s == '\r')) s++;
+      while (s != end && *s != ' ' && *s != '\t' && *s != '\n'
+             && *s != '\r') s++;
+    }
+  int cpt = 0;
+  double hv = 0.;
+  while (cpt < n && (s = parseAscValue (s, end, hv)) != NULL)
+    heights[cpt++] = (float) hv;
+  return cpt;
+}
+
+
+const char *TerrainMap::parseAscValue (const char *s, const char *end,
+                                       double &val)
+{
+  static const double pow10[16] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7,
+                                    1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14,
+                                    1e15 };
+  while (s != end && (*s == ' ' || *s == '\t' || *s == '\n' || *s == '\r'))
+    s++;
+  if (s == end) return NULL;
+
+  // Fast path for plain decimal values : exact integer mantissa
+  //   divided by an exact power of ten, as correctly rounded as strtod.
+  const char *start = s;
+  bool neg = (*s == '-');
+  if (*s == '-' || *s == '+') s++;
+  int64_t m = 0;
+  int nd = 0, ndec = 0;
+  while (s != end && *s >= '0' && *s <= '9')
+  {
+    if (nd < 15) m = m * 10 + (*s - '0');
+    s ++;
+    nd ++;
+  }
+  if (s != end && *s == '.')
+  {
+    s ++;
+    while (s != end && *s >= '0' && *s <= '9')
+    {
+      if (nd < 15) m = m * 10 + (*s - '0');
+      s ++;
+      nd ++;
+      ndec ++;
+    }
+  }
+  if (nd == 0 || nd > 15 || (s != end && *s != ' ' && *s != '\t'
+                             && *s != '\n' && *s != '\r'))
+  {
+    char *e = NULL;
+    val = strtod (start, &e);
+    return (e == start ? NULL : e);
+  }
+  val = (double) m / pow10[ndec];
+  if (neg) val = - val;
+  return s;
+}
+
+
 bool TerrainMap::loadDtmMapInfo (const std::string &name)
 {
   std::ifstream dtmf (name.c_str (), std::ios::in);
@@ -990,17 +1713,13 @@ void TerrainMap::saveSubMap (int imin, int jmin, int imax, int jmax) const
     std::cout << "nvm/newtile.nvm can't be created" << std::endl;
   else
   {
-    nvmf.write ((char *) (&nw), sizeof (int));
-    nvmf.write ((char *) (&nh), sizeof (int));
-    nvmf.write ((char *) (&cell_size), sizeof (float));
-    nvmf.write ((char *) (&xm), sizeof (float));
-    nvmf.write ((char *) (&ym), sizeof (float));
-    Pt3f *line = nmap + iwidth * (iheight - 1);
+    writeNvmHeader (nvmf, nw, nh, xm, ym);
+    ONormal *line = nmap + iwidth * (iheight - 1);
     line -= jmin * iwidth;
     line += imin;
     for (int j = 0; j < nh; j++)
     {
-      nvmf.write ((char *) line, nw * sizeof (Pt3f));
+      writeNvmRow (nvmf, line, nw);
       line -= iwidth;
     }
     nvmf.close ();
@@ -1016,6 +1735,68 @@ void TerrainMap::checkArrangement ()
 }
 
 
+int TerrainMap::readNvmHeader (std::ifstream &nvmf, int &w, int &h,
+                               float &cs, float &xm, float &ym) const
+{
+  int version = 1;
+  nvmf.read ((char *) (&w), sizeof (int));
+  if (w == NVM_V2_TAG)
+  {
+    version = 2;
+    nvmf.read ((char *) (&w), sizeof (int));
+  }
+  nvmf.read ((char *) (&h), sizeof (int));
+  nvmf.read ((char *) (&cs), sizeof (float));
+  nvmf.read ((char *) (&xm), sizeof (float));
+  nvmf.read ((char *) (&ym), sizeof (float));
+  return (nvmf.good () ? version : 0);
+}
+
+
+void TerrainMap::readNvmTile (std::ifstream &nvmf, int version,
+                              ONormal *row, int stride) const
+{
+  if (version == 2)
+  {
+    for (int j = 0; j < theight; j++)
+      nvmf.read ((char *) (row + j * stride), twidth * sizeof (ONormal));
+  }
+  else
+  {
+    std::vector<Pt3f> vals (twidth * theight);
+    nvmf.read ((char *) vals.data (), twidth * theight * sizeof (Pt3f));
+    for (int j = 0; j < theight; j++)
+      for (int i = 0; i < twidth; i++)
+        row[j * stride + i].set (vals[j * twidth + i]);
+  }
+}
+
+
+void TerrainMap::writeNvmHeader (std::ofstream &nvmf,
+                                 int w, int h, float xm, float ym) const
+{
+  if (nvm_version == 2) nvmf.write ((char *) (&NVM_V2_TAG), sizeof (int));
+  nvmf.write ((char *) (&w), sizeof (int));
+  nvmf.write ((char *) (&h), sizeof (int));
+  nvmf.write ((char *) (&cell_size), sizeof (float));
+  nvmf.write ((char *) (&xm), sizeof (float));
+  nvmf.write ((char *) (&ym), sizeof (float));
+}
+
+
+void TerrainMap::writeNvmRow (std::ofstream &nvmf,
+                              const ONormal *row, int w) const
+{
+  if (nvm_version == 2) nvmf.write ((char *) row, w * sizeof (ONormal));
+  else
+  {
+    std::vector<Pt3f> vrow (w);
+    for (int i = 0; i < w; i++) vrow[i].set (row[i].vector ());
+    nvmf.write ((char *) vrow.data (), w * sizeof (Pt3f));
+  }
+}
+
+
 /*
 void TerrainMap::trace ()
 {
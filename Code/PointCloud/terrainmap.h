@@ -23,7 +23,13 @@
 #define TERRAIN_MAP_H
 
 #include <string>
+#include <inttypes.h>
+#include <fstream>
+#include <vector>
+#include <map>
+#include <thread>
 #include "pt3f.h"
+#include "onormal.h"
 #include "pt2i.h"
 
 
@@ -31,6 +37,9 @@
  * @class TerrainMap terrainmap.h
  * \brief Map of Ground normal vectors.
  * The map is assembled from ASC or NVM files.
+ * Normal vectors are stored in compact (octahedral) form.
+ * NVM files of version 1 store three floats per normal vector,
+ *   those of version 2 store compact normals.
  */
 class TerrainMap
 {
@@ -46,6 +55,8 @@ public:
   static const int DEFAULT_PAD_SIZE;
   /** DTM map file suffix. */
   static const std::string NVM_SUFFIX;
+  /** DTM binary sidecar file suffix. */
+  static const std::string DTB_SUFFIX;
 
 
   /**
@@ -98,6 +109,37 @@ public:
    */
   inline double yMin () const { return y_min; }
 
+  /**
+   * \brief Returns the compact normal vectors (row by row from top).
+   * Returns NULL if the map is not loaded or is loaded pad by pad.
+   */
+  inline const ONormal *normals () const { return nmap; }
+
+  /**
+   * \brief Returns the relief amplification of normal vectors.
+   * Height differences between both neighbours of a pixel are multiplied
+   *   by this factor before normal vector computation.
+   */
+  static inline float reliefAmplification () { return RELIEF_AMPLI; }
+
+  /**
+   * \brief Returns whether height values are available.
+   * They are only available for maps created from DTM (ASC) files.
+   */
+  inline bool hasHeights () const { return dtm_heights; }
+
+  /**
+   * \brief Reads the height values of a map area from DTM files.
+   * Returns false if height values are not available or can't be read.
+   * Values outside the map or lacking in DTM files are set to NaN.
+   * @param imin Left column of the area.
+   * @param jmin Top row of the area.
+   * @param w Area width.
+   * @param h Area height.
+   * @param out Height values to fill in (row by row from top).
+   */
+  bool getHeights (int imin, int jmin, int w, int h, float *out) const;
+
   /**
    * \brief Returns a pixel from the normal map and a lighting device.
    * @param i Pixel absiscae.
@@ -121,6 +163,52 @@ public:
    */
   double getSlopeFactor (int i, int j, int slp) const;
 
+  /**
+   * \brief Renders a region of the normal map with current shading.
+   * Pixels are written as opaque grey levels (0xffRRGGBB).
+   * Image rows are shared between available threads.
+   * @param buf Output pixel buffer (first pixel of the region).
+   * @param stride Count of pixels between two successive buffer rows.
+   * @param imin Left column of the region.
+   * @param jmin Top row of the region.
+   * @param w Region width.
+   * @param h Region height.
+   */
+  void render (uint32_t *buf, int stride,
+               int imin, int jmin, int w, int h) const;
+
+  /**
+   * \brief Renders a region of the normal map with given shading type.
+   * Pixels are written as opaque grey levels (0xffRRGGBB).
+   * Image rows are shared between available threads.
+   * @param buf Output pixel buffer (first pixel of the region).
+   * @param stride Count of pixels between two successive buffer rows.
+   * @param imin Left column of the region.
+   * @param jmin Top row of the region.
+   * @param w Region width.
+   * @param h Region height.
+   * @param shading_type Required shading type.
+   */
+  void render (uint32_t *buf, int stride, int imin, int jmin,
+               int w, int h, int shading_type) const;
+
+  /**
+   * \brief Renders a region of the normal map with given shading parameters.
+   * Current lighting and slopiness settings are ignored, so that the map
+   *   can be rendered in a separate thread while they are modified.
+   * @param buf Output pixel buffer (first pixel of the region).
+   * @param stride Count of pixels between two successive buffer rows.
+   * @param imin Left column of the region.
+   * @param jmin Top row of the region.
+   * @param w Region width.
+   * @param h Region height.
+   * @param shading_type Required shading type.
+   * @param angle Lighting angle in radians.
+   * @param slp Slope angle exponential factor.
+   */
+  void render (uint32_t *buf, int stride, int imin, int jmin, int w, int h,
+               int shading_type, float angle, int slp) const;
+
   /**
    * \brief Returns the lighting device angle.
    */
@@ -166,6 +254,8 @@ public:
   void setSlopinessFactor (int val);
 
   /** Return the center of the closest flat area to given point.
+   * Slope integration relies on summed-area tables of the slope factor,
+   *   built on demand for each tile and each exponential factor.
    * @param pt The input point.
    * @param srad The search area radius.
    * @param frad The slope integration area radius.
@@ -173,6 +263,23 @@ public:
    */
   Pt2i closestFlatArea (const Pt2i &pt, int srad, int frad, int sfact);
 
+  /** Returns the centers of the closest flat areas to a set of points.
+   * Required summed-area tables are built first, then the points are
+   *   processed in parallel.
+   * @param pts The input points.
+   * @param srad The search area radius.
+   * @param frad The slope integration area radius.
+   * @param sfact The slope angle exponential factor.
+   * @param res The output centers (one for each input point).
+   */
+  void closestFlatAreas (const std::vector<Pt2i> &pts, int srad, int frad,
+                         int sfact, std::vector<Pt2i> &res);
+
+  /**
+   * \brief Releases the slope factor summed-area tables.
+   */
+  void clearSlopeTables ();
+
   /**
    * \brief Declares a new normal map file to add.
    * Returns whether the named file exists.
@@ -188,10 +295,47 @@ public:
    * @param rows Count of rows of normal maps to assemble.
    * @param xmin Left-most coordinate (in millimeters).
    * @param ymin Lower coordinate (in millimeters).
+   * File headers are checked first, then tiles are read in parallel.
    * @param padding Pad loading mode (vector map later loaded pad by pad).
+   * @param verb Tile read times display modality (optional).
    */
   bool assembleMap (int cols, int rows, int64_t xmin, int64_t ymin,
-                    bool padding = false);
+                    bool padding = false, bool verb = false);
+
+  /**
+   * \brief Prepares the normal map for a tile by tile assembly.
+   * Returns whether preparation succeeded.
+   * File headers are checked and the map allocated, but no tile is read.
+   * Tiles should then be read using loadTile.
+   * @param cols Count of columns of normal maps to assemble.
+   * @param rows Count of rows of normal maps to assemble.
+   * @param xmin Left-most coordinate (in millimeters).
+   * @param ymin Lower coordinate (in millimeters).
+   */
+  bool prepareMap (int cols, int rows, int64_t xmin, int64_t ymin);
+
+  /**
+   * \brief Returns the count of declared normal map files.
+   */
+  inline int countOfTiles () const { return (int) input_fullnames.size (); }
+
+  /**
+   * \brief Reads one tile into the prepared normal map.
+   * Returns whether the tile was read.
+   * Distinct tiles can be read concurrently.
+   * @param k Tile index in declaration order.
+   */
+  bool loadTile (int k);
+
+  /**
+   * \brief Gets the map region covered by a tile of the prepared map.
+   * Returns whether the tile is part of the map.
+   * The region size is given by tileWidth and tileHeight.
+   * @param k Tile index in declaration order.
+   * @param imin Returned left column of the region.
+   * @param jmin Returned top row of the region.
+   */
+  bool tileRegion (int k, int &imin, int &jmin) const;
 
   /**
    * \brief Loads normal map information from a normal vector map file.
@@ -229,6 +373,8 @@ public:
 
   /**
    * \brief Loads next pad tiles and returns the lower left tile index.
+   * Entering tiles are decoded in parallel, and the tiles of the following
+   *   pad step are decoded ahead in a separate thread.
    * @param map Pointer to the map to be loaded with DTM tile contents.
    */
   int nextPad (unsigned char *map);
@@ -260,6 +406,17 @@ public:
    */
   void clearMap (unsigned char *submap, int pw, int w, int h);
 
+  /**
+   * \brief Returns the version of created normal vector map files.
+   */
+  inline int nvmVersion () const { return nvm_version; }
+
+  /**
+   * \brief Sets the version of created normal vector map files.
+   * @param val Version number (1 for float vectors, 2 for compact normals).
+   */
+  void setNvmVersion (int val);
+
   /**
    * \brief Creates a normal vector map file from the first loaded tile.
    * @param name Output file name.
@@ -275,6 +432,7 @@ public:
   /**
    * \brief Adds and arranges a new DTM file.
    * Returns whether adding succeeded.
+   * The header is read from the binary sidecar file when it is up to date.
    * The new file is localized wrt already entered files.
    * The complete ground map should be built using createMapFromDtm ()
    *   when all files have been loaded.
@@ -295,6 +453,12 @@ public:
   /**
    * \brief Creates the normal map from available DTM (ASC) files.
    * Returns whether creation succeeded.
+   * Tiles are processed in parallel, one at a time per thread, so that
+   *   no height array of the whole sector is needed.
+   * Heights are read from binary sidecar files when up to date, otherwise
+   *   they are parsed from ASC files and the sidecar files are created.
+   * Tile inner normals are computed on load, tile border normals are
+   *   computed afterwards from tile edge rows and columns.
    * @param verb Warning display modality.
    * @param grid_ref True if the input file is grid-referenced (optional) :
    *    standard is pixel-center-referenced
@@ -346,6 +510,12 @@ private:
   static const float MM2M;
   /** Small value for testing non zero values. */
   static const double EPS;
+  /** NVM file header tag for compact normal maps (version 2). */
+  static const int NVM_V2_TAG;
+  /** Minimal count of rows rendered by a thread. */
+  static const int RENDER_MIN_BAND;
+  /** Count of pixels processed at once by rendering kernels. */
+  static const int RENDER_CHUNK = 256;
 
 
   /** Tile width. */
@@ -360,13 +530,19 @@ private:
   double y_min;
   /** Height code for lacking data. */
   double no_data;
+  /** Indicates whether the map was created from DTM files. */
+  bool dtm_heights;
+  /** Indicates whether DTM files are grid-referenced. */
+  bool dtm_grid_ref;
 
   /** DTM normal map width. */
   int iwidth;
   /** DTM normal map height. */
   int iheight;
   /** DTM normal map. */
-  Pt3f *nmap;
+  ONormal *nmap;
+  /** Version of created normal vector map files. */
+  int nvm_version;
 
   /** Applied shading type. */
   int shading;
@@ -387,13 +563,24 @@ private:
   std::vector<std::string> input_fullnames;
   /** Input files nick names (without prefix nor suffix). */
   std::vector<std::string> input_nicknames;
+  /** Input NVM files versions (-1 for unopened files). */
+  std::vector<int> input_versions;
+  /** Input NVM files locations in the tile set (column, row). */
+  std::vector<Pt2i> input_places;
   /** Loaded tiles lefmost coordinate. */
   std::vector<double> input_xmins;
   /** Loaded tiles lowest coordinate. */
   std::vector<double> input_ymins;
+  /** Input DTM files height values offset (-1 if unknown). */
+  std::vector<int64_t> input_offsets;
+  /** Input DTM files height code for lacking data. */
+  std::vector<double> input_nodata;
   /** Map of arranged tile file names. */
   std::string **arr_files;
 
+  /** Slope factor summed-area tables of each tile, for each used factor. */
+  std::map<int, std::vector<double *> > slope_tables;
+
   /** Pad layout for local seed growing: size. */
   int pad_size;
   /** Pad layout for local seed growing: width. */
@@ -402,10 +589,312 @@ private:
   int pad_h;
   /** Pad reference (index of left bottom tile). */
   int pad_ref;
+  /** Tiles decoded ahead for the next pad step. */
+  std::vector<int> prefetch_tiles;
+  /** Slope maps of tiles decoded ahead. */
+  std::vector<unsigned char *> prefetch_maps;
+  /** Thread decoding tiles ahead. */
+  std::thread prefetcher;
   /** Count of tile columns. */
   int ts_cot;
   /** Count of tile rows. */
   int ts_rot;
+
+
+  /**
+   * \brief Moves the pad one step from given reference.
+   * Returns the new pad reference (-1 when the whole tile set is covered).
+   * Retained tiles are shifted and discarded ones cleared in the map,
+   *   while entering tiles are only listed.
+   * @param ref Present pad reference.
+   * @param map Pointer to the pad map, or NULL to only list entering tiles.
+   * @param tiles Indices of entering tiles.
+   * @param dsts Positions of entering tiles in the map (if provided).
+   */
+  int padStep (int ref, unsigned char *map, std::vector<int> &tiles,
+               std::vector<unsigned char *> &dsts);
+
+  /**
+   * \brief Loads one tile of the pad, if possible from tiles decoded ahead.
+   * @param k Tile index wrt tile set.
+   * @param submap Position in the map to be loaded with tile contents.
+   */
+  void fetchPadTile (int k, unsigned char *submap);
+
+  /**
+   * \brief Starts decoding the tiles of the next pad step.
+   */
+  void startPrefetch ();
+
+  /**
+   * \brief Waits for and releases the tiles decoded ahead.
+   */
+  void clearPrefetch ();
+
+  /**
+   * \brief Decodes one slope-shaded DTM tile.
+   * Returns whether decoding succeeded.
+   * Tile rows are stored from bottom to top.
+   * @param k Tile index wrt tile set.
+   * @param dst Location of the first stored row.
+   * @param stride Shift between successive rows (may be negative).
+   */
+  bool decodeTile (int k, unsigned char *dst, int stride) const;
+
+  /**
+   * \brief Converts a row of float normal vectors to slope values.
+   * @param nv Normal vectors.
+   * @param out Slope values.
+   * @param n Row size.
+   */
+  static void slopeRow (const Pt3f *nv, unsigned char *out, int n);
+
+  /**
+   * \brief Converts a row of compact normal vectors to slope values.
+   * @param nv Normal vectors.
+   * @param out Slope values.
+   * @param n Row size.
+   */
+  static void slopeRow (const ONormal *nv, unsigned char *out, int n);
+
+  /**
+   * \brief Reads and checks NVM file headers and locates the tiles.
+   * Returns whether headers are consistent.
+   * @param cols Count of columns of normal maps to assemble.
+   * @param rows Count of rows of normal maps to assemble.
+   * @param xmin Left-most coordinate (in millimeters).
+   * @param ymin Lower coordinate (in millimeters).
+   * @param padding Pad loading mode (tile names arranged in the layout).
+   */
+  bool locateTiles (int cols, int rows, int64_t xmin, int64_t ymin,
+                    bool padding);
+
+  /**
+   * \brief Reads the header of a normal vector map file.
+   * Returns the file version, or 0 if the header could not be read.
+   * @param nvmf Input stream positioned at file start.
+   * @param w Returned tile width.
+   * @param h Returned tile height.
+   * @param cs Returned cell size.
+   * @param xm Returned leftmost coordinate.
+   * @param ym Returned lowest coordinate.
+   */
+  int readNvmHeader (std::ifstream &nvmf, int &w, int &h,
+                     float &cs, float &xm, float &ym) const;
+
+  /**
+   * \brief Reads all normal vectors of a tile from a normal vector map file.
+   * @param nvmf Normal vector map file (header already read).
+   * @param version Normal vector map file version.
+   * @param row Map location of the first read row.
+   * @param stride Map offset between successive read rows.
+   */
+  void readNvmTile (std::ifstream &nvmf, int version,
+                    ONormal *row, int stride) const;
+
+  /**
+   * \brief Writes a normal vector map file header in set version.
+   * @param nvmf Output stream.
+   * @param w Tile width.
+   * @param h Tile height.
+   * @param xm Leftmost coordinate.
+   * @param ym Lowest coordinate.
+   */
+  void writeNvmHeader (std::ofstream &nvmf,
+                       int w, int h, float xm, float ym) const;
+
+  /**
+   * \brief Writes a row of normal vectors in set version.
+   * @param nvmf Output stream.
+   * @param row Compact normals to write.
+   * @param w Count of normal vectors in the row.
+   */
+  void writeNvmRow (std::ofstream &nvmf, const ONormal *row, int w) const;
+
+  /**
+   * \brief Builds the missing slope summed-area tables around given points.
+   * Returns the tables of all the tiles for the given factor.
+   * @param pts Center points of the flat area searches.
+   * @param rad Search radius augmented with integration radius.
+   * @param sfact The slope angle exponential factor.
+   */
+  const std::vector<double *> &slopeTables (const std::vector<Pt2i> &pts,
+                                            int rad, int sfact);
+
+  /**
+   * \brief Creates a tile slope summed-area table.
+   * Tables have one more row and column than the tile, filled with zeros.
+   * @param sfact The slope angle exponential factor.
+   * @param tx Tile column index.
+   * @param ty Tile row index (from top of the map).
+   */
+  double *createSlopeTable (int sfact, int tx, int ty) const;
+
+  /**
+   * \brief Returns the slope factor sum over a map region.
+   * Required tables should have been built.
+   * @param sats Tile tables for the used factor.
+   * @param c0 Left column of the region.
+   * @param r0 Top row of the region.
+   * @param c1 Right column of the region + 1.
+   * @param r1 Bottom row of the region + 1.
+   */
+  double slopeSum (const std::vector<double *> &sats,
+                   int c0, int r0, int c1, int r1) const;
+
+  /**
+   * \brief Returns the center of the closest flat area to given point.
+   * Required tables should have been built.
+   * @param sats Tile tables for the used factor.
+   * @param pt The input point.
+   * @param srad The search area radius.
+   * @param frad The slope integration area radius.
+   */
+  Pt2i flatAreaCenter (const std::vector<double *> &sats,
+                       const Pt2i &pt, int srad, int frad) const;
+
+  /**
+   * \brief Loads the height values of an input DTM file.
+   * Returns false if the file could not be read.
+   * Lacking data are set to the map no-data value.
+   * @param k Input file index.
+   * @param w Count of columns in the file.
+   * @param h Count of rows in the file.
+   * @param heights Height values to fill in.
+   * @param verb Warning display modality.
+   * @param save Sidecar file creation modality.
+   */
+  bool loadDtmTile (int k, int w, int h, float *heights,
+                    bool verb, bool save = true) const;
+
+  /**
+   * \brief Sets the normals of a tile but its first and last rows and columns.
+   * @param hts Tile height values.
+   * @param out Tile first normal in the map.
+   */
+  void setInnerNormals (const float *hts, ONormal *out) const;
+
+  /**
+   * \brief Sets the normals of the first and last rows and columns of a tile.
+   * @param edges Two first and last rows and columns of all map tiles.
+   * @param slot Tile index in the map, row by row from top left.
+   * @param out Tile first normal in the map.
+   */
+  void setBorderNormals (const std::vector<float> &edges,
+                         int slot, ONormal *out) const;
+
+  /**
+   * \brief Sets the normals of a grid-referenced tile.
+   * @param hts Tile height values (one more row and column than the tile).
+   * @param out Tile first normal in the map.
+   */
+  void setGridNormals (const float *hts, ONormal *out) const;
+
+  /**
+   * \brief Returns the binary sidecar file name of a DTM file.
+   * @param name DTM file name.
+   */
+  static std::string dtmSidecarName (const std::string &name);
+
+  /**
+   * \brief Gets the size and modification time of a file.
+   * Returns whether the file exists.
+   * @param name File name.
+   * @param size Returned file size.
+   * @param mtime Returned modification time.
+   */
+  static bool fileStamp (const std::string &name,
+                         int64_t &size, int64_t &mtime);
+
+  /**
+   * \brief Reads a DTM binary sidecar file.
+   * Returns false if the sidecar file is missing or out of date.
+   * @param name DTM file name.
+   * @param w Returned count of columns in the DTM file.
+   * @param h Returned count of rows in the DTM file.
+   * @param xllc Returned lower left corner X-coordinate.
+   * @param yllc Returned lower left corner Y-coordinate.
+   * @param csize Returned cell size.
+   * @param nodata Returned height code for lacking data.
+   * @param heights Height values to fill in (only header read if NULL).
+   */
+  bool readDtmSidecar (const std::string &name, int &w, int &h,
+                       double &xllc, double &yllc, float &csize,
+                       double &nodata, float *heights) const;
+
+  /**
+   * \brief Writes a DTM binary sidecar file.
+   * Returns whether the file could be written.
+   * @param name DTM file name.
+   * @param w Count of columns in the DTM file.
+   * @param h Count of rows in the DTM file.
+   * @param xllc Lower left corner X-coordinate.
+   * @param yllc Lower left corner Y-coordinate.
+   * @param csize Cell size.
+   * @param nodata Height code for lacking data.
+   * @param heights Height values.
+   */
+  bool writeDtmSidecar (const std::string &name, int w, int h,
+                        double xllc, double yllc, float csize,
+                        double nodata, const float *heights) const;
+
+  /**
+   * \brief Parses the height values of a DTM (ASC) file.
+   * Returns the count of values read.
+   * The file is read at once and parsed in memory.
+   * @param name DTM file name.
+   * @param offset Position of the first value (-1 to skip the header).
+   * @param n Count of values to read.
+   * @param heights Height values to fill in.
+   */
+  int parseAscHeights (const std::string &name, int64_t offset,
+                       int n, float *heights) const;
+
+  /**
+   * \brief Parses a decimal value in a character buffer.
+   * Returns the position after the value, or NULL if no value was found.
+   * The buffer should be terminated by a null character.
+   * @param s Parse start position.
+   * @param end Buffer end.
+   * @param val Returned value.
+   */
+  static const char *parseAscValue (const char *s, const char *end,
+                                    double &val);
+
+  /**
+   * \brief Renders a region of the normal map with given light directions.
+   * @param buf Output pixel buffer (first pixel of the region).
+   * @param stride Count of pixels between two successive buffer rows.
+   * @param imin Left column of the region.
+   * @param jmin Top row of the region.
+   * @param w Region width.
+   * @param h Region height.
+   * @param shading_type Required shading type.
+   * @param lights The three light directions.
+   * @param slp Slope angle exponential factor.
+   */
+  void renderRegion (uint32_t *buf, int stride, int imin, int jmin,
+                     int w, int h, int shading_type,
+                     const Pt3f *lights, int slp) const;
+
+  /**
+   * \brief Renders a row chunk of the normal map.
+   * @param out Output pixels.
+   * @param nv First normal vector of the chunk.
+   * @param n Count of pixels in the chunk (at most RENDER_CHUNK).
+   * @param shading_type Required shading type.
+   * @param lights The three light directions.
+   * @param slp Slope angle exponential factor.
+   */
+  void renderChunk (uint32_t *out, const ONormal *nv, int n, int shading_type,
+                    const Pt3f *lights, int slp) const;
+
+  /**
+   * \brief Sets the three light directions for a given lighting angle.
+   * @param ang Lighting angle in radians (in [0, 2 PI[).
+   * @param lights Array of the three directions to set.
+   */
+  static void setLights (float ang, Pt3f *lights);
 };
 
 #endif
@@ -21,27 +21,37 @@
 
 #include <QApplication>
 #include <iostream>
+#include <cstdlib>
 #include <string>
 #include <ostream>
 #include "gtwindow.h"
+#include "gtperftest.h"
+#include "gtbatchtest.h"
 
 #define NVM_DIR "../Data/nvm/"
 #define TIL_DIR "../Data/til/"
 #define TILE_SET_DIR "../Data/tilesets/"
 #define DEFAULT_SET "grismouton"
+#define BATCH_OUTPUT "../Data/outputs/batch.csv"
 #define CELL_SIZE 0.5f
 
 
 int main (int argc, char *argv[])
 {
-  int val = 0;
   bool tiledef = false;
   std::string tilename = std::string ("");
   bool comparing = false;
+  bool mask_disp = false;
+  bool diag_disp = false;
+  std::string batch_name = std::string ("");
+  std::string batch_output = std::string (BATCH_OUTPUT);
+  int nb_threads = 0;
+  std::vector<float> tolerances;
+  bool sweeping = false;
+  bool breakdown = false;
+  int strip = -1;
   std::string sector_name = std::string (DEFAULT_SET);
-  QApplication app (argc, argv);
 
-  GTWindow window (&val);   // val : necessary argument !
   for (int i = 1; i < argc; i++)
   {
     if (std::string(argv[i]).at(0) == '-')
@@ -59,7 +69,66 @@ int main (int argc, char *argv[])
       else if (std::string(argv[i]) == std::string ("--comp"))
         comparing = true;
       else if (std::string(argv[i]) == std::string ("--mask"))
-        window.setMaskDisplay (true);
+        mask_disp = true;
+      else if (std::string(argv[i]) == std::string ("--diag"))
+        diag_disp = true;
+      else if (std::string(argv[i]) == std::string ("--sweep"))
+        sweeping = true;
+      else if (std::string(argv[i]) == std::string ("--breakdown"))
+        breakdown = true;
+      else if (std::string(argv[i]) == std::string ("--tol"))
+      {
+        if (++i == argc)
+        {
+          std::cout << "Tolerance list missing" << std::endl;
+          return 0;
+        }
+        std::string tols (argv[i]);
+        size_t pos = 0;
+        while (pos != std::string::npos)
+        {
+          size_t next = tols.find (',', pos);
+          tolerances.push_back ((float) atof (tols.substr (pos,
+                       next == std::string::npos ? next : next - pos).c_str ()));
+          pos = (next == std::string::npos ? next : next + 1);
+        }
+      }
+      else if (std::string(argv[i]) == std::string ("--batch"))
+      {
+        if (++i == argc)
+        {
+          std::cout << "Job list missing" << std::endl;
+          return 0;
+        }
+        batch_name = std::string (argv[i]);
+      }
+      else if (std::string(argv[i]) == std::string ("--out"))
+      {
+        if (++i == argc)
+        {
+          std::cout << "Output file missing" << std::endl;
+          return 0;
+        }
+        batch_output = std::string (argv[i]);
+      }
+      else if (std::string(argv[i]) == std::string ("--threads"))
+      {
+        if (++i == argc)
+        {
+          std::cout << "Thread count missing" << std::endl;
+          return 0;
+        }
+        nb_threads = atoi (argv[i]);
+      }
+      else if (std::string(argv[i]) == std::string ("--strip"))
+      {
+        if (++i == argc)
+        {
+          std::cout << "Strip height missing" << std::endl;
+          return 0;
+        }
+        strip = atoi (argv[i]);
+      }
       else
       {
         int l = std::string (argv[i]).length ();
@@ -87,24 +156,22 @@ int main (int argc, char *argv[])
     else sector_name = std::string (argv[i++]);
   }
 
-  // Tile file loading
-  if (tiledef)
+  // Batch of comparisons, without any GUI object
+  if (batch_name != std::string (""))
   {
-    std::string nvmfile (NVM_DIR);
-    std::string ptsfile (TIL_DIR);
-    nvmfile += tilename + TerrainMap::NVM_SUFFIX;
-    ptsfile += IPtTile::ECO_DIR + IPtTile::ECO_PREFIX
-               + tilename + IPtTile::TIL_SUFFIX;
-    if (! window.setBinaryLidarFiles (nvmfile, ptsfile))
-    {
-      std::cout << "Header of " << nvmfile << " inconsistent" << std::endl;
-      return (0);
-    }
+    GTBatchTest batch;
+    if (! batch.loadJobs (batch_name)) return (EXIT_FAILURE);
+    batch.setThreads (nb_threads);
+    batch.run ();
+    return (batch.save (batch_output) ? EXIT_SUCCESS : EXIT_FAILURE);
   }
+
+  // Tile file names
+  std::vector<std::string> tiles;
+  if (tiledef) tiles.push_back (tilename);
   else
   {
     char sval[12];
-    std::vector<int> vals;
     std::string tsname (TILE_SET_DIR);
     tsname += sector_name + ".txt";
     std::ifstream input (tsname.c_str (), std::ios::in);
@@ -115,23 +182,9 @@ int main (int argc, char *argv[])
       {
         input >> sval;
         if (input.eof ()) reading = false;
-        else
-        {
-          std::string nvmfile (NVM_DIR);
-          std::string ptsfile (TIL_DIR);
-          nvmfile += sval + TerrainMap::NVM_SUFFIX;
-          ptsfile += IPtTile::ECO_DIR + IPtTile::ECO_PREFIX
-                     + sval + IPtTile::TIL_SUFFIX;
-          if (! window.setBinaryLidarFiles (nvmfile, ptsfile))
-          {
-            std::cout << "Header of " << nvmfile << " inconsistent"
-                      << std::endl;
-            return (0);
-          }
-        }
+        else tiles.push_back (std::string (sval));
       }
       input.close ();
-      window.setSectorName (sector_name);
     }
     else
     {
@@ -139,14 +192,57 @@ int main (int argc, char *argv[])
       return 0;
     }
   }
+  std::vector<std::string> nvmfiles;
+  std::vector<std::string> ptsfiles;
+  std::vector<std::string>::iterator it = tiles.begin ();
+  while (it != tiles.end ())
+  {
+    std::string nvmfile (NVM_DIR);
+    std::string ptsfile (TIL_DIR);
+    nvmfile += *it + TerrainMap::NVM_SUFFIX;
+    ptsfile += IPtTile::ECO_DIR + IPtTile::ECO_PREFIX
+               + *it + IPtTile::TIL_SUFFIX;
+    nvmfiles.push_back (nvmfile);
+    ptsfiles.push_back (ptsfile);
+    it ++;
+  }
 
-  window.createMaps (true);
-
+  // Comparison from file headers only, without any GUI object
   if (comparing)
   {
-    window.compare ();
+    GTPerfTest ptest;
+    if (! ptest.setTiles (nvmfiles, ptsfiles)) return 0;
+    if (! tiledef) ptest.loadSectorName (sector_name);
+    if (strip >= 0)
+    {
+      if (mask_disp || diag_disp || sweeping || breakdown
+          || ! tolerances.empty ())
+        std::cout << "Only recall and precision with --strip" << std::endl;
+      ptest.runStrips (strip);
+      return (EXIT_SUCCESS);
+    }
+    ptest.setDiagnostics (diag_disp);
+    ptest.run (mask_disp);
+    if (! tolerances.empty ()) ptest.getToleranceCurves (tolerances);
+    if (sweeping) ptest.getThresholdSweep ();
+    if (breakdown) ptest.getBreakdown ();
     return (EXIT_SUCCESS);
   }
+
+  int val = 0;
+  QApplication app (argc, argv);
+  GTWindow window (&val);   // val : necessary argument !
+  for (int k = 0; k < (int) nvmfiles.size (); k++)
+  {
+    if (! window.setBinaryLidarFiles (nvmfiles[k], ptsfiles[k]))
+    {
+      std::cout << "Header of " << nvmfiles[k] << " inconsistent"
+                << std::endl;
+      return (0);
+    }
+  }
+  if (! tiledef) window.setSectorName (sector_name);
+  window.createMaps (true);
   window.runOptions (); 
   window.show ();
   return app.exec ();
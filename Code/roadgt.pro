@@ -5,6 +5,8 @@
 QT+=widgets
 TEMPLATE = app
 TARGET = roadgt
+CONFIG += thread
+QMAKE_CXXFLAGS += -fno-math-errno
 INCLUDEPATH += . \
            GTInterface \
            ImageTools \
@@ -12,33 +14,63 @@ INCLUDEPATH += . \
 OBJECTS_DIR = obj
 
 # Input
-HEADERS += GTInterface/gtcreator.h \
+HEADERS += GTInterface/gtbatchtest.h \
+           GTInterface/gtcreator.h \
+           GTInterface/gtimagecache.h \
            GTInterface/gtperftest.h \
+           GTInterface/gtpointoverlay.h \
+           GTInterface/gtprofileview.h \
+           GTInterface/gtpyramid.h \
            GTInterface/gtwindow.h \
+           ImageTools/bitmask.h \
+           ImageTools/distancetransform.h \
+           ImageTools/imagereader.h \
+           ImageTools/labelmap.h \
+           ImageTools/pngwriter.h \
            ImageTools/pt2i.h \
+           ImageTools/spanmask.h \
+           ImageTools/varint.h \
            ImageTools/vr2i.h \
            PointCloud/asarea.h \
+           PointCloud/asparallel.h \
            PointCloud/astrack.h \
+           PointCloud/astrackindex.h \
            PointCloud/ipttile.h \
            PointCloud/ipttileset.h \
+           PointCloud/onormal.h \
            PointCloud/pt2f.h \
            PointCloud/pt3f.h \
            PointCloud/pt3i.h \
+           PointCloud/terrainderivatives.h \
            PointCloud/terrainmap.h \
            PointCloud/vr2f.h
 
 SOURCES += main.cpp \
+           GTInterface/gtbatchtest.cpp \
            GTInterface/gtcreator.cpp \
+           GTInterface/gtimagecache.cpp \
            GTInterface/gtperftest.cpp \
+           GTInterface/gtpointoverlay.cpp \
+           GTInterface/gtprofileview.cpp \
+           GTInterface/gtpyramid.cpp \
            GTInterface/gtwindow.cpp \
+           ImageTools/bitmask.cpp \
+           ImageTools/distancetransform.cpp \
+           ImageTools/imagereader.cpp \
+           ImageTools/labelmap.cpp \
+           ImageTools/pngwriter.cpp \
            ImageTools/pt2i.cpp \
+           ImageTools/spanmask.cpp \
            ImageTools/vr2i.cpp \
            PointCloud/asarea.cpp \
            PointCloud/astrack.cpp \
+           PointCloud/astrackindex.cpp \
            PointCloud/ipttile.cpp \
            PointCloud/ipttileset.cpp \
+           PointCloud/onormal.cpp \
            PointCloud/pt2f.cpp \
            PointCloud/pt3f.cpp \
            PointCloud/pt3i.cpp \
+           PointCloud/terrainderivatives.cpp \
            PointCloud/terrainmap.cpp \
            PointCloud/vr2f.cpp